@@ -7,7 +7,7 @@
 
 
 
-ModelTest::ModelTest()
+ModelTest::ModelTest(bool _pullVertices, bool _atlasTextures) : pullVertices(_pullVertices), atlasTextures(_atlasTextures)
 {
 	logger = std::make_unique<Neki::VKLogger>(Neki::VKLoggerConfig(true));
 	instDebugAllocator = std::make_unique<Neki::VKDebugAllocator>(Neki::VK_ALLOCATOR_TYPE::DEBUG);
@@ -21,12 +21,18 @@ ModelTest::ModelTest()
 
 	vulkanCommandPool = std::make_unique<Neki::VulkanCommandPool>(*logger, *deviceDebugAllocator, *vulkanDevice, Neki::VK_COMMAND_POOL_TYPE::GRAPHICS);
 
-	VkDescriptorPoolSize descriptorPoolSizes[]{ { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 }, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7 } };
-	vulkanDescriptorPool = std::make_unique<Neki::VulkanDescriptorPool>(*logger, *deviceDebugAllocator, *vulkanDevice, 2, descriptorPoolSizes);
+	//One set for the camera data and atlas regions, plus one per material (up to 4, for the atlas tiles)
+	VkDescriptorPoolSize descriptorPoolSizes[]{ { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7 * 4 } };
+	vulkanDescriptorPool = std::make_unique<Neki::VulkanDescriptorPool>(*logger, *deviceDebugAllocator, *vulkanDevice, 5, descriptorPoolSizes);
 
 	bufferFactory = std::make_unique<Neki::BufferFactory>(*logger, *deviceDebugAllocator, *vulkanDevice, *vulkanCommandPool);
 	imageFactory = std::make_unique<Neki::ImageFactory>(*logger, *deviceDebugAllocator, *vulkanDevice, *vulkanCommandPool, *bufferFactory);
-	modelFactory = std::make_unique<Neki::ModelFactory>(*logger, *deviceDebugAllocator, *vulkanDevice, *bufferFactory, *imageFactory, *vulkanDescriptorPool);
+	if (pullVertices && !vulkanDevice->IsScalarBlockLayoutEnabled())
+	{
+		throw std::runtime_error("Vertex pulling requires scalar block layout, which isn't enabled on this device\n");
+	}
+	modelFactory = std::make_unique<Neki::ModelFactory>(*logger, *deviceDebugAllocator, *vulkanDevice, *bufferFactory, *imageFactory, *vulkanDescriptorPool, pullVertices ? Neki::MODEL_VERTEX_INPUT::DEVICE_ADDRESS : Neki::MODEL_VERTEX_INPUT::VERTEX_BUFFER,
+	                                                      false, Neki::MODEL_MATERIAL_LAYOUT::SEPARATE, atlasTextures ? 512 : 0);
 
 	VkExtent2D winSize{ 1920, 1032 };
 	vulkanSwapchain = std::make_unique<Neki::VulkanSwapchain>(*logger, *deviceDebugAllocator, *vulkanDevice, *imageFactory, winSize);
@@ -34,6 +40,7 @@ ModelTest::ModelTest()
 	CreateRenderManager();
 	LoadModel();
 	InitialiseCamData();
+	InitialiseAtlasRegions();
 	CreateDescriptorSet();
 	BindDescriptorSet();
 	CreatePipeline();
@@ -100,9 +107,15 @@ void ModelTest::LoadModel()
 		textureSamplers[static_cast<Neki::MODEL_TEXTURE_TYPE>(i)] = textureSampler;
 	}
 
-	Neki::GPUModel cubeModel{ modelFactory->LoadModel("Tests/Resource Files/DamagedHelmet/DamagedHelmet.gltf", textureSamplers) };
-	modelMesh = cubeModel.meshes[0];
-	modelMaterial = cubeModel.materials[0];
+	if (atlasTextures)
+	{
+		//Four materials, each with one small diffuse texture - all four are packed into a single atlas page
+		model = modelFactory->LoadModel("Tests/Resource Files/AtlasTiles/tiles.obj", textureSamplers);
+		modelModelMatrix = glm::mat4(1.0f);
+		return;
+	}
+
+	model = modelFactory->LoadModel("Tests/Resource Files/DamagedHelmet/DamagedHelmet.gltf", textureSamplers);
 	modelModelMatrix = glm::mat4(1.0f);
 	modelModelMatrix = glm::rotate(modelModelMatrix, glm::radians(30.0f), glm::vec3(0, -1, 0));
 	modelModelMatrix = glm::rotate(modelModelMatrix, glm::radians(180.0f), glm::vec3(0, 0, 1));
@@ -127,16 +140,38 @@ void ModelTest::InitialiseCamData()
 	camDataUBO = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 
-	//Map buffer memory
-	void* uboMap;
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), camDataUBO, &memRequirements);
-	if (vkMapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(camDataUBO), 0, memRequirements.size, 0, &uboMap) != VK_SUCCESS)
+	//Write to the buffer's persistent mapping
+	memcpy(bufferFactory->GetMappedPointer(camDataUBO), &cameraData, static_cast<std::size_t>(bufferSize));
+}
+
+
+
+void ModelTest::InitialiseAtlasRegions()
+{
+	//Mirrors the std430 AtlasRegion struct in model.frag
+	struct AtlasRegionData
+	{
+		glm::vec2 uvScale;
+		glm::vec2 uvOffset;
+		std::uint32_t layer;
+		std::uint32_t padding;
+	};
+
+	constexpr std::size_t textureTypeCount{ static_cast<std::size_t>(Neki::MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES) };
+	std::vector<AtlasRegionData> regions(model.materials.size() * textureTypeCount);
+	for (std::size_t i{ 0 }; i < model.materials.size(); ++i)
 	{
-		throw std::runtime_error("Failed to create ubo\n");
+		for (std::size_t j{ 0 }; j < textureTypeCount; ++j)
+		{
+			const Neki::TextureAtlasRegion& region{ model.materials[i].atlasRegions[j] };
+			regions[i * textureTypeCount + j] = { region.uvScale, region.uvOffset, region.layer, 0 };
+		}
 	}
-	memcpy(uboMap, &cameraData, static_cast<std::size_t>(bufferSize));
-	vkUnmapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(camDataUBO));
+	const VkDeviceSize bufferSize{ regions.size() * sizeof(AtlasRegionData) };
+	atlasRegionsSSBO = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	//Write to the buffer's persistent mapping
+	memcpy(bufferFactory->GetMappedPointer(atlasRegionsSSBO), regions.data(), static_cast<std::size_t>(bufferSize));
 }
 
 
@@ -151,13 +186,23 @@ void ModelTest::CreateDescriptorSet()
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 
+	//Define descriptor binding 1 as a storage buffer accessible from the fragment shader
+	VkDescriptorSetLayoutBinding ssboLayoutBinding{};
+	ssboLayoutBinding.binding = 1;
+	ssboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	ssboLayoutBinding.descriptorCount = 1;
+	ssboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	ssboLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding layoutBindings[]{ uboLayoutBinding, ssboLayoutBinding };
+
 	//Create the descriptor set layout
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.pNext = nullptr;
 	layoutInfo.flags = 0;
-	layoutInfo.bindingCount = 1;
-	layoutInfo.pBindings = &uboLayoutBinding;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = layoutBindings;
 
 	//Create the descriptor set
 	if (vkCreateDescriptorSetLayout(vulkanDevice->GetDevice(), &layoutInfo, static_cast<const VkAllocationCallbacks*>(*deviceDebugAllocator), &descriptorSetLayout) != VK_SUCCESS)
@@ -174,7 +219,7 @@ void ModelTest::BindDescriptorSet() const
 {
 	//Bind descriptor set to make descriptor at binding 0 point to camDataUBO
 	VkDescriptorBufferInfo bufferInfo{};
-	bufferInfo.buffer = camDataUBO;
+	bufferInfo.buffer = bufferFactory->GetBuffer(camDataUBO);
 	bufferInfo.offset = 0;
 	bufferInfo.range = VK_WHOLE_SIZE;
 	VkWriteDescriptorSet descriptorWriteUBO;
@@ -189,7 +234,18 @@ void ModelTest::BindDescriptorSet() const
 	descriptorWriteUBO.pTexelBufferView = nullptr;
 	descriptorWriteUBO.pImageInfo = nullptr;
 
-	vkUpdateDescriptorSets(vulkanDevice->GetDevice(), 1, &descriptorWriteUBO, 0, nullptr);
+	//Bind descriptor set to make descriptor at binding 1 point to atlasRegionsSSBO
+	VkDescriptorBufferInfo ssboInfo{};
+	ssboInfo.buffer = bufferFactory->GetBuffer(atlasRegionsSSBO);
+	ssboInfo.offset = 0;
+	ssboInfo.range = VK_WHOLE_SIZE;
+	VkWriteDescriptorSet descriptorWriteSSBO{ descriptorWriteUBO };
+	descriptorWriteSSBO.dstBinding = 1;
+	descriptorWriteSSBO.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWriteSSBO.pBufferInfo = &ssboInfo;
+
+	VkWriteDescriptorSet descriptorWrites[]{ descriptorWriteUBO, descriptorWriteSSBO };
+	vkUpdateDescriptorSets(vulkanDevice->GetDevice(), 2, descriptorWrites, 0, nullptr);
 }
 
 
@@ -199,6 +255,21 @@ void ModelTest::CreatePipeline()
 	Neki::VKGraphicsPipelineCleanDesc piplDesc{};
 	piplDesc.renderPass = vulkanRenderManager->GetRenderPass();
 
+	VkDescriptorSetLayout descSetLayouts[]{ descriptorSetLayout, modelFactory->GetMaterialDescriptorSetLayout() };
+
+	//Push constant for storing the model matrix, the vertex address (only read by model_pulling.vert), and the material index (for looking up atlas regions in model.frag)
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.size = sizeof(DrawData);
+	pushConstantRange.offset = 0;
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	if (pullVertices)
+	{
+		//No vertex input - model_pulling.vert reads the vertices itself from the pushed vertex address
+		vulkanGraphicsPipeline = std::make_unique<Neki::VulkanGraphicsPipeline>(*logger, *deviceDebugAllocator, *vulkanDevice, &piplDesc, "Tests/Shaders/model_pulling.vert", "Tests/Shaders/model.frag", nullptr, nullptr, 2, descSetLayouts, 1, &pushConstantRange);
+		return;
+	}
+
 	VkVertexInputBindingDescription vertInputBindingDesc{};
 	vertInputBindingDesc.binding = 0;
 	vertInputBindingDesc.stride = sizeof(Neki::ModelVertex);
@@ -241,14 +312,6 @@ void ModelTest::CreatePipeline()
 	piplDesc.vertexAttributeDescriptionCount = 5;
 	piplDesc.pVertexAttributeDescriptions = attribDescs;
 
-	//Push constant for storing the model matrix
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.size = sizeof(glm::mat4);
-	pushConstantRange.offset = 0;
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-	VkDescriptorSetLayout descSetLayouts[]{ descriptorSetLayout, modelFactory->GetMaterialDescriptorSetLayout() };
-
 	vulkanGraphicsPipeline = std::make_unique<Neki::VulkanGraphicsPipeline>(*logger, *deviceDebugAllocator, *vulkanDevice, &piplDesc, "Tests/Shaders/model.vert", "Tests/Shaders/model.frag", nullptr, nullptr, 2, descSetLayouts, 1, &pushConstantRange);
 }
 
@@ -266,15 +329,6 @@ void ModelTest::Run()
 		vulkanRenderManager->StartFrame(2, clearValues);
 
 		vkCmdBindPipeline(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipeline());
-		constexpr VkDeviceSize zeroOffset{ 0 };
-		vkCmdBindVertexBuffers(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &modelMesh.vertexBuffer, &zeroOffset);
-		vkCmdBindIndexBuffer(vulkanRenderManager->GetCurrentCommandBuffer(), modelMesh.indexBuffer, zeroOffset, VK_INDEX_TYPE_UINT32);
-		VkDescriptorSet descSets[]{ descriptorSet, modelMaterial.descriptorSet };
-		vkCmdBindDescriptorSets(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipelineLayout(), 0, 2, descSets, 0, nullptr);
-
-		float speed{ 0.01f };
-		modelModelMatrix = glm::rotate(modelModelMatrix, glm::radians(speed), glm::vec3(0, 0, 1));
-		vkCmdPushConstants(vulkanRenderManager->GetCurrentCommandBuffer(), vulkanGraphicsPipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &modelModelMatrix);
 
 		//Define viewport
 		VkViewport viewport{};
@@ -292,8 +346,30 @@ void ModelTest::Run()
 		scissor.extent = vulkanSwapchain->GetSwapchainExtent();
 		vkCmdSetScissor(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &scissor);
 
-		//Draw the model
-		vkCmdDrawIndexed(vulkanRenderManager->GetCurrentCommandBuffer(), modelMesh.indexCount, 1, 0, 0, 0);
+		if (!atlasTextures)
+		{
+			float speed{ 0.01f };
+			modelModelMatrix = glm::rotate(modelModelMatrix, glm::radians(speed), glm::vec3(0, 0, 1));
+		}
+
+		//Draw the model's meshes
+		for (const Neki::GPUMesh& mesh : model.meshes)
+		{
+			constexpr VkDeviceSize zeroOffset{ 0 };
+			if (!pullVertices)
+			{
+				const VkBuffer vertexBuffer{ bufferFactory->GetBuffer(mesh.vertexBuffer) };
+				vkCmdBindVertexBuffers(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &vertexBuffer, &zeroOffset);
+			}
+			vkCmdBindIndexBuffer(vulkanRenderManager->GetCurrentCommandBuffer(), bufferFactory->GetBuffer(mesh.indexBuffer), zeroOffset, VK_INDEX_TYPE_UINT32);
+			VkDescriptorSet descSets[]{ descriptorSet, model.materials[mesh.materialIndex].descriptorSet };
+			vkCmdBindDescriptorSets(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipelineLayout(), 0, 2, descSets, 0, nullptr);
+
+			const DrawData drawData{ modelModelMatrix, mesh.vertexAddress, static_cast<std::uint32_t>(mesh.materialIndex) };
+			vkCmdPushConstants(vulkanRenderManager->GetCurrentCommandBuffer(), vulkanGraphicsPipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawData), &drawData);
+
+			vkCmdDrawIndexed(vulkanRenderManager->GetCurrentCommandBuffer(), mesh.indexCount, 1, 0, 0, 0);
+		}
 
 		vulkanRenderManager->SubmitAndPresent();
 	}
@@ -307,11 +383,21 @@ void ModelTest::Run()
 
 
 
-int main()
+int main(int argc, char** argv)
 {
+	//Pass --pull-vertices to draw with vertex pulling (MODEL_VERTEX_INPUT::DEVICE_ADDRESS) rather than a vertex buffer
+	//Pass --atlas to draw a model whose textures are packed into a texture atlas
+	bool pullVertices{ false };
+	bool atlasTextures{ false };
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--pull-vertices") == 0) { pullVertices = true; }
+		if (std::strcmp(argv[i], "--atlas") == 0) { atlasTextures = true; }
+	}
+
 	glfwInit();
 	{
-		ModelTest modelTest{};
+		ModelTest modelTest{ pullVertices, atlasTextures };
 		modelTest.Run();
 	}
 	glfwTerminate();
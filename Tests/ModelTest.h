@@ -9,21 +9,35 @@
 class ModelTest
 {
 public:
-	ModelTest();
+	//_pullVertices draws through ModelFactory's MODEL_VERTEX_INPUT::DEVICE_ADDRESS mode with model_pulling.vert
+	//_atlasTextures loads a model of small textured tiles with texture atlasing enabled, sampling each material's atlas regions in model.frag
+	explicit ModelTest(bool _pullVertices=false, bool _atlasTextures=false);
 	~ModelTest() = default;
 
 	void Run();
 	
 	
 private:
+	//Push constants for each mesh - matches ModelData in the vertex shaders and DrawData in model.frag
+	struct DrawData
+	{
+		glm::mat4 model;
+		VkDeviceAddress vertexAddress; //Only read by model_pulling.vert
+		std::uint32_t materialIndex;
+	};
+
 	void CreateRenderManager();
 	void LoadModel();
 	void InitialiseCamData();
+	void InitialiseAtlasRegions();
 	void CreateDescriptorSet();
 	void BindDescriptorSet() const;
 	void CreatePipeline();
 
 	
+	bool pullVertices;
+	bool atlasTextures;
+
 	std::unique_ptr<Neki::VKLogger> logger;
 	std::unique_ptr<Neki::VKDebugAllocator> instDebugAllocator;
 	std::unique_ptr<Neki::VKDebugAllocator> deviceDebugAllocator;
@@ -37,12 +51,12 @@ private:
 	std::unique_ptr<Neki::VulkanRenderManager> vulkanRenderManager;
 	std::unique_ptr<Neki::VulkanGraphicsPipeline> vulkanGraphicsPipeline;
 
-	VkBuffer camDataUBO{};
+	Neki::BufferHandle camDataUBO{};
+	Neki::BufferHandle atlasRegionsSSBO{}; //Every material's TextureAtlasRegions, indexed by materialIndex * NUM_MODEL_TEXTURE_TYPES + texture type
 	VkDescriptorSetLayout descriptorSetLayout{};
 	VkDescriptorSet descriptorSet{};
 	
-	Neki::GPUMesh modelMesh{};
-	Neki::GPUMaterial modelMaterial{};
+	Neki::GPUModel model{};
 	glm::mat4 modelModelMatrix{}; //Like.... the model matrix for the model....
 
 	VkSampler textureSampler{};
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <NekiVK/NekiVK.h>
+
+//Measures the throughput of each pixel kernel with every instruction set the CPU supports, over a 4096x4096 image (large enough to stream from memory rather than cache)
+//Throughput is (bytes read + bytes written) / time, taking the best of several runs
+//Before timing, each instruction set's output is checked against the scalar implementation's - the benchmark fails (returning 1) on any mismatch
+
+constexpr std::size_t WIDTH{ 4096 };
+constexpr std::size_t HEIGHT{ 4096 };
+constexpr std::size_t TEXEL_COUNT{ WIDTH * HEIGHT };
+constexpr int RUNS{ 10 };
+
+
+
+double MeasureGBPerSecond(std::size_t _bytesTouched, const std::function<void()>& _kernel)
+{
+	_kernel(); //Warm up (page in the buffers, build lookup tables)
+	double bestSeconds{ 1e30 };
+	for (int run{ 0 }; run < RUNS; ++run)
+	{
+		const std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+		_kernel();
+		const std::chrono::duration<double> elapsed{ std::chrono::steady_clock::now() - start };
+		bestSeconds = std::min(bestSeconds, elapsed.count());
+	}
+	return static_cast<double>(_bytesTouched) / bestSeconds / 1e9;
+}
+
+
+
+struct Kernel
+{
+	std::string name;
+	std::size_t bytesTouched;
+	bool inPlace; //Works on dst in place rather than reading src
+	std::function<void()> run;
+};
+
+
+
+//Run _kernel from the same starting state (src copied into dst for in-place kernels, dst cleared otherwise) with each supported instruction set, and compare the output to the scalar implementation's
+bool VerifyKernel(const Kernel& _kernel, const std::vector<unsigned char>& _src, std::vector<unsigned char>& _dst, std::vector<std::uint16_t>& _dstHalf)
+{
+	const auto runFromStart{ [&](Neki::PIXEL_KERNEL_ISA _isa)
+	{
+		Neki::PixelKernels::SetISA(_isa);
+		if (_kernel.inPlace) { std::copy(_src.begin(), _src.end(), _dst.begin()); }
+		else { std::fill(_dst.begin(), _dst.end(), static_cast<unsigned char>(0)); }
+		std::fill(_dstHalf.begin(), _dstHalf.end(), static_cast<std::uint16_t>(0));
+		_kernel.run();
+	} };
+
+	runFromStart(Neki::PIXEL_KERNEL_ISA::SCALAR);
+	const std::vector<unsigned char> expected{ _dst };
+	const std::vector<std::uint16_t> expectedHalf{ _dstHalf };
+
+	bool matches{ true };
+	for (std::uint32_t isa{ 1 }; isa <= static_cast<std::uint32_t>(Neki::PixelKernels::GetSupportedISA()); ++isa)
+	{
+		runFromStart(static_cast<Neki::PIXEL_KERNEL_ISA>(isa));
+		const auto mismatch{ std::mismatch(_dst.begin(), _dst.end(), expected.begin()) };
+		const auto mismatchHalf{ std::mismatch(_dstHalf.begin(), _dstHalf.end(), expectedHalf.begin()) };
+		if (mismatch.first != _dst.end())
+		{
+			std::cout << _kernel.name << ": " << Neki::PixelKernels::GetISAName(static_cast<Neki::PIXEL_KERNEL_ISA>(isa)) << " output differs from SCALAR at byte " << (mismatch.first - _dst.begin())
+			          << " (" << static_cast<int>(*mismatch.first) << " vs " << static_cast<int>(*mismatch.second) << ")\n";
+			matches = false;
+		}
+		if (mismatchHalf.first != _dstHalf.end())
+		{
+			std::cout << _kernel.name << ": " << Neki::PixelKernels::GetISAName(static_cast<Neki::PIXEL_KERNEL_ISA>(isa)) << " output differs from SCALAR at half " << (mismatchHalf.first - _dstHalf.begin())
+			          << " (0x" << std::hex << *mismatchHalf.first << " vs 0x" << *mismatchHalf.second << std::dec << ")\n";
+			matches = false;
+		}
+	}
+	return matches;
+}
+
+
+
+int main()
+{
+	std::vector<unsigned char> src(TEXEL_COUNT * 4);
+	std::vector<unsigned char> dst(TEXEL_COUNT * 4);
+	std::vector<std::uint16_t> dstHalf(TEXEL_COUNT * 4);
+	std::mt19937 rng{ 0 };
+	for (unsigned char& byte : src) { byte = static_cast<unsigned char>(rng()); }
+
+	const std::vector<Kernel> kernels
+	{
+		{ "RGB -> RGBA", TEXEL_COUNT * (3 + 4), false, [&](){ Neki::PixelKernels::ConvertChannels(src.data(), TEXEL_COUNT, 3, 4, dst.data()); } },
+		{ "Grey -> RGBA", TEXEL_COUNT * (1 + 4), false, [&](){ Neki::PixelKernels::ConvertChannels(src.data(), TEXEL_COUNT, 1, 4, dst.data()); } },
+		{ "Grey + alpha -> RGBA", TEXEL_COUNT * (2 + 4), false, [&](){ Neki::PixelKernels::ConvertChannels(src.data(), TEXEL_COUNT, 2, 4, dst.data()); } },
+		{ "RGBA -> RGB", TEXEL_COUNT * (4 + 3), false, [&](){ Neki::PixelKernels::ConvertChannels(src.data(), TEXEL_COUNT, 4, 3, dst.data()); } },
+		{ "Vertical flip (RGBA)", TEXEL_COUNT * 4 * 2, true, [&](){ Neki::PixelKernels::FlipVertically(dst.data(), WIDTH * 4, HEIGHT); } },
+		{ "Premultiply alpha", TEXEL_COUNT * 4 * 2, true, [&](){ Neki::PixelKernels::Premultiply(dst.data(), TEXEL_COUNT); } },
+		{ "sRGB -> linear (RGBA)", TEXEL_COUNT * 4 * 2, false, [&](){ Neki::PixelKernels::SrgbToLinear(src.data(), TEXEL_COUNT, 4, dst.data()); } },
+		{ "Linear -> sRGB (RGBA)", TEXEL_COUNT * 4 * 2, false, [&](){ Neki::PixelKernels::LinearToSrgb(src.data(), TEXEL_COUNT, 4, dst.data()); } },
+		{ "RGBA8 -> RGBA16F", TEXEL_COUNT * (4 + 8), false, [&](){ Neki::PixelKernels::ConvertRGBA8ToRGBA16F(src.data(), TEXEL_COUNT, false, dstHalf.data()); } },
+		{ "RGBA8 sRGB -> RGBA16F", TEXEL_COUNT * (4 + 8), false, [&](){ Neki::PixelKernels::ConvertRGBA8ToRGBA16F(src.data(), TEXEL_COUNT, true, dstHalf.data()); } },
+	};
+
+	bool allMatch{ true };
+	for (const Kernel& kernel : kernels)
+	{
+		allMatch = VerifyKernel(kernel, src, dst, dstHalf) && allMatch;
+	}
+	Neki::PixelKernels::SetISA(Neki::PixelKernels::GetSupportedISA());
+	if (!allMatch)
+	{
+		std::cout << "Instruction set implementations don't match the scalar implementation - not benchmarking\n";
+		return 1;
+	}
+
+	std::cout << "Pixel kernel throughput (" << WIDTH << "x" << HEIGHT << ", GB/s, best of " << RUNS << " runs)\n";
+	std::cout << "Supported instruction set: " << Neki::PixelKernels::GetISAName(Neki::PixelKernels::GetSupportedISA()) << "\n\n";
+	std::cout << std::left << std::setw(24) << "Kernel";
+	for (std::uint32_t isa{ 0 }; isa <= static_cast<std::uint32_t>(Neki::PixelKernels::GetSupportedISA()); ++isa)
+	{
+		std::cout << std::right << std::setw(10) << Neki::PixelKernels::GetISAName(static_cast<Neki::PIXEL_KERNEL_ISA>(isa));
+	}
+	std::cout << "\n";
+
+	for (const Kernel& kernel : kernels)
+	{
+		std::cout << std::left << std::setw(24) << kernel.name;
+		for (std::uint32_t isa{ 0 }; isa <= static_cast<std::uint32_t>(Neki::PixelKernels::GetSupportedISA()); ++isa)
+		{
+			Neki::PixelKernels::SetISA(static_cast<Neki::PIXEL_KERNEL_ISA>(isa));
+			std::cout << std::right << std::setw(10) << std::fixed << std::setprecision(2) << MeasureGBPerSecond(kernel.bytesTouched, kernel.run);
+		}
+		std::cout << "\n";
+	}
+	Neki::PixelKernels::SetISA(Neki::PixelKernels::GetSupportedISA());
+
+	return 0;
+}
\ No newline at end of file
@@ -12,28 +12,55 @@ layout(set = 1, binding = 4) uniform sampler2DArray roughnessSampler;
 layout(set = 1, binding = 5) uniform sampler2DArray aoSampler;
 layout(set = 1, binding = 6) uniform sampler2DArray emissiveSampler;
 
+//Where each of a material's textures sits within its image array (see TextureAtlasRegion) - indexed by materialIndex * 7 + texture type
+struct AtlasRegion
+{
+    vec2 uvScale;
+    vec2 uvOffset;
+    uint layer;
+    uint padding;
+};
+
+layout(set = 0, binding = 1) readonly buffer AtlasRegions
+{
+    AtlasRegion regions[];
+} atlasRegions;
+
+layout(push_constant) uniform DrawData
+{
+    layout(offset = 72) uint materialIndex;
+} drawData;
+
 layout(location = 0) out vec4 outColour;
 
+
+vec3 AtlasCoord(uint textureType)
+{
+    AtlasRegion region = atlasRegions.regions[drawData.materialIndex * 7 + textureType];
+    return vec3(TexCoord * region.uvScale + region.uvOffset, float(region.layer));
+}
+
+
 void main()
 {
     //todo: implement cook-torrance pbr brdf with these - this will probably be done in VulkanPBR repo (https://github.com/Kahoneki/VulkanPBR)
-    float metallic = texture(metallicSampler, vec3(TexCoord, 0)).g;
-    float roughness = texture(roughnessSampler, vec3(TexCoord, 0)).b;
+    float metallic = texture(metallicSampler, AtlasCoord(3)).g;
+    float roughness = texture(roughnessSampler, AtlasCoord(4)).b;
     
     vec3 lightPos = vec3(1,-1,1);
     vec3 lightColour = vec3(0.1,0.2,0.1);
     
-    vec3 albedo = texture(albedoSampler, vec3(TexCoord, 0)).rgb;
-    vec3 tangentNormal = texture(normalSampler, vec3(TexCoord, 0)).rgb * 2.0 - 1.0;
+    vec3 albedo = texture(albedoSampler, AtlasCoord(0)).rgb;
+    vec3 tangentNormal = texture(normalSampler, AtlasCoord(1)).rgb * 2.0 - 1.0;
     vec3 worldNormal = normalize(TBN * tangentNormal);
     
     float ambientStrength = 0.01;
-    vec3 ambient = (ambientStrength * lightColour) * texture(aoSampler, vec3(TexCoord, 0)).r;
+    vec3 ambient = (ambientStrength * lightColour) * texture(aoSampler, AtlasCoord(5)).r;
     vec3 lightDir = normalize(lightPos - FragPos);
     float diff = max(dot(worldNormal, lightDir), 0.0);
     vec3 diffuse = diff * lightColour;
     
-    vec3 finalColour = ((ambient + diffuse) * albedo) + texture(emissiveSampler, vec3(TexCoord, 0)).rgb;
+    vec3 finalColour = ((ambient + diffuse) * albedo) + texture(emissiveSampler, AtlasCoord(6)).rgb;
     
     outColour = vec4(finalColour, 1.0);
 }
\ No newline at end of file
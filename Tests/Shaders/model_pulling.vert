@@ -0,0 +1,49 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_scalar_block_layout : require
+
+//Vertex pulling variant of model.vert for ModelFactory's MODEL_VERTEX_INPUT::DEVICE_ADDRESS mode - no vertex input, vertices are read from GPUMesh::vertexAddress
+struct ModelVertex
+{
+    vec3 position;
+    vec3 normal;
+    vec2 texCoord;
+    vec3 tangent;
+    vec3 bitangent;
+};
+
+layout(buffer_reference, scalar) readonly buffer Vertices
+{
+    ModelVertex v[];
+};
+
+layout(set = 0, binding = 0) uniform CameraData
+{
+    mat4 view;
+    mat4 proj;
+} cameraData;
+
+layout(push_constant) uniform ModelData
+{
+    mat4 model;
+    Vertices vertices;
+} modelData;
+
+layout(location = 0) out vec2 TexCoord;
+layout(location = 1) out vec3 FragPos;
+layout(location = 2) out vec3 WorldNormal;
+layout(location = 3) out mat3 TBN;
+
+
+void main()
+{
+    ModelVertex vertex = modelData.vertices.v[gl_VertexIndex];
+    TexCoord = vertex.texCoord;
+    gl_Position = cameraData.proj * cameraData.view * modelData.model * vec4(vertex.position, 1.0);
+    FragPos = vec3(modelData.model * vec4(vertex.position, 1.0));
+    vec3 T = normalize(vec3(modelData.model * vec4(vertex.tangent, 0.0)));
+    vec3 B = normalize(vec3(modelData.model * vec4(vertex.bitangent, 0.0)));
+    vec3 N = normalize(vec3(modelData.model * vec4(vertex.normal, 0.0)));
+    TBN = mat3(T,B,N);
+    WorldNormal = N;
+}
\ No newline at end of file
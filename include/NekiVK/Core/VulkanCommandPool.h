@@ -17,8 +17,9 @@ namespace Neki
 	{
 		GRAPHICS = 0,
 		COMPUTE = 1,
+		TRANSFER = 2, //Uses the device's transfer queue family (the graphics family if there isn't a dedicated one)
 		
-		MAX_ENUM = 2,
+		MAX_ENUM = 3,
 	};
 
 	class VulkanCommandPool
@@ -3,17 +3,21 @@
 
 #include <vulkan/vulkan.h>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "../Debug/VKDebugAllocator.h"
 #include "../Debug/VKLogger.h"
 
 
-//Responsible for the initialisation, ownership, and clean shutdown of a VkInstance, VkDevice, and VkQueue
+//Responsible for the initialisation, ownership, and clean shutdown of a VkInstance, VkDevice, and its graphics and transfer VkQueues
 
 namespace Neki
 {
 
+	class MemoryTypeSelector;
+
 	class VulkanDevice
 	{
 	public:
@@ -34,6 +38,28 @@ namespace Neki
 		[[nodiscard]] const VkDevice& GetDevice() const;
 		[[nodiscard]] const VkQueue& GetGraphicsQueue() const;
 		[[nodiscard]] const std::size_t& GetGraphicsQueueFamilyIndex() const;
+		[[nodiscard]] const VkQueue& GetTransferQueue() const; //The same queue as GetGraphicsQueue() if there's no dedicated transfer queue family
+		[[nodiscard]] const std::size_t& GetTransferQueueFamilyIndex() const;
+		[[nodiscard]] std::uint32_t GetInstanceApiVersion() const;
+		[[nodiscard]] std::uint32_t GetDeviceApiVersion() const; //The version of device-level functionality that can be used (the lower of the instance's API version and the physical device's)
+
+		//Returns true if the bufferDeviceAddress feature was enabled (Vulkan 1.2, or Vulkan 1.1 with VK_KHR_buffer_device_address)
+		[[nodiscard]] bool IsBufferDeviceAddressEnabled() const;
+		//Returns true if the scalarBlockLayout feature was enabled (Vulkan 1.2) - needed to read tightly packed structs (e.g.: ModelVertex) with GL_EXT_scalar_block_layout
+		[[nodiscard]] bool IsScalarBlockLayoutEnabled() const;
+
+		//Returns true if uploads are submitted to a queue family other than the graphics one (false on single-queue devices such as lavapipe)
+		[[nodiscard]] bool HasDedicatedTransferQueue() const;
+
+		//Returns true if _extensionName was enabled at instance/device creation (either requested by the user or enabled automatically by NekiVK)
+		[[nodiscard]] bool IsInstanceExtensionEnabled(const char* _extensionName) const;
+		[[nodiscard]] bool IsDeviceExtensionEnabled(const char* _extensionName) const;
+
+		//Get the memory type selector shared by all factories using this device
+		[[nodiscard]] MemoryTypeSelector& GetMemoryTypeSelector() const;
+
+		//Returns true if _format supports all of _features with the given tiling
+		[[nodiscard]] bool IsFormatSupported(VkFormat _format, VkImageTiling _tiling, VkFormatFeatureFlags _features) const;
 
 		//Finds a supported format from the list of _candidates for a given tiling and feature set
 		[[nodiscard]] VkFormat FindSupportedFormat(const std::vector<VkFormat>& _candidates, VkImageTiling _tiling, VkFormatFeatureFlags _features) const;
@@ -55,6 +81,19 @@ namespace Neki
 		std::size_t graphicsQueueFamilyIndex;
 		VkQueue graphicsQueue;
 
+		//Queue that uploads are submitted to - a transfer-only family if the device has one, otherwise the graphics queue
+		std::size_t transferQueueFamilyIndex;
+		VkQueue transferQueue;
+
+		std::uint32_t instanceApiVersion;
+		std::uint32_t deviceApiVersion;
+		bool bufferDeviceAddressEnabled;
+		bool scalarBlockLayoutEnabled;
+		std::vector<std::string> enabledInstanceExtensions;
+		std::vector<std::string> enabledDeviceExtensions;
+
+		std::unique_ptr<MemoryTypeSelector> memoryTypeSelector;
+
 
 		void CreateInstance(const std::uint32_t _apiVer, const char* _appName, std::uint32_t _desiredInstanceLayerCount, const char** const _desiredInstanceLayers, std::uint32_t _desiredInstanceExtensionCount, const char** const _desiredInstanceExtensions);
 		void SelectPhysicalDevice();
@@ -4,6 +4,8 @@
 #include "VulkanCommandPool.h"
 #include "VulkanSwapchain.h"
 #include "../Memory/ImageFactory.h"
+#include "../Memory/FrameLinearAllocator.h"
+#include "../Memory/GrowableBuffer.h"
 
 
 //Responsible for the initialisation, ownership, and clean shutdown of a GLFWwindow, VkSurfaceKHR, VkSwapchainKHR, VkImage (depthTexture), VkImageView (depthTextureView), VkRenderPass, and all accompanying sync objects
@@ -75,7 +77,23 @@ public:
 	void StartFrame(std::uint32_t _clearValueCount, const VkClearValue* _clearValues);
 	void SubmitAndPresent();
 
+	//Reset _frameAllocator's region for the current frame in StartFrame, once the frame's fence has signalled
+	//_frameAllocator must have been created with the same number of frames in flight, and must outlive the render manager (or be detached first)
+	void AttachFrameAllocator(FrameLinearAllocator& _frameAllocator);
+	void DetachFrameAllocator(FrameLinearAllocator& _frameAllocator);
+
+	//Advance _growableBuffer's retired buffers in StartFrame, once the frame's fence has signalled
+	//_growableBuffer must have been created with the same number of frames in flight, and must outlive the render manager (or be detached first)
+	void AttachGrowableBuffer(GrowableBuffer& _growableBuffer);
+	void DetachGrowableBuffer(GrowableBuffer& _growableBuffer);
+
+	//Make the next SubmitAndPresent() wait on _semaphore (signalled by other GPU work, e.g.: UploadBatch::GetCompletionSemaphore()) before _waitStage
+	//Only applies to the next submission - call again each frame that needs to wait
+	void WaitOnSemaphore(VkSemaphore _semaphore, VkPipelineStageFlags _waitStage);
+
 	[[nodiscard]] VkCommandBuffer GetCurrentCommandBuffer();
+	[[nodiscard]] std::size_t GetCurrentFrameIndex() const;
+	[[nodiscard]] std::size_t GetFramesInFlight() const;
 	[[nodiscard]] VkRenderPass GetRenderPass();
 	[[nodiscard]] VkImageView GetFramebufferImageView(std::size_t _index);
 
@@ -98,7 +116,7 @@ private:
 	VkRenderPass renderPass;
 
 	//For framebuffer
-	std::vector<VkImage> framebufferImages; //Contains all non-swapchain images
+	std::vector<ImageHandle> framebufferImages; //Contains all non-swapchain images
 	std::vector<VkImageView> framebufferImageViews;
 	std::vector<VkFramebuffer> swapchainFramebuffers;
 	
@@ -110,8 +128,13 @@ private:
 	std::uint32_t imageIndex; //The index of the image to be rendered to on the current frame (acquired from the swapchain)
 	std::size_t currentFrame; //The index of the current frame in flight to be rendered to
 	std::size_t framesInFlight; //The total number of frames in flight (currentFrame = (0, framesInFlight])
+	std::vector<VkSemaphore> additionalWaitSemaphores; //Waited on (alongside imageAvailableSemaphores[currentFrame]) by the next submission, then cleared - from WaitOnSemaphore()
+	std::vector<VkPipelineStageFlags> additionalWaitStages; //additionalWaitStages[i] is the stage that waits on additionalWaitSemaphores[i]
 	
 	std::vector<VkCommandBuffer> commandBuffers;
+
+	std::vector<FrameLinearAllocator*> frameAllocators;
+	std::vector<GrowableBuffer*> growableBuffers;
 };
 }
 
@@ -3,13 +3,20 @@
 
 #include "../Core/VulkanCommandPool.h"
 #include "../Core/VulkanDevice.h"
+#include "DeviceMemoryHeap.h"
+#include "ResourceHandles.h"
+#include "StagingRing.h"
+#include "UploadBatch.h"
+
+#include <memory>
 
 //Responsible for the initialisation, ownership, and clean shutdown of VkBuffers and accompanying VkDeviceMemorys
+//Buffer memory is sub-allocated from large VkDeviceMemory blocks (see DeviceMemoryHeap) - buffers are not bound at offset 0
+//Buffers are referred to by generational BufferHandles - use GetBuffer() to get the underlying VkBuffer
 namespace Neki
 {
 
 
-//For internal use only
 struct BufferMetadata
 {
 	VkDeviceSize size;
@@ -30,32 +37,164 @@ public:
 	~BufferFactory();
 
 	//Allocate a single buffer
-	[[nodiscard]] VkBuffer AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode=VK_SHARING_MODE_EXCLUSIVE, const VkMemoryPropertyFlags _requiredMemFlags=0);
+	//The buffer's memory type must have all of _requiredMemFlags - among those, the one with the most _preferredMemFlags (and fewest unrequested flags) is chosen
+	//e.g.: _requiredMemFlags=HOST_VISIBLE, _preferredMemFlags=DEVICE_LOCAL to use resizable BAR memory where it's available and plain host memory where it isn't
+	[[nodiscard]] BufferHandle AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode=VK_SHARING_MODE_EXCLUSIVE, const VkMemoryPropertyFlags _requiredMemFlags=0, const VkMemoryPropertyFlags _preferredMemFlags=0);
 
 	//Allocate multiple buffers from this pool
-	[[nodiscard]] std::vector<VkBuffer> AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes=nullptr, const VkMemoryPropertyFlags* _requiredMemFlags=nullptr);
+	//All buffers are created first, then the buffers sharing a memory type are packed back to back into a single region of memory and bound together
+	//(A pack's memory is only returned to the heap once every buffer in it has been freed - allocate buffers that live and die together, e.g.: a model's meshes)
+	[[nodiscard]] std::vector<BufferHandle> AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes=nullptr, const VkMemoryPropertyFlags* _requiredMemFlags=nullptr, const VkMemoryPropertyFlags* _preferredMemFlags=nullptr);
 
-	//Free a specific buffer
-	void FreeBuffer(VkBuffer& _buffer);
+	//Free a specific buffer (_buffer is reset to a null handle - any other copies of it become stale)
+	void FreeBuffer(BufferHandle& _buffer);
 
 	//Free a list of _count buffers
-	void FreeBuffers(std::uint32_t _count, VkBuffer* _buffers);
+	void FreeBuffers(std::uint32_t _count, BufferHandle* _buffers);
 
 	//Copies a host-visible buffer to a new device-local buffer and deletes the source buffer
 	//Buffer must have been allocated with BufferFactory
 	//The source buffer must have been created with the VK_BUFFER_USAGE_TRANSFER_SRC_BIT flag
 	//Optionally, set freeSourceBuffer=true to free the source buffer (note this will invalidate any currently active memory maps on the source buffer)
 	//Optionally, pass a (already begun) command buffer to this function and the barrier command will be recorded to it but not executed
-	//Leaving _commandBuffer as nullptr will cause the function to allocate its own command buffer and automatically submit it
-	VkBuffer TransferToDeviceLocalBuffer(VkBuffer& _buffer, bool _freeSourceBuffer=false, VkCommandBuffer* _commandBuffer=nullptr);
+	//Leaving _commandBuffer as nullptr will cause the function to submit the copy and block until it has completed - prefer the UploadBatch overload when transferring multiple buffers
+	BufferHandle TransferToDeviceLocalBuffer(BufferHandle& _buffer, bool _freeSourceBuffer=false, VkCommandBuffer* _commandBuffer=nullptr);
+
+	//Records a copy of a host-visible buffer to a new device-local buffer into _uploadBatch
+	//The returned buffer is only populated once _uploadBatch has completed
+	//(When IsDirectWriteAvailable(), both TransferToDeviceLocalBuffer() overloads copy on the host instead and the returned buffer is populated immediately)
+	//Optionally, set freeSourceBuffer=true to free the source buffer once _uploadBatch has completed
+	BufferHandle TransferToDeviceLocalBuffer(BufferHandle& _buffer, UploadBatch& _uploadBatch, bool _freeSourceBuffer=false);
+
+	//Allocate a device-local buffer populated with _size bytes from _data
+	//If the device's main device-local heap is host-visible (resizable BAR, UMA, etc. - see IsDirectWriteAvailable()), _data is written straight into the buffer and nothing is recorded to _uploadBatch
+	//Otherwise, the upload is recorded into _uploadBatch through the staging ring, and the buffer is only populated once _uploadBatch has completed
+	[[nodiscard]] BufferHandle AllocateDeviceLocalBuffer(const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, UploadBatch& _uploadBatch, VkSharingMode _sharingMode=VK_SHARING_MODE_EXCLUSIVE);
+
+	//Allocate _count device-local buffers populated with _sizes[i] bytes from _data[i], packed together as with AllocateBuffers()
+	//Each buffer is written directly or uploaded through _uploadBatch as with AllocateDeviceLocalBuffer()
+	[[nodiscard]] std::vector<BufferHandle> AllocateDeviceLocalBuffers(std::uint32_t _count, const void** _data, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, UploadBatch& _uploadBatch);
+
+	//Returns true if device-local buffers can be written directly by the host, skipping the staging ring and copy commands
+	[[nodiscard]] bool IsDirectWriteAvailable() const;
+
+	//Create a buffer backed by the host memory at _hostPointer itself (VK_EXT_external_memory_host) - nothing is copied, the device accesses _hostPointer directly
+	//Useful as the source of a copy into a device-local buffer, skipping the memcpy into the staging ring (see HostArena for allocations that qualify)
+	//_hostPointer and _size must be multiples of GetHostImportAlignment(), and the host memory must stay allocated until the buffer is freed
+	//Returns a null handle if host memory can't be imported on this device or the driver rejects _hostPointer - fall back to a regular upload in that case
+	[[nodiscard]] BufferHandle ImportHostBuffer(void* _hostPointer, VkDeviceSize _size, VkBufferUsageFlags _usage);
+
+	[[nodiscard]] bool IsHostImportAvailable() const;
+	[[nodiscard]] VkDeviceSize GetHostImportAlignment() const; //minImportedHostPointerAlignment (0 if host memory can't be imported)
+
+	//Record an incremental defragmentation pass into _uploadBatch, moving at most _maxBytesToMove bytes of buffers out of each memory type's sparsest block and into its denser ones
+	//Handles are remapped to the moved buffers once _uploadBatch completes (until then they keep referring to the originals), but the VkBuffer behind a moved handle changes
+	//Fetch GetBuffer() when recording commands rather than keeping it in command buffers that are recorded once and resubmitted - the original is destroyed once the graphics queue has finished with it
+	//Call once per frame with a small budget to compact memory without stalling rendering - returns the number of bytes moved (0 once there's nothing left worth moving)
+	//Poll _uploadBatch between frames (not while a frame is being recorded), so that no frame records the original after its replacement has taken over
+	//Buffers in a pack (see AllocateBuffers()), buffers allocated with HOST_VISIBLE in _requiredMemFlags, buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, and imported buffers are never moved
+	//Neither are uniform, storage, or texel buffers - descriptor sets and buffer views written with them would otherwise be left pointing at the destroyed original
+	//Note: GPU writes to a buffer between this being called and _uploadBatch completing will be lost - don't defragment while buffers are being written to by the GPU
+	VkDeviceSize Defragment(UploadBatch& _uploadBatch, VkDeviceSize _maxBytesToMove);
+
+	//Create a new upload batch that records into a command buffer from this factory's command pool (or from its transfer command pool if the device has a dedicated transfer queue)
+	[[nodiscard]] std::unique_ptr<UploadBatch> CreateUploadBatch();
+
+	//Hand _buffer to _uploadBatch's transfer queue with its contents intact, and back to the graphics queue once the batch's transfer commands have run (see UploadBatch::AcquireBuffer() / ReleaseBuffer())
+	//Needed around any copy to or from _buffer recorded with UploadBatch::CopyBuffer() - a no-op for CONCURRENT buffers and on devices without a dedicated transfer queue
+	void RecordOwnershipTransfers(BufferHandle _buffer, UploadBatch& _uploadBatch) const;
+
+	//Records a copy of _size bytes from host memory (_data) into _dstBuffer at _dstOffset via the staging ring
+	//_dstBuffer must have been created with the VK_BUFFER_USAGE_TRANSFER_DST_BIT flag, and is only populated once _uploadBatch has completed
+	//Uploads larger than the staging ring's maximum allocation size are streamed through it in chunks
+	void UploadToBuffer(BufferHandle _dstBuffer, const void* _data, VkDeviceSize _size, UploadBatch& _uploadBatch, VkDeviceSize _dstOffset=0);
+
+	//Get the staging ring shared by all factory uploads (created on first use)
+	[[nodiscard]] StagingRing& GetStagingRing();
+
+
+	//Returns false if _buffer is null or has been freed
+	[[nodiscard]] bool IsValid(BufferHandle _buffer) const;
+
+	//Get the VkBuffer _buffer refers to (for recording commands and writing descriptors)
+	[[nodiscard]] VkBuffer GetBuffer(BufferHandle _buffer) const;
+
+	//Get the size, usage, sharing mode, and required memory flags _buffer was allocated with
+	[[nodiscard]] const BufferMetadata& GetMetadata(BufferHandle _buffer) const;
+
+	//Get the memory region _buffer is bound to (the underlying VkDeviceMemory is shared with other buffers - always respect the offset)
+	[[nodiscard]] const MemoryAllocation& GetMemory(BufferHandle _buffer) const;
+
+	//Get a pointer to the start of a HOST_VISIBLE buffer's memory
+	//HOST_VISIBLE memory is mapped once and stays mapped for the buffer's lifetime - never call vkMapMemory on a buffer's memory, as the underlying VkDeviceMemory is shared with other buffers
+	[[nodiscard]] void* GetMappedPointer(BufferHandle _buffer) const;
+
+	//Get the GPU virtual address of _buffer for shaders to access it through (GL_EXT_buffer_reference) - stable for the buffer's lifetime
+	//_buffer must have been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, and buffer device addresses must be enabled (see VulkanDevice::IsBufferDeviceAddressEnabled())
+	[[nodiscard]] VkDeviceAddress GetDeviceAddress(BufferHandle _buffer) const;
+
+	//Get live and peak memory usage of the factory's buffers per memory type (see DumpMemoryReport() to write it out as JSON)
+	//Imported buffers (see ImportHostBuffer()) aren't included, as their memory belongs to the host allocation they were imported from
+	[[nodiscard]] MemoryStatistics GetMemoryStatistics() const;
 
+	//Make host writes to [_offset, _offset + _size) of a HOST_VISIBLE buffer visible to the device (required after writing to non-HOST_COHERENT memory)
+	void FlushBuffer(BufferHandle _buffer, VkDeviceSize _offset=0, VkDeviceSize _size=VK_WHOLE_SIZE) const;
 
-	[[nodiscard]] VkDeviceMemory GetMemory(VkBuffer _buffer);
+	//Make device writes to [_offset, _offset + _size) of a HOST_VISIBLE buffer visible to the host (required before reading from non-HOST_COHERENT memory)
+	void InvalidateBuffer(BufferHandle _buffer, VkDeviceSize _offset=0, VkDeviceSize _size=VK_WHOLE_SIZE) const;
 
 	
 private:
-	[[nodiscard]] VkBuffer AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags);
-	void FreeBufferImpl(VkBuffer& _buffer);
+	//Everything the factory knows about a buffer, stored densely in a slot map
+	struct BufferRecord
+	{
+		VkBuffer buffer;
+		MemoryAllocation allocation;
+		BufferMetadata metadata;
+		std::uint32_t packIndex; //UINT32_MAX if the buffer has its own allocation, otherwise the index into packs of the region it shares
+		bool moving; //True while a defragmentation pass is copying the buffer
+		void* importedPointer; //The host allocation the buffer's memory was imported from, nullptr if the memory came from memoryHeap
+	};
+
+	//A buffer that has been moved or freed, but which the GPU may still be using
+	struct RetiredBuffer
+	{
+		VkBuffer buffer;
+		MemoryAllocation allocation;
+		VkFence fence; //Signalled once every graphics queue submission that could reference the buffer has completed - VK_NULL_HANDLE while a move is still copying out of it
+	};
+
+	//Every buffer is created with these usage flags (on top of the ones requested) so that it can be moved by Defragment()
+	static constexpr VkBufferUsageFlags MOVABLE_USAGE_FLAGS{ VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+	//Buffers with any of these usage flags are referenced by descriptors (or buffer views) that Defragment() can't rewrite, so they're never moved
+	static constexpr VkBufferUsageFlags DESCRIPTOR_USAGE_FLAGS{ VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT };
+
+	//A single region of memory shared by buffers allocated together through AllocateBuffers()
+	struct BufferPack
+	{
+		MemoryAllocation allocation;
+		std::uint32_t liveBuffers;
+	};
+
+	[[nodiscard]] BufferHandle AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags, const VkMemoryPropertyFlags _preferredMemFlags);
+	[[nodiscard]] std::vector<BufferHandle> AllocateBuffersPacked(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, const VkMemoryPropertyFlags* _requiredMemFlags, const VkMemoryPropertyFlags* _preferredMemFlags);
+
+	[[nodiscard]] static std::string GetMemoryPropertyFlagsString(VkMemoryPropertyFlags _flags);
+	void FreeBufferImpl(BufferHandle& _buffer);
+
+	//Point _buffer at its replacement once a defragmentation move out of _oldBuffer has completed, retiring _oldBuffer
+	void CompleteMove(BufferHandle _buffer, VkBuffer _oldBuffer, VkBuffer _newBuffer, const MemoryAllocation& _newAllocation);
+	//Release _buffer once all work submitted to the graphics queue so far has completed
+	void RetireBuffer(VkBuffer _buffer, const MemoryAllocation& _allocation);
+	//Release the retired buffers the GPU has finished with, optionally waiting until it has finished with all of them
+	void ReleaseRetiredBuffers(bool _wait);
+	//Allocate the device-local copy of _buffer, copying into it on the host if it's host-visible (_out_copied is set to whether or not it was)
+	[[nodiscard]] BufferHandle TransferToDeviceLocalBufferImpl(BufferHandle _buffer, bool& _out_copied);
+
+	[[nodiscard]] bool DetectDirectWrite() const;
+
+	//Look up _buffer's record, logging an error and throwing if _buffer is null or stale
+	[[nodiscard]] const BufferRecord& GetRecord(BufferHandle _buffer) const;
 	
 	//Dependency injections from VKApp
 	const VKLogger& logger;
@@ -63,8 +202,19 @@ private:
 	const VulkanDevice& device;
 	VulkanCommandPool& commandPool;
 
-	std::unordered_map<VkBuffer, VkDeviceMemory> bufferMemoryMap;
-	std::unordered_map<VkBuffer, BufferMetadata> bufferMetadataMap;
+	DeviceMemoryHeap memoryHeap;
+	slot_map<BufferRecord, BufferHandleTag> buffers;
+	std::vector<BufferPack> packs;
+	std::vector<std::uint32_t> freePackIndices;
+	std::vector<RetiredBuffer> retiredBuffers; //Released as moves complete and passes are recorded, once their fences have been signalled
+
+	std::unique_ptr<VulkanCommandPool> transferCommandPool; //nullptr if the device has no dedicated transfer queue
+	std::unique_ptr<StagingRing> stagingRing;
+	bool directWriteAvailable;
+	PFN_vkBindBufferMemory2 bindBufferMemory2; //nullptr if neither Vulkan 1.1 nor VK_KHR_bind_memory2 is available
+	PFN_vkGetBufferDeviceAddress getBufferDeviceAddress; //nullptr if buffer device addresses aren't enabled
+	PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties; //nullptr if VK_EXT_external_memory_host isn't enabled
+	VkDeviceSize hostImportAlignment;
 };
 
 
@@ -0,0 +1,123 @@
+#ifndef DEVICEMEMORYHEAP_H
+#define DEVICEMEMORYHEAP_H
+
+#include "../Core/VulkanDevice.h"
+#include "../Utils/Allocators/TLSFAllocator.h"
+#include "MemoryStatistics.h"
+#include "MemoryTypeSelector.h"
+
+#include <memory>
+
+
+//Responsible for the initialisation, ownership, and clean shutdown of large VkDeviceMemory blocks (one set per memory type) and the sub-allocation of aligned regions from them
+namespace Neki
+{
+
+
+//A sub-allocated region of a VkDeviceMemory block
+struct MemoryAllocation
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	std::uint32_t memoryTypeIndex;
+
+	//For internal use only
+	std::uint32_t blockIndex;
+	std::uint32_t node;
+};
+
+
+class DeviceMemoryHeap
+{
+public:
+	explicit DeviceMemoryHeap(const VKLogger& _logger,
+	                          VKDebugAllocator& _deviceDebugAllocator,
+	                          const VulkanDevice& _device,
+	                          VK_LOGGER_LAYER _layer,
+	                          VkDeviceSize _preferredBlockSize = 64 * 1024 * 1024);
+
+	~DeviceMemoryHeap();
+
+	//Sub-allocate a region satisfying _requirements from a block of memory type _memoryTypeIndex
+	//A new block will only be allocated with vkAllocateMemory if no existing block of the memory type has room
+	//Requests larger than half the block size (or with _dedicated=true) are given their own VkDeviceMemory
+	[[nodiscard]] MemoryAllocation Allocate(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, bool _dedicated = false);
+
+	//Sub-allocate a region satisfying _requirements from the memory type the device's MemoryTypeSelector ranks best for _requiredFlags and _preferredFlags
+	//If that memory type's heap turns out to be exhausted, the next best memory type is tried instead - this only throws once no compatible memory type has room
+	[[nodiscard]] MemoryAllocation AllocateByFlags(const VkMemoryRequirements& _requirements, VkMemoryPropertyFlags _requiredFlags, VkMemoryPropertyFlags _preferredFlags, bool _dedicated = false);
+
+	//Get the shared block of _memoryTypeIndex that is the best candidate for evacuation by defragmentation - the least occupied non-empty one
+	//Returns UINT32_MAX if the memory type has fewer than 2 non-empty shared blocks, or if the other blocks don't have enough free space to take everything in the candidate
+	[[nodiscard]] std::uint32_t GetSparsestBlock(std::uint32_t _memoryTypeIndex) const;
+
+	//Sub-allocate a region satisfying _requirements from an existing, non-empty shared block of _memoryTypeIndex other than _excludedBlockIndex
+	//Never allocates a new block - returns false if none of the candidate blocks have room
+	[[nodiscard]] bool AllocateForMove(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, std::uint32_t _excludedBlockIndex, MemoryAllocation& _out_allocation);
+
+	//Return a region to its block - empty blocks are released back to the driver (one is kept around per memory type to avoid thrashing)
+	void Free(const MemoryAllocation& _allocation);
+
+	//Get a pointer to the start of _allocation - blocks of HOST_VISIBLE memory types are mapped once when they're created and stay mapped until they're freed
+	//Returns nullptr if _allocation's memory type isn't HOST_VISIBLE
+	[[nodiscard]] void* GetMappedPointer(const MemoryAllocation& _allocation) const;
+
+	//Make host writes to [_offset, _offset + _size) of _allocation visible to the device / device writes visible to the host
+	//Ranges are expanded to nonCoherentAtomSize boundaries internally - both are no-ops for HOST_COHERENT memory types
+	void Flush(const MemoryAllocation& _allocation, VkDeviceSize _offset = 0, VkDeviceSize _size = VK_WHOLE_SIZE) const;
+	void Invalidate(const MemoryAllocation& _allocation, VkDeviceSize _offset = 0, VkDeviceSize _size = VK_WHOLE_SIZE) const;
+
+	[[nodiscard]] const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const;
+	[[nodiscard]] VkDeviceSize GetNonCoherentAtomSize() const;
+
+	//Get the heap's block and allocation counters, along with the largest block, largest free region, and fragmentation of each memory type
+	//paddingBytes is left at 0 - the heap doesn't know how much of each allocation its owner actually uses
+	[[nodiscard]] MemoryStatistics GetStatistics() const;
+
+
+private:
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory; //VK_NULL_HANDLE if this slot is unused
+		std::unique_ptr<TLSFAllocator> allocator; //nullptr for dedicated blocks, which hold exactly one allocation covering the whole block
+		VkDeviceSize size;
+		bool dedicated;
+		void* mapped; //nullptr if the memory type isn't HOST_VISIBLE
+	};
+
+	//Pad _requirements out to whole atoms for non-coherent memory types so that flushing or invalidating one allocation can never touch its neighbours
+	[[nodiscard]] VkMemoryRequirements GetPaddedRequirements(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex) const;
+
+	//Returns false (rather than throwing) if the memory type's heap is out of memory
+	[[nodiscard]] bool TryAllocate(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, bool _dedicated, MemoryAllocation& _out_allocation);
+
+	//Get the atom-aligned range of a block covering [_offset, _offset + _size) of _allocation
+	[[nodiscard]] VkMappedMemoryRange GetMappedRange(const MemoryAllocation& _allocation, VkDeviceSize _offset, VkDeviceSize _size) const;
+	[[nodiscard]] bool IsNonCoherent(std::uint32_t _memoryTypeIndex) const;
+
+	//Returns UINT32_MAX if the memory type's heap is out of memory
+	[[nodiscard]] std::uint32_t CreateBlock(std::uint32_t _memoryTypeIndex, VkDeviceSize _size, bool _dedicated);
+	void FreeBlock(std::uint32_t _memoryTypeIndex, std::uint32_t _blockIndex);
+	[[nodiscard]] VkDeviceSize GetBlockSize(std::uint32_t _memoryTypeIndex) const;
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	VKDebugAllocator& deviceDebugAllocator;
+	const VulkanDevice& device;
+
+	VK_LOGGER_LAYER layer; //The layer of the owning factory
+	VkDeviceSize preferredBlockSize;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize nonCoherentAtomSize;
+	std::vector<MemoryBlock> blocks[VK_MAX_MEMORY_TYPES]; //Indexed by memory type index, block slots are stable (blockIndex remains valid for the lifetime of an allocation)
+	MemoryStatistics statistics; //Live and peak counters - the rest is filled in by GetStatistics()
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
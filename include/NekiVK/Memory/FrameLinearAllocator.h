@@ -0,0 +1,72 @@
+#ifndef FRAMELINEARALLOCATOR_H
+#define FRAMELINEARALLOCATOR_H
+
+#include "BufferFactory.h"
+
+
+//Responsible for the initialisation, ownership, and clean shutdown of a persistently mapped, HOST_VISIBLE VkBuffer split into one region per frame in flight
+//Transient per-frame data (per-draw uniforms, dynamic UBO offsets, streaming vertices, etc.) is bump-allocated from the current frame's region
+//A frame's region is reset when VulkanRenderManager::StartFrame has waited on that frame's fence (see VulkanRenderManager::AttachFrameAllocator)
+namespace Neki
+{
+
+
+//A slice of the current frame's region - write to mapped, then bind buffer at offset (e.g.: as a dynamic offset)
+struct FrameAllocation
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void* mapped;
+};
+
+
+class FrameLinearAllocator
+{
+public:
+	explicit FrameLinearAllocator(const VKLogger& _logger,
+	                              const VulkanDevice& _device,
+	                              BufferFactory& _bufferFactory,
+	                              std::size_t _framesInFlight,
+	                              VkDeviceSize _frameSize,
+	                              VkBufferUsageFlags _usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+	~FrameLinearAllocator();
+
+	//Allocate _size bytes from the current frame's region
+	//Leaving _alignment as 0 will align to the device's minimum uniform/storage buffer offset alignment (suitable for dynamic offsets)
+	[[nodiscard]] FrameAllocation Allocate(VkDeviceSize _size, VkDeviceSize _alignment = 0);
+
+	//Make _frameIndex the current frame and discard everything previously allocated in its region
+	//Only call once the GPU has finished with _frameIndex's previous use (VulkanRenderManager does this automatically for attached allocators)
+	void BeginFrame(std::size_t _frameIndex);
+
+	[[nodiscard]] VkBuffer GetBuffer() const;
+	[[nodiscard]] std::size_t GetFramesInFlight() const;
+	[[nodiscard]] VkDeviceSize GetFrameSize() const;
+	[[nodiscard]] VkDeviceSize GetUsedSize() const; //Bytes allocated so far in the current frame
+
+
+private:
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	BufferFactory& bufferFactory;
+
+	BufferHandle bufferHandle;
+	VkBuffer buffer; //Cached from bufferHandle
+	char* mapped;
+	std::size_t framesInFlight;
+	VkDeviceSize frameSize; //Padded to defaultAlignment so that every frame's region starts aligned
+	VkDeviceSize defaultAlignment;
+
+	std::size_t currentFrame;
+	VkDeviceSize head; //Offset of the next allocation relative to the start of the current frame's region
+};
+
+
+
+}
+
+
+
+#endif
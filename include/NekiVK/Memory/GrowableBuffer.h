@@ -0,0 +1,87 @@
+#ifndef GROWABLEBUFFER_H
+#define GROWABLEBUFFER_H
+
+#include "BufferFactory.h"
+#include "UploadBatch.h"
+
+
+//Responsible for the initialisation, ownership, and clean shutdown of a device-local VkBuffer that grows to fit whatever is appended to it (instance transforms, debug lines, streamed geometry, etc.)
+//When an append doesn't fit, a buffer of GROWTH_FACTOR times the capacity is allocated and the old contents are copied across on the GPU - appends are amortised O(1)
+//Replaced buffers are retired until the GPU is done with them: their copy has completed and every frame in flight has been recycled (see VulkanRenderManager::AttachGrowableBuffer)
+//Buffers that aren't attached to a render manager should be created with 0 frames in flight - replaced buffers are then freed as soon as their copy completes (nothing else may still be reading them by then)
+namespace Neki
+{
+
+
+class GrowableBuffer
+{
+public:
+	explicit GrowableBuffer(const VKLogger& _logger,
+	                        BufferFactory& _bufferFactory,
+	                        std::size_t _framesInFlight,
+	                        VkBufferUsageFlags _usage,
+	                        VkDeviceSize _initialCapacity = 64 * 1024);
+
+	//Any UploadBatch that growth or appends were recorded into must have completed first
+	~GrowableBuffer();
+
+	//Record an upload of _size bytes from _data to the end of the buffer into _uploadBatch, growing the buffer first if it's needed
+	//Returns the offset the data was placed at (aligned to _alignment, 0 is treated as 1) - the data is only present once _uploadBatch has completed
+	//The handle returned by GetBufferHandle() changes when the buffer grows - always fetch it after appending
+	[[nodiscard]] VkDeviceSize Append(const void* _data, VkDeviceSize _size, UploadBatch& _uploadBatch, VkDeviceSize _alignment = 1);
+
+	//Grow the buffer so that it can hold at least _capacity bytes, recording the copy of its contents into _uploadBatch
+	void Reserve(VkDeviceSize _capacity, UploadBatch& _uploadBatch);
+
+	//Discard the buffer's contents without shrinking it - the next append is placed at offset 0
+	//Only call once the GPU has finished reading the contents being discarded
+	void Clear();
+
+	//Advance retired buffers by one frame, freeing those the GPU can no longer be using
+	//Call once per frame after waiting on the frame's fence (VulkanRenderManager does this automatically for attached buffers)
+	void BeginFrame(std::size_t _frameIndex);
+
+	[[nodiscard]] BufferHandle GetBufferHandle() const;
+	[[nodiscard]] VkBuffer GetBuffer() const;
+	[[nodiscard]] VkDeviceSize GetSize() const; //Bytes appended since construction or the last Clear()
+	[[nodiscard]] VkDeviceSize GetCapacity() const;
+	[[nodiscard]] std::size_t GetFramesInFlight() const;
+
+
+private:
+	//A buffer that has been replaced by a larger one
+	struct RetiredBuffer
+	{
+		BufferHandle buffer;
+		bool copyComplete; //Set once the UploadBatch copying out of the buffer has completed
+		std::size_t framesRemaining; //Frames to recycle before any frame that could have referenced the buffer is guaranteed to have finished
+	};
+
+	static constexpr VkDeviceSize GROWTH_FACTOR{ 2 };
+
+	//Reallocate the buffer with _capacity bytes, copying the current contents across
+	void Grow(VkDeviceSize _capacity, UploadBatch& _uploadBatch);
+
+	//Make the batch's transfers visible to any commands submitted after it
+	static void RecordTransferBarrier(UploadBatch& _uploadBatch);
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	BufferFactory& bufferFactory;
+
+	BufferHandle bufferHandle; //Not cached as a VkBuffer - BufferFactory::Defragment() may move the buffer
+	VkBufferUsageFlags usage;
+	VkDeviceSize size;
+	VkDeviceSize capacity;
+	std::size_t framesInFlight;
+
+	std::vector<RetiredBuffer> retiredBuffers;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -7,6 +7,10 @@
 
 
 //Responsible for the initialisation, ownership, and clean shutdown of VkImages and accompanying VkDeviceMemorys, VkImageViews, and VkSamplers
+//Images are referred to by generational ImageHandles - use GetImage() to get the underlying VkImage
+//Texture uploads run on the device's transfer queue if it has a dedicated one - ownership passes to the graphics queue as part of the transition to SHADER_READ_ONLY_OPTIMAL
+//Textures can optionally be given a full mip chain, downsampled with linear blits on the graphics queue where the format supports them and box-filtered on the CPU otherwise
+//KTX2 and DDS textures holding BC1/BC3/BC4/BC5/BC7 data are uploaded block-for-block with every mip level stored in the file
 namespace Neki
 {
 
@@ -26,48 +30,79 @@ public:
 
 	//----IMAGES----//
 
-	//Allocate a single image populated by data from _filepath on a device local heap (passed through an intermediate staging buffer)
+	//Allocate a single image populated by data from _filepath on a device local heap (streamed through the staging ring)
 	//Optionally, pass a _formatOverride to override the format chosen by default based on the image's channels
 	//Optionally, pass a _textureType to automatically determine the appropriate format based on the provided texture type and the number of channels
+	//Images keep their own channel count where the device supports it (greyscale images are then swizzled in their views so that they sample as before)
 	//Optionally, pass an ImageData pointer to get metadata about the image
-	[[nodiscard]] VkImage AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, VkFormat _formatOverride = VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE _textureType = MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, bool _flipImage = false, ImageMetadata* _out_metadata = nullptr);
+	//Optionally, pass an UploadBatch to record the upload into - the image is only populated once the batch has completed
+	//Leaving _uploadBatch as nullptr will cause the function to block until the upload has completed
+	//Optionally, set _generateMipmaps to give the image a full mip chain (samplers need a maxLod above 0 to make use of it)
+	//Block-compressed images ignore _generateMipmaps and _flipImage, and only accept a _formatOverride with the same block size as the file's format
+	//A VK_FORMAT_R16G16B16A16_SFLOAT _formatOverride widens the texels to half floats on the CPU (decoding colour maps from sRGB to linear) - other overrides must take 8-bit texels
+	[[nodiscard]] ImageHandle AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, VkFormat _formatOverride = VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE _textureType = MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, bool _flipImage = false, ImageMetadata* _out_metadata = nullptr, UploadBatch* _uploadBatch = nullptr, bool _generateMipmaps = false);
 
 	//Allocate a single empty image on a device local heap (passed through an intermediate staging buffer)
 	//Note: initial state is UNDEFINED - needs to be transitioned
-	[[nodiscard]] VkImage AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags);
+	[[nodiscard]] ImageHandle AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags);
 
-	//Allocate a vector of _count images populated by data from _filepaths on a device local heap (passed through intermediate staging buffers)
+	//Allocate a vector of _count images populated by data from _filepaths on a device local heap (streamed through the staging ring)
 	//Optionally, pass a list of _count _formatOverrides to override the format chosen by default based on the image's channels
 	//Optionally, pass a list of _count _textureTypes to automatically determine the appropriate formats based on the provided texture types and the number of channels
 	//Optionally, pass a list of _count ImageDatas to get metadata about the images
-	[[nodiscard]] std::vector<VkImage> AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, VkFormat* _formatOverrides = nullptr, MODEL_TEXTURE_TYPE* _textureTypes = nullptr, bool* _flipImages = nullptr, ImageMetadata* _out_metadata = nullptr);
+	//Optionally, pass an UploadBatch to record the uploads into - the images are only populated once the batch has completed
+	//Leaving _uploadBatch as nullptr will cause all uploads to be submitted together and the function to block until they have completed
+	//Optionally, pass a list of _count _generateMipmaps to give the corresponding images full mip chains
+	[[nodiscard]] std::vector<ImageHandle> AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, VkFormat* _formatOverrides = nullptr, MODEL_TEXTURE_TYPE* _textureTypes = nullptr, bool* _flipImages = nullptr, ImageMetadata* _out_metadata = nullptr, UploadBatch* _uploadBatch = nullptr, bool* _generateMipmaps = nullptr);
 
 	//Allocate a vector of _count empty images on a device local heap (passed through intermediate staging buffers)
 	//Note: initial state is UNDEFINED - needs to be transitioned
-	[[nodiscard]] std::vector<VkImage> AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags, bool* _flipImages = nullptr);
+	[[nodiscard]] std::vector<ImageHandle> AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags, bool* _flipImages = nullptr);
 
-	//Allocate an image array populated by data from _filepaths on a device local heap (passed through an intermediate staging buffer)
+	//Allocate an image array populated by data from _filepaths on a device local heap (streamed through the staging ring)
 	//Optionally, pass a _formatOverride to override the format chosen by default based on the image's channels
 	//Optionally, pass a _textureType to automatically determine the appropriate format based on the provided texture type and the number of channels
 	//Optionally, pass an ImageData pointer to get metadata about the images
-	[[nodiscard]] VkImage AllocateImageArray(std::uint32_t _arrSize, const char** _filepaths, const VkImageUsageFlags _flags, VkFormat _formatOverride = VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE _textureType = MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, bool _flipImage = false, ImageMetadata* _out_metadata = nullptr);
+	//Optionally, pass an UploadBatch to record the upload into - the image array is only populated once the batch has completed
+	//Leaving _uploadBatch as nullptr will cause the function to block until the upload has completed
+	//Optionally, set _generateMipmaps to give every layer of the image array a full mip chain
+	//Block-compressed layers must all share one format and size - the array gets the smallest number of mip levels stored in any of the files
+	[[nodiscard]] ImageHandle AllocateImageArray(std::uint32_t _arrSize, const char** _filepaths, const VkImageUsageFlags _flags, VkFormat _formatOverride = VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE _textureType = MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, bool _flipImage = false, ImageMetadata* _out_metadata = nullptr, UploadBatch* _uploadBatch = nullptr, bool _generateMipmaps = false);
 
-	//Free a specific image
-	void FreeImage(VkImage& _image);
+	//Allocate an image array populated by _arrSize layers of _size pixel data in memory on a device local heap (streamed through the staging ring)
+	//Each layer must be tightly packed 8-bit data with as many channels as _format has (see AllocateImage() for _uploadBatch and _generateMipmaps)
+	//Optionally, cap the generated mip chain at _maxMipLevels levels (e.g.: so that the gutters between texture atlas entries don't filter away)
+	[[nodiscard]] ImageHandle AllocateImageArray(std::uint32_t _arrSize, const unsigned char* const* _pixels, VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, UploadBatch* _uploadBatch = nullptr, bool _generateMipmaps = false, std::uint32_t _maxMipLevels = UINT32_MAX);
+
+	//Free a specific image (_image is reset to a null handle - any other copies of it become stale)
+	void FreeImage(ImageHandle& _image);
 
 	//Free a list of _count images
-	void FreeImages(std::uint32_t _count, VkImage* _images);
+	void FreeImages(std::uint32_t _count, ImageHandle* _images);
+
+	//Returns false if _image is null or has been freed
+	[[nodiscard]] bool IsValid(ImageHandle _image) const;
+
+	//Get the VkImage _image refers to (for recording commands)
+	[[nodiscard]] VkImage GetImage(ImageHandle _image) const;
+
+	//Get the number of mip levels _image was created with (1 unless it was allocated with _generateMipmaps or from a block-compressed file with stored mip levels)
+	[[nodiscard]] std::uint32_t GetMipLevels(ImageHandle _image) const;
 
+	//Get live and peak memory usage of the factory's images per memory type (see DumpMemoryReport() to write it out as JSON)
+	//Every image has its own VkDeviceMemory, so there's no sub-allocation padding or fragmentation to report
+	[[nodiscard]] MemoryStatistics GetMemoryStatistics() const;
 
-	//Transition an image from one state to another
+
+	//Transition an image (all of its mip levels) from one state to another
 	//Optionally, pass a (already begun) command buffer to this function and the barrier command will be recorded to it but not executed
-	//Leaving _commandBuffer as nullptr will cause the function to allocate its own command buffer and automatically submit it
+	//Leaving _commandBuffer as nullptr will cause the function to submit the barrier and block until it has completed
 	void TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstLayout,
 	                     VkImageAspectFlags _aspectMask,
 	                     VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask,
 	                     VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask,
 	                     std::size_t layers,
-	                     VkImage& _image,
+	                     ImageHandle _image,
 	                     VkCommandBuffer* _commandBuffer = nullptr);
 
 	//--------//
@@ -76,11 +111,11 @@ public:
 
 	//----IMAGE VIEWS----//
 
-	//Create a single image view for _image of format _format
-	[[nodiscard]] VkImageView CreateImageView(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags, bool _arrayView = false, std::uint32_t _layerCount = 1);
+	//Create a single image view for _image of format _format (covering all of its mip levels)
+	[[nodiscard]] VkImageView CreateImageView(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags, bool _arrayView = false, std::uint32_t _layerCount = 1);
 
 	//Create a vector of _count image views for _images of formats _formats
-	[[nodiscard]] std::vector<VkImageView> CreateImageViews(std::uint32_t _count, const VkImage* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags, bool* _arrayViews = nullptr, std::uint32_t* _layerCounts = nullptr);
+	[[nodiscard]] std::vector<VkImageView> CreateImageViews(std::uint32_t _count, const ImageHandle* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags, bool* _arrayViews = nullptr, std::uint32_t* _layerCounts = nullptr);
 
 	//Free a specific image view
 	void FreeImageView(VkImageView& _imageView);
@@ -110,14 +145,64 @@ public:
 
 
 private:
-	[[nodiscard]] static VkFormat ChooseFormat(int _nrChannels, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType);
-
-	[[nodiscard]] VkImage AllocateImageImpl(const char* _filepath, VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata);
-	[[nodiscard]] VkImage AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, std::size_t _layers = 1);
-	[[nodiscard]] VkImage AllocateImageArrayImpl(std::uint32_t _arrSize, const char** _filepaths, VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata);
-	void FreeImageImpl(VkImage& _image);
-
-	[[nodiscard]] VkImageView CreateImageViewImpl(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _flags, bool _arrayView, std::uint32_t _layerCount);
+	//Everything the factory knows about an image, stored densely in a slot map
+	struct ImageRecord
+	{
+		VkImage image;
+		VkDeviceMemory memory;
+		std::uint32_t memoryTypeIndex;
+		VkDeviceSize memorySize;
+		VkExtent2D extent;
+		VkFormat format;
+		std::uint32_t layers;
+		std::uint32_t mipLevels;
+		VkImageUsageFlags usage;
+		VkComponentMapping components; //Applied to every view of the image
+	};
+
+	//Choose the format for _nrChannels 8-bit channels, falling back to 4 channels if the device can't sample the format with the image's own channel count
+	[[nodiscard]] VkFormat ChooseFormat(int _nrChannels, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType) const;
+	//Get the number of 8-bit channels pixel data for _format must have (4 for anything that isn't an 8-bit R/RG/RGB format)
+	[[nodiscard]] static int GetFormatChannels(VkFormat _format);
+	//Get the view swizzle that makes an image with _channels channels sample like an RGBA one (greyscale images replicate R)
+	[[nodiscard]] static VkComponentMapping GetChannelSwizzle(int _channels);
+	//Return _imageData's pixels, converted into _out_convertedPixels first if they don't have _channels channels
+	[[nodiscard]] static const unsigned char* ConvertChannelsForUpload(const ImageData& _imageData, int _channels, std::vector<unsigned char>& _out_convertedPixels);
+	//Choose the format for block-compressed data loaded from _filepath, logging an error and throwing if the device can't sample it
+	[[nodiscard]] VkFormat ChooseCompressedFormat(const char* _filepath, VkFormat _fileFormat, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType) const;
+
+	[[nodiscard]] ImageHandle AllocateImageImpl(const char* _filepath, VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, bool _generateMipmaps, ImageMetadata* _out_metadata, UploadBatch& _uploadBatch);
+	[[nodiscard]] ImageHandle AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, std::size_t _layers = 1, std::uint32_t _mipLevels = 1);
+	//Decode an uncompressed image (described by _info, from ImageLoader::GetInfo()) straight into staging memory and record its upload - mipmaps, if any, must be blittable
+	[[nodiscard]] ImageHandle AllocateImageDirect(const char* _filepath, const ImageMetadata& _info, VkFormat _format, VkImageUsageFlags _flags, VkFormat _formatOverride, bool _flipImage, bool _generateMipmaps, ImageMetadata* _out_metadata, UploadBatch& _uploadBatch);
+	[[nodiscard]] ImageHandle AllocateImageArrayImpl(std::uint32_t _arrSize, const char** _filepaths, VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, bool _generateMipmaps, ImageMetadata* _out_metadata, UploadBatch& _uploadBatch);
+	[[nodiscard]] ImageHandle AllocateImageArrayImpl(std::uint32_t _arrSize, const unsigned char* const* _pixels, VkExtent2D _size, VkFormat _format, VkImageUsageFlags _flags, bool _generateMipmaps, std::uint32_t _maxMipLevels, UploadBatch& _uploadBatch);
+	void FreeImageImpl(ImageHandle& _image);
+
+	//Look up _image's record, logging an error and throwing if _image is null or stale
+	[[nodiscard]] const ImageRecord& GetRecord(ImageHandle _image) const;
+
+	//Record copies of _pixels into _mipLevel of _layer of _image (which must be in the TRANSFER_DST_OPTIMAL layout) through the staging ring
+	//For block-compressed formats, _texelSize is the size of a block and _blockExtent its width/height in texels (_width and _height are still in texels)
+	//If _srcChannels is set, _pixels holds 8-bit texels with that many channels, and they're converted to _texelSize channels as they're written into the staging ring
+	void UploadToImage(ImageHandle _image, const void* _pixels, std::uint32_t _width, std::uint32_t _height, std::uint32_t _texelSize, std::uint32_t _layer, std::uint32_t _mipLevel, UploadBatch& _uploadBatch, std::uint32_t _blockExtent = 1, std::uint32_t _srcChannels = 0);
+
+	//Record uploads of the first _mipLevels stored mip levels of block-compressed _imageData into _layer of _image
+	void UploadCompressedMipLevels(ImageHandle _image, const ImageData& _imageData, std::uint32_t _layer, std::uint32_t _mipLevels, UploadBatch& _uploadBatch);
+
+	//Returns true if _format's mip chains can be generated with linear vkCmdBlitImage
+	[[nodiscard]] bool CanBlitMipmaps(VkFormat _format) const;
+
+	//Box-filter mip levels 1 onwards from _pixels (mip level 0 of _layer) on the CPU and record their uploads
+	void UploadMipmaps(ImageHandle _image, const unsigned char* _pixels, std::uint32_t _width, std::uint32_t _height, std::uint32_t _channels, std::uint32_t _layer, UploadBatch& _uploadBatch);
+
+	//Hand a freshly uploaded image over to the graphics queue in the SHADER_READ_ONLY_OPTIMAL layout, first generating its mip chain with blits if _blitMipmaps is true
+	void FinishUpload(ImageHandle _image, bool _blitMipmaps, UploadBatch& _uploadBatch);
+
+	//Record blits filling mip levels 1 onwards from mip level 0 into _uploadBatch's graphics command buffer (all levels must be in TRANSFER_DST_OPTIMAL, and are left in SHADER_READ_ONLY_OPTIMAL)
+	void RecordMipmapBlits(ImageHandle _image, UploadBatch& _uploadBatch);
+
+	[[nodiscard]] VkImageView CreateImageViewImpl(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _flags, bool _arrayView, std::uint32_t _layerCount);
 	void FreeImageViewImpl(VkImageView& _imageView);
 
 	[[nodiscard]] VkSampler CreateSamplerImpl(const VkSamplerCreateInfo& _createInfo);
@@ -130,9 +215,10 @@ private:
 	BufferFactory& bufferFactory;
 	VulkanCommandPool& commandPool;
 
-	std::unordered_map<VkImage, VkDeviceMemory> imageMemoryMap;
-	std::unordered_map<VkImageView, VkImage> imageViewImageMap;
+	slot_map<ImageRecord, ImageHandleTag> images;
+	std::unordered_map<VkImageView, ImageHandle> imageViewImageMap;
 	std::vector<VkSampler> samplers;
+	MemoryStatistics memoryStatistics; //Live and peak counters - largest block is filled in by GetMemoryStatistics()
 };
 
 
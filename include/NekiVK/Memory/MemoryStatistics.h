@@ -0,0 +1,64 @@
+#ifndef MEMORYSTATISTICS_H
+#define MEMORYSTATISTICS_H
+
+#include "../Core/VulkanDevice.h"
+
+#include <cstdint>
+
+
+//Device memory usage counters kept by the factories (see BufferFactory::GetMemoryStatistics() and ImageFactory::GetMemoryStatistics())
+//DumpMemoryReport() writes every factory's statistics out as JSON for tracking memory usage between builds
+namespace Neki
+{
+
+
+class BufferFactory;
+class ImageFactory;
+
+
+//Memory usage of a single memory type (or of every memory type, for MemoryStatistics::total)
+struct MemoryTypeStatistics
+{
+	std::uint32_t blockCount; //Live VkDeviceMemory objects
+	VkDeviceSize blockBytes; //Bytes held in those VkDeviceMemory objects
+	std::uint32_t allocationCount; //Live regions of those blocks in use
+	VkDeviceSize allocationBytes; //Bytes of blocks in use (including padding)
+	VkDeviceSize paddingBytes; //Bytes of allocationBytes that resources don't occupy (alignment between packed buffers, non-coherent atom rounding, and driver size rounding)
+	VkDeviceSize largestBlock;
+	VkDeviceSize largestFreeRegion; //Largest contiguous free region of any shared block
+	float fragmentation; //0 when the free space of each shared block is one contiguous region, approaching 1 as it's split into many small regions
+
+	//Highest values reached since the factory was created
+	std::uint32_t peakBlockCount;
+	VkDeviceSize peakBlockBytes;
+	std::uint32_t peakAllocationCount;
+	VkDeviceSize peakAllocationBytes;
+};
+
+
+struct MemoryStatistics
+{
+	std::uint32_t memoryTypeCount;
+	MemoryTypeStatistics memoryTypes[VK_MAX_MEMORY_TYPES];
+	MemoryTypeStatistics total; //Peaks are tracked across all memory types together - they aren't the sum of each memory type's peaks
+};
+
+
+//Update the live counters of _statistics (and its total) when a block / an allocation of _size bytes is created or released, raising peaks as needed
+void RecordBlockAllocation(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size);
+void RecordBlockFree(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size);
+void RecordAllocation(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size);
+void RecordFree(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size);
+
+//Write a JSON report of the device's memory heaps and types, along with the statistics of each factory, to _filepath
+//Either factory may be nullptr to leave it out of the report
+//Logs an error and throws if _filepath can't be written to
+void DumpMemoryReport(const VKLogger& _logger, const char* _filepath, const VulkanDevice& _device, const BufferFactory* _bufferFactory, const ImageFactory* _imageFactory);
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef MEMORYTYPESELECTOR_H
+#define MEMORYTYPESELECTOR_H
+
+#include "../Core/VulkanDevice.h"
+
+
+//Responsible for choosing which memory type an allocation is made from, and for tracking each memory heap's usage against its budget
+//Built once per VulkanDevice (see VulkanDevice::GetMemoryTypeSelector()) so that heap usage is shared between all factories
+//Budgets come from VK_EXT_memory_budget when it's enabled, otherwise they're estimated as 80% of each heap's size
+namespace Neki
+{
+
+
+class MemoryTypeSelector
+{
+public:
+	explicit MemoryTypeSelector(const VKLogger& _logger,
+	                            const VulkanDevice& _device);
+
+	~MemoryTypeSelector() = default;
+
+	//Choose the best memory type in _memoryTypeBits that has all of _requiredFlags, returning UINT32_MAX if there isn't one
+	//Types are ranked by how many of _preferredFlags they have, then by how few flags they have that are neither required nor preferred (e.g.: HOST_VISIBLE for a GPU-only resource)
+	//Types whose heap doesn't have _size bytes of budget left are only chosen if every other candidate is in the same situation
+	[[nodiscard]] std::uint32_t SelectMemoryType(std::uint32_t _memoryTypeBits, VkMemoryPropertyFlags _requiredFlags, VkMemoryPropertyFlags _preferredFlags = 0, VkDeviceSize _size = 0);
+
+	//Record that _size bytes of VkDeviceMemory have been allocated from / freed back to _memoryTypeIndex
+	//Must be called for every vkAllocateMemory / vkFreeMemory so that usage between budget queries stays accurate
+	void NotifyAllocation(std::uint32_t _memoryTypeIndex, VkDeviceSize _size);
+	void NotifyFree(std::uint32_t _memoryTypeIndex, VkDeviceSize _size);
+
+	//Re-query heap budgets from the driver (no-op without VK_EXT_memory_budget)
+	//Called automatically every few allocations - only call manually if something outside of NekiVK allocates a significant amount of memory
+	void UpdateBudgets();
+
+	[[nodiscard]] VkDeviceSize GetHeapBudget(std::uint32_t _heapIndex) const;
+	[[nodiscard]] VkDeviceSize GetHeapUsage(std::uint32_t _heapIndex) const; //Driver-reported usage at the last budget query plus everything NekiVK has allocated since
+	[[nodiscard]] const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const;
+	[[nodiscard]] bool IsMemoryBudgetEnabled() const;
+
+
+private:
+	struct HeapBudget
+	{
+		VkDeviceSize budget;
+		VkDeviceSize usage; //As of the last budget query
+		VkDeviceSize allocated; //Allocated through NekiVK in total
+		VkDeviceSize allocatedAtLastQuery;
+	};
+
+	//Number of allocations between budget queries - querying on every allocation would be needlessly slow
+	static constexpr std::uint32_t BUDGET_QUERY_INTERVAL{ 30 };
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	const VulkanDevice& device;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	HeapBudget heapBudgets[VK_MAX_MEMORY_HEAPS];
+	PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2; //nullptr if VK_EXT_memory_budget isn't enabled
+	std::uint32_t allocationsSinceQuery;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "../Utils/Loaders/ModelLoader.h"
 #include "NekiVK/Core/VulkanDescriptorPool.h"
 
+#include <array>
+
 
 //Helper class to load models into a vector of GPUMesh objects
 namespace Neki
@@ -16,17 +18,47 @@ namespace Neki
 class ImageFactory;
 
 
+//How shaders get at a model's vertex data
+enum class MODEL_VERTEX_INPUT
+{
+	VERTEX_BUFFER, //Bind GPUMesh::vertexBuffer and read ModelVertex through fixed-function vertex input
+	DEVICE_ADDRESS, //Read ModelVertex from GPUMesh::vertexAddress (e.g.: passed in a push constant) - one pipeline can draw any mesh with no vertex buffer rebinds
+};
+
+//How a material's textures are laid out in its descriptor set (use ModelFactory::GetMaterialBinding() rather than hard-coding bindings)
+enum class MODEL_MATERIAL_LAYOUT
+{
+	SEPARATE, //One binding per MODEL_TEXTURE_TYPE (binding = the type's value)
+	PACKED_ORM, //Diffuse (0), normal (1), specular (2), occlusion/roughness/metallic packed into R/G/B of one texture (3), emissive (4) - sampled with the ROUGHNESS sampler
+};
+
+
+//Where a material's texture of one type sits within the image array bound for it
+//Textures packed into a texture atlas (see ModelFactory's _atlasMaxTextureSize) occupy a sub-rectangle of one layer - sample them with:
+//texture(sampler, vec3(texCoord * uvScale + uvOffset, layer))
+//Textures that weren't atlased have the identity transform and layer 0, so shaders can apply it unconditionally
+struct TextureAtlasRegion
+{
+	glm::vec2 uvScale{ 1.0f, 1.0f };
+	glm::vec2 uvOffset{ 0.0f, 0.0f };
+	std::uint32_t layer{ 0 };
+};
+
+
 struct GPUMaterial
 {
-	//Contains all image views for a material
+	//Contains all image views for a material (materials whose textures resolve to the same image views - e.g.: atlased ones - share one descriptor set)
 	VkDescriptorSet descriptorSet;
+	std::array<TextureAtlasRegion, static_cast<std::size_t>(MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES)> atlasRegions; //Indexed by MODEL_TEXTURE_TYPE - pass these to shaders when atlasing is enabled (Tests/Shaders/model.frag reads them from a storage buffer)
 };
 
 
 struct GPUMesh
 {
-	VkBuffer vertexBuffer;
-	VkBuffer indexBuffer;
+	BufferHandle vertexBuffer; //Use BufferFactory::GetBuffer() to get the VkBuffer to bind
+	BufferHandle indexBuffer;
+	VkDeviceAddress vertexAddress; //0 unless the factory uses MODEL_VERTEX_INPUT::DEVICE_ADDRESS
+	VkDeviceAddress indexAddress; //0 unless the factory uses MODEL_VERTEX_INPUT::DEVICE_ADDRESS
 	std::uint32_t indexCount;
 	std::size_t materialIndex; //Index into parent GPUModel's materials vector
 };
@@ -46,7 +78,11 @@ public:
 	                      const VulkanDevice& _device,
 	                      BufferFactory& _bufferFactory,
 	                      ImageFactory& _imageFactory,
-	                      VulkanDescriptorPool& _descriptorPool);
+	                      VulkanDescriptorPool& _descriptorPool,
+	                      MODEL_VERTEX_INPUT _vertexInput = MODEL_VERTEX_INPUT::VERTEX_BUFFER,
+	                      bool _generateMipmaps = false, //Give every model texture a full mip chain (see ImageFactory::AllocateImageArray())
+	                      MODEL_MATERIAL_LAYOUT _materialLayout = MODEL_MATERIAL_LAYOUT::SEPARATE,
+	                      std::uint32_t _atlasMaxTextureSize = 0); //Pack textures no larger than this (in both dimensions) into shared atlas pages - 0 disables atlasing (see TextureAtlasRegion)
 
 	~ModelFactory();
 
@@ -54,20 +90,60 @@ public:
 	//Load data for a single model at _filepath into a vector of GPUMeshes comprising the model
 	//Samplers for all texture types must be set in _samplers
 	//Optionally pass in additional flags for the vertex and index buffers (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT and VK_BUFFER_USAGE_INDEX_BUFFER_BIT are added automatically)
-	[[nodiscard]] GPUModel LoadModel(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags = 0, const VkBufferUsageFlags _indexBufferFlags = 0, bool _flipImage = false);
+	//In MODEL_VERTEX_INPUT::DEVICE_ADDRESS mode, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT is added to both instead of VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+	//Optionally pass in an UploadBatch to record all of the model's uploads into - the model's buffers and images are only populated once the batch has completed
+	//Leaving _uploadBatch as nullptr will cause all of the model's uploads to be submitted together and the function to block until they have completed
+	[[nodiscard]] GPUModel LoadModel(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags = 0, const VkBufferUsageFlags _indexBufferFlags = 0, bool _flipImage = false, UploadBatch* _uploadBatch = nullptr);
 
 	//Load model data for _count models at _filepaths into a vector of vectors of GPUMeshes comprising the corresponding model
 	//E.g.: LoadModel(...)[1][2] is mesh index 2 of model index 1
 	//Samplers for all texture types for all models must be set in _samplers
 	//Optionally pass in additional flags for the vertex and index buffers (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT and VK_BUFFER_USAGE_INDEX_BUFFER_BIT are added automatically)
-	[[nodiscard]] std::vector<GPUModel> LoadModels(std::uint32_t _count, const char** _filepaths, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>* _samplers, const VkBufferUsageFlags* _vertexBufferFlags = nullptr, const VkBufferUsageFlags* _indexBufferFlags = nullptr, bool* _flipImages = nullptr);
+	//Optionally pass in an UploadBatch to record all of the models' uploads into - the models' buffers and images are only populated once the batch has completed
+	//Leaving _uploadBatch as nullptr will cause all of the models' uploads to be submitted together and the function to block until they have completed
+	[[nodiscard]] std::vector<GPUModel> LoadModels(std::uint32_t _count, const char** _filepaths, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>* _samplers, const VkBufferUsageFlags* _vertexBufferFlags = nullptr, const VkBufferUsageFlags* _indexBufferFlags = nullptr, bool* _flipImages = nullptr, UploadBatch* _uploadBatch = nullptr);
 
 
 	[[nodiscard]] VkDescriptorSetLayout GetMaterialDescriptorSetLayout();
 
+	//Get the binding _textureType is sampled from in the material descriptor set (METALLIC, ROUGHNESS, and AMBIENT_OCCLUSION share one in MODEL_MATERIAL_LAYOUT::PACKED_ORM)
+	[[nodiscard]] std::uint32_t GetMaterialBinding(MODEL_TEXTURE_TYPE _textureType) const;
+	[[nodiscard]] MODEL_MATERIAL_LAYOUT GetMaterialLayout() const;
+
+	//In MODEL_VERTEX_INPUT::DEVICE_ADDRESS mode, vertices are tightly packed ModelVertex structs (56 bytes each) - declare them in GLSL with scalar layout (GL_EXT_scalar_block_layout), e.g.:
+	//layout(buffer_reference, scalar) readonly buffer Vertices { ModelVertex v[]; };
+	//This needs the scalarBlockLayout feature (see VulkanDevice::IsScalarBlockLayoutEnabled()) - Tests/Shaders/model_pulling.vert is a complete example
+	[[nodiscard]] MODEL_VERTEX_INPUT GetVertexInput() const;
+
 
 private:
-	[[nodiscard]] GPUModel LoadModelImpl(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags, const VkBufferUsageFlags _indexBufferFlags, bool _flipImage);
+	[[nodiscard]] GPUModel LoadModelImpl(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags, const VkBufferUsageFlags _indexBufferFlags, bool _flipImage, UploadBatch& _uploadBatch);
+
+	//Create a view of _material's occlusion/roughness/metallic textures packed into one RGBA image array (one layer per texture of each type)
+	//Materials whose sources match one already in _packedViews share its view, and sources that are already packed (e.g.: glTF's occlusionRoughnessMetallic) are uploaded as-is
+	[[nodiscard]] VkImageView CreatePackedOrmView(const Material& _material, bool _flipImage, UploadBatch& _uploadBatch, std::unordered_map<std::string, VkImageView>& _packedViews);
+
+	[[nodiscard]] static bool IsPackedOrmType(MODEL_TEXTURE_TYPE _textureType);
+
+	//A model's atlased textures of one type - every atlas page is a layer of one image array
+	struct TextureAtlas
+	{
+		VkImageView view;
+		std::unordered_map<std::size_t, TextureAtlasRegion> regions; //Keyed by material index
+	};
+
+	//Bin-pack the small textures of _model's materials into atlases, one per texture type (types with fewer than two distinct atlasable textures get no atlas)
+	//A material's texture of a type is atlasable if it's the material's only texture of that type (or the fallback, if it has none), isn't block-compressed, fits in atlasMaxTextureSize, and every mesh using the material keeps its UVs within [0, 1]
+	[[nodiscard]] std::unordered_map<MODEL_TEXTURE_TYPE, TextureAtlas> BuildTextureAtlases(const Model& _model, const char* _fallbackTexturePath, bool _flipImage, UploadBatch& _uploadBatch);
+
+	//Atlas entries are surrounded by a gutter of their edge texels and placed on gutter-aligned positions, so that filtering never reaches a neighbour
+	//Atlas mip chains are capped at bit_width(ATLAS_GUTTER) levels, the most that keep at least one gutter texel
+	static constexpr std::uint32_t ATLAS_PAGE_SIZE{ 2048 };
+	static constexpr std::uint32_t ATLAS_GUTTER{ 8 };
+	static constexpr std::uint32_t ATLAS_MAX_MIP_LEVELS{ 4 };
+
+	static constexpr std::uint32_t PACKED_ORM_BINDING{ 3 };
+	static constexpr std::uint32_t PACKED_ORM_BINDING_COUNT{ 5 };
 
 	//Dependency injections from VKApp
 	const VKLogger& logger;
@@ -78,6 +154,10 @@ private:
 	VulkanDescriptorPool& descriptorPool;
 
 	VkDescriptorSetLayout materialDescriptorSetLayout{};
+	MODEL_VERTEX_INPUT vertexInput;
+	bool generateMipmaps;
+	MODEL_MATERIAL_LAYOUT materialLayout;
+	std::uint32_t atlasMaxTextureSize;
 };
 
 
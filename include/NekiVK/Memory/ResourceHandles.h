@@ -0,0 +1,26 @@
+#ifndef RESOURCEHANDLES_H
+#define RESOURCEHANDLES_H
+
+#include "../Utils/Templates/slot_map.h"
+
+
+//Generational handles to resources owned by the factories
+//Handles stay valid until the resource is freed, after which they're detected as stale rather than aliasing whatever reuses their slot
+//Get the underlying Vulkan object with BufferFactory::GetBuffer() / ImageFactory::GetImage() when recording commands or writing descriptors
+namespace Neki
+{
+
+
+struct BufferHandleTag;
+struct ImageHandleTag;
+
+using BufferHandle = slot_map_handle<BufferHandleTag>;
+using ImageHandle = slot_map_handle<ImageHandleTag>;
+
+
+
+}
+
+
+
+#endif
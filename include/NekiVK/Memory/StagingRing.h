@@ -0,0 +1,82 @@
+#ifndef STAGINGRING_H
+#define STAGINGRING_H
+
+#include "../Debug/VKLogger.h"
+#include "UploadBatch.h"
+
+#include <deque>
+
+
+//Responsible for the initialisation, ownership, and clean shutdown of a single large, persistently mapped, HOST_VISIBLE staging VkBuffer that uploads sub-allocate from in a ring
+//Regions are retired when the UploadBatch they were allocated for completes - when the ring is full, the oldest in-flight batch is waited on to make room
+//Instances should be accessed through BufferFactory::GetStagingRing()
+namespace Neki
+{
+
+
+class BufferFactory;
+
+
+//A region of the staging ring - write to mapped, then record a copy from buffer at offset
+struct StagingAllocation
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void* mapped;
+};
+
+
+class StagingRing
+{
+public:
+	explicit StagingRing(const VKLogger& _logger,
+	                     BufferFactory& _bufferFactory,
+	                     VkDeviceSize _size = 64 * 1024 * 1024);
+
+	~StagingRing();
+
+	//Allocate _size bytes (aligned to _alignment) from the ring, to be released once _uploadBatch completes
+	//_size must not exceed GetMaxAllocationSize() - larger uploads should be streamed in chunks
+	//If the ring is full, this will block on the oldest in-flight batch (which may be _uploadBatch itself) until there's room
+	[[nodiscard]] StagingAllocation Allocate(VkDeviceSize _size, VkDeviceSize _alignment, UploadBatch& _uploadBatch);
+
+	//The largest single allocation the ring will hand out - kept below the ring's size so that chunked uploads can overlap
+	[[nodiscard]] VkDeviceSize GetMaxAllocationSize() const;
+	[[nodiscard]] VkDeviceSize GetSize() const;
+
+
+private:
+	struct StagingRegion
+	{
+		VkDeviceSize begin;
+		VkDeviceSize end;
+		UploadBatch* uploadBatch;
+		bool retired;
+	};
+
+	//Attempt to find room for _size bytes, returning UINT64_MAX if there isn't any
+	[[nodiscard]] VkDeviceSize FindSpace(VkDeviceSize _size, VkDeviceSize _alignment) const;
+	void Retire(std::uint64_t _regionID);
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	BufferFactory& bufferFactory;
+
+	BufferHandle bufferHandle;
+	VkBuffer buffer; //Cached from bufferHandle
+	VkDeviceSize size;
+	char* mapped;
+
+	VkDeviceSize head; //Offset of the next allocation
+	std::deque<StagingRegion> regions; //In-flight regions, oldest first
+	std::uint64_t frontRegionID; //ID of regions.front() - region IDs increase monotonically
+};
+
+
+
+}
+
+
+
+#endif
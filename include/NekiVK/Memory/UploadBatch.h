@@ -0,0 +1,142 @@
+#ifndef UPLOADBATCH_H
+#define UPLOADBATCH_H
+
+#include "../Core/VulkanCommandPool.h"
+#include "../Core/VulkanDevice.h"
+#include "ResourceHandles.h"
+
+#include <functional>
+
+
+//Responsible for recording any number of upload commands into a single VkCommandBuffer, submitting it once with a VkFence, and cleaning up the upload's resources once that fence signals
+//On devices with a dedicated transfer queue family the upload commands run on the transfer queue, with a second command buffer on the graphics queue that waits on them (through a VkSemaphore) before taking ownership of what they wrote
+//Resources are moved between the two queue families with AcquireBuffer() / ReleaseBuffer() / ReleaseImage() - on single-queue devices everything is recorded into one command buffer and these are (almost) no-ops
+//Instances should be created through BufferFactory::CreateUploadBatch()
+//A batch can be reused after it completes - the next call to GetCommandBuffer() will start a new recording
+namespace Neki
+{
+
+
+class BufferFactory;
+
+
+class UploadBatch
+{
+public:
+	explicit UploadBatch(const VKLogger& _logger,
+	                     VKDebugAllocator& _deviceDebugAllocator,
+	                     const VulkanDevice& _device,
+	                     VulkanCommandPool& _commandPool,
+	                     VulkanCommandPool* _transferCommandPool, //nullptr if the device has no dedicated transfer queue
+	                     BufferFactory& _bufferFactory);
+
+	//Submits any unsubmitted commands and waits for them to complete
+	~UploadBatch();
+
+	//Get the batch's (already begun) command buffer to record upload commands to
+	//If the batch has been submitted but not yet completed, this will wait for it to complete first
+	//This runs on the transfer queue if the device has a dedicated one - only record transfer commands and barriers into it
+	[[nodiscard]] VkCommandBuffer GetCommandBuffer();
+
+	//Get the batch's (already begun) command buffer for the graphics queue - anything recorded here runs after all of the batch's transfer commands and ownership acquires
+	//Used for commands the transfer queue can't run (blits, transitions to shader-read layouts, etc.) - this is the same command buffer as GetCommandBuffer() without a dedicated transfer queue
+	[[nodiscard]] VkCommandBuffer GetGraphicsCommandBuffer();
+
+	//Record a copy of _size bytes from _srcBuffer to _dstBuffer
+	void CopyBuffer(VkBuffer _srcBuffer, VkBuffer _dstBuffer, VkDeviceSize _size, VkDeviceSize _srcOffset = 0, VkDeviceSize _dstOffset = 0);
+
+	//Record a copy of _regionCount regions from _srcBuffer to _dstImage (which must be in the TRANSFER_DST_OPTIMAL layout)
+	void CopyBufferToImage(VkBuffer _srcBuffer, VkImage _dstImage, std::uint32_t _regionCount, const VkBufferImageCopy* _regions);
+
+	//Move _buffer from the graphics queue family to the transfer family before the batch's transfer commands run, so that its existing contents can be read and are preserved
+	//Only needed for buffers that may have been used on the graphics queue already, and only for VK_SHARING_MODE_EXCLUSIVE buffers
+	void AcquireBuffer(VkBuffer _buffer);
+
+	//Move _buffer back to the graphics queue family once the batch's transfer commands have run - required before the graphics queue can use a buffer the batch has written to
+	//Only for VK_SHARING_MODE_EXCLUSIVE buffers
+	void ReleaseBuffer(VkBuffer _buffer);
+
+	//Move _image (written by the batch's transfer commands in the TRANSFER_DST_OPTIMAL layout) to the graphics queue family, transitioning _range to _newLayout for access by _dstStageMask / _dstAccessMask
+	//Recorded straight away as an ordinary barrier without a dedicated transfer queue
+	void ReleaseImage(VkImage _image, const VkImageSubresourceRange& _range, VkImageLayout _newLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask);
+
+	//Free a BufferFactory-owned buffer (e.g.: a staging buffer) once the batch has completed
+	void DeferFree(BufferHandle _buffer);
+
+	//Run _callback once the batch has completed
+	void AddCompletionCallback(std::function<void()> _callback);
+
+	//Get a binary semaphore that the batch's next submission will signal once all of its work (on every queue) has completed - e.g.: to pass to VulkanRenderManager::WaitOnSemaphore()
+	//Lets the render queue wait on the upload on the GPU instead of the CPU blocking in Wait() - the semaphore must be waited on exactly once per submission that signals it
+	//Starts a new recording if the batch isn't recording already, so that there's always a submission to signal it
+	[[nodiscard]] VkSemaphore GetCompletionSemaphore();
+
+	//End the command buffers and submit them - does not block
+	//With a dedicated transfer queue this is up to three submissions: graphics-side releases for AcquireBuffer(), the transfer commands, and the graphics command buffer (which waits on the transfer commands)
+	//Anything submitted to the graphics queue afterwards is ordered after the batch's acquires - work on other queues (or that has to wait for the upload to finish, not just start) should wait on GetCompletionSemaphore()
+	void Submit();
+
+	//Poll the batch's fence without blocking - returns true once all submitted work has completed (and deferred cleanup has been run)
+	[[nodiscard]] bool IsComplete();
+
+	//Block until the batch has completed, submitting it first if it hasn't been already
+	//The batch is ready for reuse once this returns
+	void Wait();
+
+
+private:
+	enum class UPLOAD_BATCH_STATE
+	{
+		IDLE,
+		RECORDING,
+		SUBMITTED,
+	};
+
+	//Free deferred buffers, run completion callbacks, and return to the IDLE state
+	void Complete();
+
+	//Record the transfer-side release barriers for everything passed to ReleaseBuffer() / ReleaseImage() into the transfer command buffer
+	void RecordReleases();
+
+	//Submit _commandBuffer to _queue, optionally waiting on / signalling a semaphore and signalling a fence
+	[[nodiscard]] VkResult SubmitCommandBuffer(VkQueue _queue, VkCommandBuffer _commandBuffer, VkSemaphore _waitSemaphore, VkSemaphore _signalSemaphore, VkFence _fence) const;
+
+	//Create one of the semaphores chaining the batch's submissions together
+	[[nodiscard]] VkSemaphore CreateBatchSemaphore(const char* _name);
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	VKDebugAllocator& deviceDebugAllocator;
+	const VulkanDevice& device;
+	VulkanCommandPool& commandPool;
+	VulkanCommandPool* transferCommandPool;
+	BufferFactory& bufferFactory;
+
+	VkCommandBuffer commandBuffer; //Allocated from the transfer pool if there is one
+	VkFence fence;
+	UPLOAD_BATCH_STATE state;
+
+	//Only used with a dedicated transfer queue
+	VkCommandBuffer graphicsCommandBuffer; //Submitted after commandBuffer, waiting on transferSemaphore
+	VkCommandBuffer releaseCommandBuffer; //Submitted before commandBuffer, signalling releaseSemaphore - only when something has been passed to AcquireBuffer()
+	VkSemaphore releaseSemaphore;
+	VkSemaphore transferSemaphore;
+	bool releaseRecorded;
+	std::vector<VkBuffer> acquiredBuffers;
+	std::vector<VkBuffer> releasedBuffers;
+	std::vector<VkImageMemoryBarrier> imageReleases;
+
+	VkSemaphore completionSemaphore; //Created on the first call to GetCompletionSemaphore()
+	bool signalCompletion; //Whether the next submission signals completionSemaphore
+
+	std::vector<BufferHandle> deferredFrees;
+	std::vector<std::function<void()>> completionCallbacks;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -18,13 +18,27 @@
 #include "Debug/VKLoggerConfig.h"
 
 #include "Memory/BufferFactory.h"
+#include "Memory/DeviceMemoryHeap.h"
+#include "Memory/FrameLinearAllocator.h"
+#include "Memory/GrowableBuffer.h"
 #include "Memory/ImageFactory.h"
+#include "Memory/MemoryStatistics.h"
+#include "Memory/MemoryTypeSelector.h"
 #include "Memory/ModelFactory.h"
-
+#include "Memory/ResourceHandles.h"
+#include "Memory/StagingRing.h"
+#include "Memory/UploadBatch.h"
+
+#include "Utils/Allocators/HostArena.h"
+#include "Utils/Allocators/SkylinePacker.h"
+#include "Utils/Allocators/TLSFAllocator.h"
+#include "Utils/Files/FileView.h"
 #include "Utils/Loaders/ImageLoader.h"
 #include "Utils/Loaders/ModelLoader.h"
+#include "Utils/Pixels/PixelKernels.h"
 #include "Utils/Strings/format.h"
 #include "Utils/Templates/enum_enable_bitmask_operators.h"
+#include "Utils/Templates/slot_map.h"
 
 
 
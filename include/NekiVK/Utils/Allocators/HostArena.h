@@ -0,0 +1,60 @@
+#ifndef HOSTARENA_H
+#define HOSTARENA_H
+
+#include <cstddef>
+#include <new>
+#include <span>
+
+
+//Fixed-capacity bump allocator over a single over-aligned block of host memory
+//The block's start and capacity are both multiples of its alignment, so the whole block qualifies for import as VkDeviceMemory with VK_EXT_external_memory_host (see BufferFactory::ImportHostBuffer())
+namespace Neki
+{
+
+
+class HostArena
+{
+public:
+	explicit HostArena(std::size_t _size, std::size_t _alignment = DEFAULT_ALIGNMENT);
+	~HostArena();
+
+	HostArena(const HostArena&) = delete;
+	HostArena& operator=(const HostArena&) = delete;
+
+	//Bump-allocate _size bytes aligned to _alignment (which must be a power of 2)
+	//Returns nullptr if the arena doesn't have room
+	[[nodiscard]] void* Allocate(std::size_t _size, std::size_t _alignment);
+
+	//Bump-allocate an uninitialised array of _count Ts, throwing std::bad_alloc if the arena doesn't have room
+	template<typename T>
+	[[nodiscard]] std::span<T> AllocateArray(std::size_t _count)
+	{
+		if (_count == 0) { return {}; }
+		void* data{ Allocate(sizeof(T) * _count, alignof(T)) };
+		if (data == nullptr) { throw std::bad_alloc(); }
+		return { static_cast<T*>(data), _count };
+	}
+
+	[[nodiscard]] void* GetData() const; //nullptr if the arena has a capacity of 0
+	[[nodiscard]] std::size_t GetUsedSize() const;
+	[[nodiscard]] std::size_t GetCapacity() const; //The requested size rounded up to a multiple of the alignment
+	[[nodiscard]] std::size_t GetAlignment() const;
+
+	//64KiB covers minImportedHostPointerAlignment on every known implementation (most only need the 4KiB page size)
+	static constexpr std::size_t DEFAULT_ALIGNMENT{ 64 * 1024 };
+
+
+private:
+	std::byte* data;
+	std::size_t usedSize;
+	std::size_t capacity;
+	std::size_t alignment;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef SKYLINEPACKER_H
+#define SKYLINEPACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+//Skyline bottom-left rectangle packer - places rectangles into a fixed-size 2D area (e.g.: a texture atlas page), each as low as it will go
+//Like TLSFAllocator, it's purely CPU-side bookkeeping - it only hands out positions, it never touches the area it describes
+//Packing is tightest when rectangles are packed tallest first
+namespace Neki
+{
+
+
+class SkylinePacker
+{
+public:
+	SkylinePacker(std::uint32_t _width, std::uint32_t _height);
+	~SkylinePacker() = default;
+
+	//Attempt to place a _width x _height rectangle
+	//Returns false (and leaves _out_x and _out_y untouched) if there's no room for it
+	[[nodiscard]] bool Pack(std::uint32_t _width, std::uint32_t _height, std::uint32_t& _out_x, std::uint32_t& _out_y);
+
+	//Remove every rectangle, returning the packer to its just-constructed state
+	void Reset();
+
+	[[nodiscard]] std::uint32_t GetWidth() const;
+	[[nodiscard]] std::uint32_t GetHeight() const;
+	//The bounding box of everything packed so far (always anchored at the origin)
+	[[nodiscard]] std::uint32_t GetUsedWidth() const;
+	[[nodiscard]] std::uint32_t GetUsedHeight() const;
+	[[nodiscard]] std::uint64_t GetUsedArea() const; //Sum of the packed rectangles' areas
+
+
+private:
+	//One horizontal segment of the skyline - the top edge of everything packed beneath [x, x + width)
+	struct SkylineSegment
+	{
+		std::uint32_t x;
+		std::uint32_t y;
+		std::uint32_t width;
+	};
+
+	//If a _width x _height rectangle fits with its left edge at segment _index, return true and the lowest y it can sit at
+	[[nodiscard]] bool Fits(std::size_t _index, std::uint32_t _width, std::uint32_t _height, std::uint32_t& _out_y) const;
+
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t usedWidth;
+	std::uint32_t usedHeight;
+	std::uint64_t usedArea;
+	std::vector<SkylineSegment> skyline; //Left to right, covering the full width
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef TLSFALLOCATOR_H
+#define TLSFALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+
+//Two-Level Segregated Fit (TLSF) offset allocator - O(1) allocation and freeing of aligned sub-ranges within a fixed-size range
+//Purely a CPU-side bookkeeping structure - it never touches the memory it describes, it only hands out offsets into it
+namespace Neki
+{
+
+
+//Result of a successful TLSFAllocator::Allocate call
+struct TLSFAllocation
+{
+	std::uint64_t offset; //Aligned offset into the managed range
+	std::uint32_t node; //Opaque handle to be passed back to TLSFAllocator::Free
+};
+
+
+class TLSFAllocator
+{
+public:
+	explicit TLSFAllocator(std::uint64_t _size);
+	~TLSFAllocator() = default;
+
+	//Attempt to allocate _size bytes aligned to _alignment (which must be a power of 2)
+	//Returns false (and leaves _out_allocation untouched) if no free region is large enough
+	[[nodiscard]] bool Allocate(std::uint64_t _size, std::uint64_t _alignment, TLSFAllocation& _out_allocation);
+
+	//Free a previously allocated node, coalescing it with any free physical neighbours
+	void Free(std::uint32_t _node);
+
+	//Free everything, returning the allocator to its just-constructed state
+	void Reset();
+
+	[[nodiscard]] std::uint64_t GetSize() const;
+	[[nodiscard]] std::uint64_t GetUsedSize() const;
+	[[nodiscard]] std::uint64_t GetLargestFreeRegion() const;
+	[[nodiscard]] std::uint32_t GetAllocationCount() const;
+	[[nodiscard]] bool IsEmpty() const;
+
+	static constexpr std::uint32_t INVALID_NODE{ UINT32_MAX };
+
+
+private:
+	//Each first-level list covers a power-of-2 size class, which is linearly subdivided into SL_COUNT second-level lists
+	static constexpr std::uint32_t SL_LOG2{ 5 };
+	static constexpr std::uint32_t SL_COUNT{ 1u << SL_LOG2 };
+	static constexpr std::uint32_t FL_COUNT{ 64 - SL_LOG2 + 1 };
+
+	struct Node
+	{
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::uint32_t prevPhysical; //Neighbouring nodes in address order (used for coalescing)
+		std::uint32_t nextPhysical;
+		std::uint32_t prevFree; //Neighbouring nodes in the same free list
+		std::uint32_t nextFree;
+		bool free;
+	};
+
+	//Map a size to the free list which holds blocks of (at least) that size
+	static void MappingInsert(std::uint64_t _size, std::uint32_t& _out_fl, std::uint32_t& _out_sl);
+
+	//Map a size to the first free list whose blocks are all guaranteed to be large enough
+	static void MappingSearch(std::uint64_t _size, std::uint32_t& _out_fl, std::uint32_t& _out_sl);
+
+	[[nodiscard]] std::uint32_t FindFreeNode(std::uint64_t _size) const;
+	[[nodiscard]] std::uint32_t CreateNode(std::uint64_t _offset, std::uint64_t _size);
+	void ReleaseNode(std::uint32_t _node);
+	void InsertFreeNode(std::uint32_t _node);
+	void RemoveFreeNode(std::uint32_t _node);
+
+	std::uint64_t size;
+	std::uint64_t usedSize;
+	std::uint32_t allocationCount;
+
+	std::uint64_t flBitmap; //Bit fl set if any second-level list of fl is non-empty
+	std::uint32_t slBitmaps[FL_COUNT]; //Bit sl set if freeLists[fl][sl] is non-empty
+	std::uint32_t freeLists[FL_COUNT][SL_COUNT];
+
+	std::vector<Node> nodes;
+	std::vector<std::uint32_t> unusedNodes; //Indices into nodes that can be recycled
+};
+
+
+
+}
+
+
+
+#endif
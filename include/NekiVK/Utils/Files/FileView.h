@@ -0,0 +1,71 @@
+#ifndef FILEVIEW_H
+#define FILEVIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+
+//Read-only memory-mapped view of a whole file - loaders decode and parse straight from the mapping rather than copying the file into a buffer first
+//Views are shared: opening a file that's already open elsewhere returns the existing view, so every consumer reads the same pages
+namespace Neki
+{
+
+
+enum class FILE_ACCESS_PATTERN : std::uint32_t
+{
+	SEQUENTIAL = 0, //Read front to back (decoders, shader modules) - the OS is told to read ahead aggressively and prefetch the whole file
+	RANDOM     = 1, //Read in scattered pieces (headers, containers with offset tables) - read-ahead is disabled
+};
+
+
+class FileView
+{
+public:
+	~FileView();
+
+	FileView(const FileView&) = delete;
+	FileView& operator=(const FileView&) = delete;
+
+	//Map _filepath, or return the view it's already mapped by
+	//_accessPattern is only applied when the file is first mapped
+	//Returns nullptr if the file can't be opened or mapped - callers report the error in their own way
+	[[nodiscard]] static std::shared_ptr<const FileView> Open(const std::string& _filepath, FILE_ACCESS_PATTERN _accessPattern = FILE_ACCESS_PATTERN::SEQUENTIAL);
+
+	//The mapped bytes stay valid for as long as the view is alive - empty files have no mapping, so GetData() is then nullptr
+	[[nodiscard]] const unsigned char* GetData() const;
+	[[nodiscard]] std::size_t GetSize() const;
+	[[nodiscard]] std::span<const unsigned char> GetBytes() const;
+	[[nodiscard]] const std::string& GetFilepath() const;
+
+
+private:
+	FileView(const std::string& _filepath);
+
+	//Map the file, returning false on failure
+	bool Map(FILE_ACCESS_PATTERN _accessPattern);
+
+	std::string filepath;
+	const unsigned char* data;
+	std::size_t size;
+	#if defined(_WIN32)
+		void* fileHandle;
+		void* mappingHandle;
+	#endif
+
+	//Every open view, keyed by filepath - entries expire when the last consumer releases their view
+	static std::unordered_map<std::string, std::weak_ptr<const FileView>> openViews;
+	static std::mutex openViewsMutex;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
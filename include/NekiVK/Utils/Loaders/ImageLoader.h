@@ -1,8 +1,16 @@
 #ifndef IMAGELOADER_H
 #define IMAGELOADER_H
 
+#include "../Files/FileView.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <vulkan/vulkan.h>
 
 struct ImageMetadata
@@ -11,26 +19,152 @@ struct ImageMetadata
 	int height;
 	int channels;
 	VkFormat vkFormat;
+	bool blockCompressed; //If true, pixels holds BC blocks in vkFormat rather than 8-bit texels
+};
+
+//Where one stored mip level of a block-compressed image lives within ImageData::pixels
+struct ImageMipLevel
+{
+	std::size_t offset;
+	std::size_t size;
+	int width;
+	int height;
 };
 
 struct ImageData
 {
 	unsigned char* pixels;
 	ImageMetadata metadata;
+	std::vector<ImageMipLevel> mipLevels; //Only filled for block-compressed images (level 0 first)
 };
 
+struct ImageCacheStatistics
+{
+	std::uint64_t hits;
+	std::uint64_t misses;
+	std::uint64_t evictions;
+	std::size_t cachedImages;
+	std::size_t cachedBytes; //Referenced and unreferenced images combined
+	std::size_t budget;
+};
 
-//Static utility class for loading and freeing image data using stb_image
+
+//Static utility class for loading and freeing image data
+//PNG, JPEG, etc. are decoded to 8-bit channels with stb_image, while KTX2 and DDS files holding BC1/BC3/BC4/BC5/BC7 data are loaded as-is with all of their stored mip levels
+//Loaded images are cached by (path, flip, channel count) and reference counted - every Load() must be matched by a Free() of the returned pixels
+//Images that are no longer referenced stay cached until the cache exceeds its byte budget, at which point the least recently released are evicted
+//Loading and freeing are thread-safe
 class ImageLoader
 {
 public:
-	static ImageData Load(const std::string& _filepath, bool _flipImage);
+	//Decoded images keep the channel count stored in the file (1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA) unless _desiredChannels is set
+	//_flipImage and _desiredChannels are ignored for block-compressed images - the blocks can't be altered without re-encoding them
+	static ImageData Load(const std::string& _filepath, bool _flipImage, int _desiredChannels = 0);
+
+	//Load _count images from _filepaths, decoding them in parallel across the machine's cores
+	//If any image fails to load, the first failure is rethrown once every worker has finished
+	static std::vector<ImageData> LoadMany(std::uint32_t _count, const char** _filepaths, bool _flipImage, int _desiredChannels = 0);
+
+	//Read _filepath's dimensions and channel count from its header without decoding it (block-compressed files are loaded - and cached - in full)
+	//Images already in the cache are answered from it without touching the file (_flipImage is only used to find them)
+	[[nodiscard]] static ImageMetadata GetInfo(const std::string& _filepath, bool _flipImage = false);
+
+	//Decode _filepath into _dst as _channels 8-bit channels per texel (see PixelKernels::ConvertChannels()), writing row y at _dst + y * _rowPitch
+	//_dst must hold at least (height - 1) * _rowPitch + width * _channels bytes - use GetInfo() to size it
+	//stb_image can't be given an output buffer, so decoding straight into _dst relies on stb_image's output being the first allocation of width * height * _channels bytes it makes (see DecodeMalloc())
+	//That holds for most images, which are then decoded into the start of _dst and, if _rowPitch isn't tightly packed, spread out to _rowPitch in place
+	//If stb_image happens to make an earlier allocation of that size, the image is decoded to the heap and copied across row by row instead - the result is the same, only slower
+	//Cached images are copied from the cache, but newly decoded images aren't added to it - use Load() for images that will be needed more than once
+	//Block-compressed images can't be loaded this way (they have no 8-bit texels) - use Load()
+	static ImageMetadata LoadInto(const std::string& _filepath, bool _flipImage, int _channels, unsigned char* _dst, std::size_t _rowPitch);
+
+	//Release a reference to _pixels (the image is only freed once it's been evicted from the cache)
 	static void Free(void* _pixels);
 
+	//Set the number of bytes unreferenced images may occupy before eviction starts (evicting immediately if the cache is already over it)
+	//A budget of 0 frees images as soon as their last reference is released
+	static void SetCacheBudget(std::size_t _bytes);
+	[[nodiscard]] static ImageCacheStatistics GetCacheStatistics();
+
+	//Downsample _src (_width x _height texels of _channels bytes each) to the next mip level (half size rounded down, minimum 1) with a 2x2 box filter, writing into _dst
+	//If _srgb is true, colour channels are averaged in linear space (alpha, the 4th channel, is always averaged as-is)
+	static void Downsample(const unsigned char* _src, int _width, int _height, int _channels, bool _srgb, unsigned char* _dst);
+
+	//Returns the size in bytes of one 4x4 block of _format, or 0 if _format isn't a supported block-compressed format
+	[[nodiscard]] static std::uint32_t GetBlockSize(VkFormat _format);
+
+	//stb_image's allocator (see src/External/stb_image.cpp) - while LoadInto() is decoding, the first allocation of exactly the tightly packed image's size is placed in its destination
+	//Not for use outside of stb_image
+	static void* DecodeMalloc(std::size_t _size);
+	static void* DecodeRealloc(void* _pointer, std::size_t _size);
+	static void DecodeFree(void* _pointer);
+
 
 private:
+	//Map _filepath (see Neki::FileView), throwing if it can't be opened
+	static std::shared_ptr<const Neki::FileView> OpenFile(const std::string& _filepath);
+	//Returns true if the _size bytes at _data start with the KTX2 / DDS magic bytes
+	static bool IsKTX2(const unsigned char* _data, std::size_t _size);
+	static bool IsDDS(const unsigned char* _data, std::size_t _size);
+
+	//Parse a KTX2 / DDS file mapped as _file, throwing if it isn't a single-layer 2D BC texture
+	static ImageData LoadKTX2(const std::string& _filepath, std::span<const unsigned char> _file);
+	static ImageData LoadDDS(const std::string& _filepath, std::span<const unsigned char> _file);
+
+	//Copy the mip levels at _levelOffsets (of _levelSizes bytes) within _file into a single allocation that Free() can release, and fill in the rest of the ImageData
+	static ImageData CreateCompressedImageData(const std::string& _filepath, std::span<const unsigned char> _file, VkFormat _format, std::uint32_t _width, std::uint32_t _height, const std::vector<std::size_t>& _levelOffsets, const std::vector<std::size_t>& _levelSizes);
+
+	//Returns the number of levels in a full mip chain for a _width x _height image - headers claiming more than this are rejected before anything is sized by their level count
+	[[nodiscard]] static std::uint32_t GetMaxLevelCount(std::uint32_t _width, std::uint32_t _height);
+
+	//Read a little-endian integer from _file at _offset
+	static std::uint32_t ReadU32(std::span<const unsigned char> _file, std::size_t _offset);
+	static std::uint64_t ReadU64(std::span<const unsigned char> _file, std::size_t _offset);
+
+	struct CacheKey
+	{
+		std::string filepath;
+		bool flipImage;
+		int channels; //The channel count requested from the decoder (0 for the file's own)
+		bool operator==(const CacheKey&) const = default;
+	};
+
+	struct CacheKeyHash
+	{
+		std::size_t operator()(const CacheKey& _key) const;
+	};
+
+	struct CacheEntry
+	{
+		ImageData imageData;
+		std::size_t size;
+		std::uint32_t referenceCount;
+		std::list<CacheKey>::iterator lruPosition; //Position in unreferencedEntries - only valid while referenceCount is 0
+	};
+
+	static constexpr std::size_t DEFAULT_CACHE_BUDGET{ 256 * 1024 * 1024 };
+
+	//Where LoadInto() is currently decoding to on this thread (pointer is nullptr if it isn't)
+	struct DecodeTarget
+	{
+		unsigned char* pointer;
+		std::size_t size;
+		bool inUse; //Set while stb_image holds the destination as one of its allocations
+	};
+
+	//Take a reference to a cached image (cacheMutex must be held)
+	static ImageData AcquireEntry(CacheEntry& _entry);
+
+	//Free unreferenced images, least recently released first, until the cache fits its budget (cacheMutex must be held)
+	static void EvictToBudget();
+
 	//Return from cache if image has already been loaded
-	static std::unordered_map<std::string, ImageData> imageCache;
+	static std::unordered_map<CacheKey, CacheEntry, CacheKeyHash> imageCache;
+	static std::unordered_map<const unsigned char*, CacheKey> pixelKeys; //Free() is only given the pixels
+	static std::list<CacheKey> unreferencedEntries; //Least recently released at the back
+	static ImageCacheStatistics cacheStatistics;
+	static std::mutex cacheMutex;
+	static thread_local DecodeTarget decodeTarget;
 };
 
 
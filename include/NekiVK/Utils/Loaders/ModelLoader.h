@@ -1,7 +1,11 @@
 #ifndef MODELLOADER_H
 #define MODELLOADER_H
 
+#include "../Allocators/HostArena.h"
+
 #include <vulkan/vulkan.h>
+#include <memory>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -55,10 +59,11 @@ struct Material
 };
 
 //A single drawable entity. A model can be composed of multiple meshes
+//Vertices and indices point into the parent Model's geometry arena
 struct Mesh
 {
-	std::vector<ModelVertex> vertices;
-	std::vector<std::uint32_t> indices;
+	std::span<ModelVertex> vertices;
+	std::span<std::uint32_t> indices;
 	std::size_t materialIndex;
 };
 
@@ -68,6 +73,7 @@ struct Model
 	std::string directory;
 	std::vector<Mesh> meshes;
 	std::vector<Material> materials;
+	std::shared_ptr<HostArena> geometry; //Owns every mesh's vertices and indices (shared between copies of the model)
 };
 
 
@@ -80,11 +86,14 @@ public:
 
 
 private:
+	//Recursively count the vertices and indices of every mesh ProcessNode() will produce, so that the geometry arena can be sized up front
+	static void CountGeometry(const aiNode* _node, const aiScene* _scene, std::size_t& _out_vertexCount, std::size_t& _out_indexCount);
+
 	//Recursively process nodes in the Assimp scene graph
 	static void ProcessNode(aiNode* _node, const aiScene* _scene, Model& _outModel);
 
-	//Translate an Assimp mesh to a Neki::Mesh
-	static Mesh ProcessMesh(aiMesh* _mesh, const aiScene* _scene, const std::string& _directory);
+	//Translate an Assimp mesh to a Neki::Mesh, placing its geometry in _arena
+	static Mesh ProcessMesh(aiMesh* _mesh, const aiScene* _scene, HostArena& _arena);
 };
 
 
@@ -0,0 +1,95 @@
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+//Static utility class of 8-bit pixel conversion kernels used on the image upload path (channel expansion/reduction, vertical flips, alpha premultiplication, colour space conversion)
+//ImageFactory/ImageLoader use ConvertChannels(), FlipVertically(), and ConvertRGBA8ToRGBA16F() (for half-float format overrides) - Premultiply(), SrgbToLinear(), and LinearToSrgb() are for callers preparing their own pixel data
+//Each kernel has a scalar implementation plus SSE4.1 and AVX2 implementations on x86, picked at runtime from what the CPU supports - every implementation produces identical output
+//Buffers don't need any particular alignment, and source and destination buffers must not overlap
+namespace Neki
+{
+
+
+enum class PIXEL_KERNEL_ISA : std::uint32_t
+{
+	SCALAR = 0,
+	SSE4   = 1,
+	AVX2   = 2,
+};
+
+
+class PixelKernels
+{
+public:
+	//Convert _texelCount texels of _srcChannels bytes each to _dstChannels per texel, writing into _dst
+	//Conversions match stb_image's: grey is replicated into RGB, RGB is reduced to its luminance, and missing alpha is opaque
+	//Expansions to RGBA (the common case for devices without 1-3 channel formats) and RGBA -> RGB are vectorised
+	static void ConvertChannels(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst);
+
+	//Flip _rowCount rows of _rowSize bytes upside down in place
+	static void FlipVertically(unsigned char* _pixels, std::size_t _rowSize, std::size_t _rowCount);
+
+	//Multiply the RGB of _texelCount RGBA texels by their alpha in place (rounded to nearest) - values are treated as linear
+	static void Premultiply(unsigned char* _pixels, std::size_t _texelCount);
+
+	//Convert the colour channels of _texelCount texels of _channels bytes each between sRGB and linear encodings, writing into _dst
+	//Alpha (the last channel of grey + alpha and RGBA texels) is copied as-is - these are table lookups, so there's no vectorised implementation
+	static void SrgbToLinear(const unsigned char* _src, std::size_t _texelCount, int _channels, unsigned char* _dst);
+	static void LinearToSrgb(const unsigned char* _src, std::size_t _texelCount, int _channels, unsigned char* _dst);
+
+	//Convert _texelCount RGBA8 texels to RGBA16F (VK_FORMAT_R16G16B16A16_SFLOAT), writing into _dst
+	//If _srgb is true, RGB is decoded from sRGB to linear on the way (avoiding the precision lost by going through 8-bit linear values)
+	static void ConvertRGBA8ToRGBA16F(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst);
+
+	//The best instruction set this CPU supports, and the one the kernels currently use (defaults to the best supported)
+	[[nodiscard]] static PIXEL_KERNEL_ISA GetSupportedISA();
+	[[nodiscard]] static PIXEL_KERNEL_ISA GetISA();
+
+	//Force the kernels to use _isa (clamped to what's supported) - intended for benchmarking and checking implementations against each other
+	static void SetISA(PIXEL_KERNEL_ISA _isa);
+
+	[[nodiscard]] static const char* GetISAName(PIXEL_KERNEL_ISA _isa);
+
+
+private:
+	static PIXEL_KERNEL_ISA DetectISA();
+
+	//Per-ISA implementations - each handles as many texels as it can and returns how many it handled, leaving the rest to the scalar implementation
+	static std::size_t ConvertChannelsSSE4(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst);
+	static std::size_t ConvertChannelsAVX2(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst);
+	static void ConvertChannelsScalar(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst);
+
+	static std::size_t SwapRowsSSE4(unsigned char* _a, unsigned char* _b, std::size_t _size);
+	static std::size_t SwapRowsAVX2(unsigned char* _a, unsigned char* _b, std::size_t _size);
+
+	static std::size_t PremultiplySSE4(unsigned char* _pixels, std::size_t _texelCount);
+	static std::size_t PremultiplyAVX2(unsigned char* _pixels, std::size_t _texelCount);
+	static void PremultiplyScalar(unsigned char* _pixels, std::size_t _texelCount);
+
+	static std::size_t ConvertRGBA8ToRGBA16FSSE4(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst);
+	static std::size_t ConvertRGBA8ToRGBA16FAVX2(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst);
+	static void ConvertRGBA8ToRGBA16FScalar(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst);
+
+	//Lookup tables, built once
+	static const float* GetSrgbToLinearFloatTable(); //256 entries, 0-1
+	static const unsigned char* GetSrgbToLinearTable(); //256 entries
+	static const unsigned char* GetLinearToSrgbTable(); //256 entries
+
+	//Convert a float in [0, 1] to half precision
+	//Done by rebiasing the exponent with a multiply rather than with F16C, so that every implementation rounds identically (half denormals fall out as float denormals)
+	static std::uint16_t FloatToHalf(float _value);
+
+	static std::atomic<PIXEL_KERNEL_ISA> isa;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
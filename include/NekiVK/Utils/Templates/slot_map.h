@@ -0,0 +1,146 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//Generic generational handle into a slot_map
+//Tag only exists to make handles to different resource types distinct types (e.g.: a buffer handle can't be passed where an image handle is expected)
+//A default-constructed handle is null - handles are otherwise only created by slot_map::Insert()
+template<typename Tag>
+struct slot_map_handle
+{
+	std::uint32_t index{ UINT32_MAX };
+	std::uint32_t generation{ 0 };
+
+	[[nodiscard]] constexpr bool IsNull() const { return index == UINT32_MAX; }
+	constexpr explicit operator bool() const { return !IsNull(); }
+	constexpr bool operator==(const slot_map_handle&) const = default;
+};
+
+
+//Generic dense slot map - values are stored contiguously and looked up through an indirection table, so lookups are O(1) with no hashing
+//Each slot carries a generation that's incremented when its value is erased, so stale handles (to freed or replaced values) are detected rather than aliasing whatever reuses the slot
+//Erasing swaps the last value into the hole, so pointers/references to values are invalidated by Insert() and Erase() - handles never are
+template<typename T, typename Tag>
+class slot_map
+{
+public:
+	using handle_type = slot_map_handle<Tag>;
+
+	//Insert a value, returning a handle to it
+	[[nodiscard]] handle_type Insert(T _value)
+	{
+		std::uint32_t slotIndex;
+		if (freeListHead != UINT32_MAX)
+		{
+			slotIndex = freeListHead;
+			freeListHead = slots[slotIndex].denseIndex;
+		}
+		else
+		{
+			slotIndex = static_cast<std::uint32_t>(slots.size());
+			slots.push_back({ 0, 0 });
+		}
+
+		slots[slotIndex].denseIndex = static_cast<std::uint32_t>(values.size());
+		values.push_back(std::move(_value));
+		denseToSlot.push_back(slotIndex);
+		return { slotIndex, slots[slotIndex].generation };
+	}
+
+
+	//Erase the value _handle refers to, returning false if _handle is stale or null
+	bool Erase(handle_type _handle)
+	{
+		if (!Contains(_handle))
+		{
+			return false;
+		}
+
+		//Move the last value into the erased value's place and repoint its slot
+		const std::uint32_t denseIndex{ slots[_handle.index].denseIndex };
+		const std::uint32_t lastDenseIndex{ static_cast<std::uint32_t>(values.size() - 1) };
+		if (denseIndex != lastDenseIndex)
+		{
+			values[denseIndex] = std::move(values[lastDenseIndex]);
+			denseToSlot[denseIndex] = denseToSlot[lastDenseIndex];
+			slots[denseToSlot[denseIndex]].denseIndex = denseIndex;
+		}
+		values.pop_back();
+		denseToSlot.pop_back();
+
+		//Bump the generation to invalidate outstanding handles, and push the slot onto the free list (denseIndex doubles as the next-free link)
+		++slots[_handle.index].generation;
+		slots[_handle.index].denseIndex = freeListHead;
+		freeListHead = _handle.index;
+		return true;
+	}
+
+
+	//Returns nullptr if _handle is stale or null
+	[[nodiscard]] T* Get(handle_type _handle)
+	{
+		return Contains(_handle) ? &values[slots[_handle.index].denseIndex] : nullptr;
+	}
+
+	[[nodiscard]] const T* Get(handle_type _handle) const
+	{
+		return Contains(_handle) ? &values[slots[_handle.index].denseIndex] : nullptr;
+	}
+
+
+	[[nodiscard]] bool Contains(handle_type _handle) const
+	{
+		return _handle.index < slots.size() && slots[_handle.index].generation == _handle.generation && !IsFree(_handle.index);
+	}
+
+
+	//Get the handle of the value at _denseIndex (for use when iterating over the values)
+	[[nodiscard]] handle_type GetHandle(std::size_t _denseIndex) const
+	{
+		const std::uint32_t slotIndex{ denseToSlot[_denseIndex] };
+		return { slotIndex, slots[slotIndex].generation };
+	}
+
+
+	[[nodiscard]] std::size_t Size() const { return values.size(); }
+	[[nodiscard]] bool Empty() const { return values.empty(); }
+
+	void Clear()
+	{
+		//Erase one by one so that every outstanding handle goes stale
+		while (!values.empty())
+		{
+			Erase(GetHandle(values.size() - 1));
+		}
+	}
+
+	//Values are iterated densely, in no particular order
+	[[nodiscard]] typename std::vector<T>::iterator begin() { return values.begin(); }
+	[[nodiscard]] typename std::vector<T>::iterator end() { return values.end(); }
+	[[nodiscard]] typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+	[[nodiscard]] typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+
+private:
+	struct Slot
+	{
+		std::uint32_t denseIndex; //Index into values if occupied, otherwise the next slot in the free list
+		std::uint32_t generation;
+	};
+
+	[[nodiscard]] bool IsFree(std::uint32_t _slotIndex) const
+	{
+		const std::uint32_t denseIndex{ slots[_slotIndex].denseIndex };
+		return denseIndex >= denseToSlot.size() || denseToSlot[denseIndex] != _slotIndex;
+	}
+
+	std::vector<T> values;
+	std::vector<std::uint32_t> denseToSlot;
+	std::vector<Slot> slots;
+	std::uint32_t freeListHead{ UINT32_MAX };
+};
+
+#endif
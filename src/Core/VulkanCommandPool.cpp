@@ -34,6 +34,10 @@ VulkanCommandPool::VulkanCommandPool(const VKLogger& _logger, VKDebugAllocator&
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::COMMAND_POOL, "Provided _poolType (COMPUTE) is not currently supported.\n");
 		throw std::runtime_error("");
 	}
+	else if (poolType == VK_COMMAND_POOL_TYPE::TRANSFER)
+	{
+		queueFamilyIndex = device.GetTransferQueueFamilyIndex();
+	}
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.pNext = nullptr;
@@ -148,6 +152,7 @@ std::string VulkanCommandPool::PoolTypeToString(VK_COMMAND_POOL_TYPE _poolType)
 	{
 		case VK_COMMAND_POOL_TYPE::GRAPHICS:	return "GRAPHICS";
 		case VK_COMMAND_POOL_TYPE::COMPUTE:		return "COMPUTE";
+		case VK_COMMAND_POOL_TYPE::TRANSFER:	return "TRANSFER";
 		default:								return "UNDEFINED";
 	}
 }
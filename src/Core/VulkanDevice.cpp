@@ -1,9 +1,11 @@
 #include "NekiVK/Core/VulkanDevice.h"
 #include "NekiVK/Debug/VKLogger.h"
+#include "NekiVK/Memory/MemoryTypeSelector.h"
 #include "NekiVK/Utils/Strings/format.h"
 
 #include <format>
 #include <cstring>
+#include <algorithm>
 #include <GLFW/glfw3.h>
 
 
@@ -12,6 +14,12 @@
 namespace Neki
 {
 
+//Extensions that are enabled automatically when they're available - NekiVK makes use of them if they're there but doesn't require them
+constexpr const char* OPTIONAL_INSTANCE_EXTENSIONS[]{ VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME };
+constexpr const char* OPTIONAL_DEVICE_EXTENSIONS[]{ VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, VK_KHR_BIND_MEMORY_2_EXTENSION_NAME, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME };
+
+
+
 std::string PhysicalDeviceTypeToString(const VkPhysicalDeviceType& _type)
 {
 	switch (_type)
@@ -42,9 +50,11 @@ VulkanDevice::VulkanDevice(const VKLogger& _logger,
 	physicalDevice = VK_NULL_HANDLE;
 	device = VK_NULL_HANDLE;
 	graphicsQueue = VK_NULL_HANDLE;
+	transferQueue = VK_NULL_HANDLE;
 	CreateInstance(_apiVer, _appName, _desiredInstanceLayerCount, _desiredInstanceLayers, _desiredInstanceExtensionCount, _desiredInstanceExtensions);
 	SelectPhysicalDevice();
 	CreateLogicalDevice(_desiredDeviceLayerCount, _desiredDeviceLayers, _desiredDeviceExtensionCount, _desiredDeviceExtensions);
+	memoryTypeSelector = std::make_unique<MemoryTypeSelector>(logger, *this);
 }
 
 
@@ -52,6 +62,7 @@ VulkanDevice::VulkanDevice(const VKLogger& _logger,
 VulkanDevice::~VulkanDevice()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::DEVICE,"Shutting down VulkanDevice\n");
+	memoryTypeSelector.reset();
 	
 	if (device != VK_NULL_HANDLE)
 	{
@@ -203,6 +214,15 @@ void VulkanDevice::CreateInstance(const std::uint32_t _apiVer, const char* _appN
 								  instanceExtensions[i].specVersion, specW) };
 		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, entryStr, VK_LOGGER_WIDTH::DEFAULT, false);
 
+		//Check if current extension is one NekiVK makes use of
+		for (const char* optionalExtension : OPTIONAL_INSTANCE_EXTENSIONS)
+		{
+			if (strcmp(optionalExtension, instanceExtensions[i].extensionName) == 0)
+			{
+				instanceExtensionNamesToBeAdded.push_back(optionalExtension);
+			}
+		}
+
 		//Check if current extension is in list of desired extensions or GLFW extensions
 		if (_desiredInstanceExtensionCount == 0 && glfwExtensionCount == 0) { continue; }
 		for (std::size_t j{ 0 }; j<_desiredInstanceExtensionCount; ++j)
@@ -224,6 +244,7 @@ void VulkanDevice::CreateInstance(const std::uint32_t _apiVer, const char* _appN
 	//Remove duplicates
 	std::sort(instanceExtensionNamesToBeAdded.begin(), instanceExtensionNamesToBeAdded.end(), [](const char* a, const char* b){ return std::strcmp(a,b) < 0; });
 	instanceExtensionNamesToBeAdded.erase(std::unique(instanceExtensionNamesToBeAdded.begin(), instanceExtensionNamesToBeAdded.end(), [](const char* a, const char* b) { return std::strcmp(a, b) == 0; }), instanceExtensionNamesToBeAdded.end());
+	enabledInstanceExtensions.assign(instanceExtensionNamesToBeAdded.begin(), instanceExtensionNamesToBeAdded.end());
 
 	for (const std::string& extensionName : instanceExtensionNamesToBeAdded)
 	{
@@ -274,6 +295,7 @@ void VulkanDevice::CreateInstance(const std::uint32_t _apiVer, const char* _appN
 	vkAppInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	vkAppInfo.pNext = nullptr;
 	vkAppInfo.apiVersion = _apiVer;
+	instanceApiVersion = _apiVer;
 	vkAppInfo.pApplicationName = _appName;
 	vkAppInfo.applicationVersion = 1;
 	vkAppInfo.pEngineName = "Vulkaneki";
@@ -591,6 +613,34 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 		throw std::runtime_error("");
 	}
 
+	//Look for a transfer-only queue family (a DMA engine on most discrete GPUs) so uploads don't compete with rendering - falling back to the graphics queue if there isn't one
+	//Families without compute are preferred as they're the most likely to map to dedicated copy hardware
+	transferQueueFamilyIndex = graphicsQueueFamilyIndex;
+	bool foundTransferOnlyQueue{ false };
+	for (std::size_t i{ 0 }; i < queueFamilies.size(); ++i)
+	{
+		const VkQueueFlags flags{ queueFamilies[i].queueFlags };
+		if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT) || queueFamilies[i].queueCount == 0) { continue; }
+		if (!(flags & VK_QUEUE_COMPUTE_BIT))
+		{
+			transferQueueFamilyIndex = i;
+			foundTransferOnlyQueue = true;
+			break;
+		}
+		if (transferQueueFamilyIndex == graphicsQueueFamilyIndex)
+		{
+			transferQueueFamilyIndex = i;
+		}
+	}
+	if (transferQueueFamilyIndex == graphicsQueueFamilyIndex)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "No dedicated transfer queue family - uploads will use the graphics queue\n");
+	}
+	else
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "Using queue family " + std::to_string(transferQueueFamilyIndex) + " for uploads (" + std::string(foundTransferOnlyQueue ? "transfer only" : "compute + transfer") + ")\n");
+	}
+
 	//Get desired layers for chosen device
 	std::uint32_t deviceLayerCount{ 0 };
 	VkResult result{ vkEnumerateDeviceLayerProperties(physicalDevice, &deviceLayerCount, nullptr) };
@@ -643,8 +693,28 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 	std::vector<VkExtensionProperties> deviceExtensions;
 	deviceExtensions.resize(deviceExtensionCount);
 	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &deviceExtensionCount, deviceExtensions.data());
+
+	//VK_EXT_memory_budget and VK_KHR_buffer_device_address depend on vkGetPhysicalDeviceProperties2 (core in 1.1)
+	//VK_EXT_external_memory_host depends on VK_KHR_external_memory - for simplicity it's only used where that's core (1.1)
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+	deviceApiVersion = std::min(instanceApiVersion, physicalDeviceProperties.apiVersion);
+	const bool properties2Available{ IsInstanceExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) || deviceApiVersion >= VK_API_VERSION_1_1 };
+
 	for (std::size_t i{ 0 }; i < deviceExtensionCount; ++i)
 	{
+		//Check if current extension is one NekiVK makes use of
+		for (const char* optionalExtension : OPTIONAL_DEVICE_EXTENSIONS)
+		{
+			if (strcmp(optionalExtension, deviceExtensions[i].extensionName) != 0) { continue; }
+			const bool needsProperties2{ strcmp(optionalExtension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0 || strcmp(optionalExtension, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) == 0 };
+			const bool needsVulkan11{ strcmp(optionalExtension, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == 0 };
+			if ((!needsProperties2 || properties2Available) && (!needsVulkan11 || deviceApiVersion >= VK_API_VERSION_1_1))
+			{
+				deviceExtensionNamesToBeAdded.push_back(optionalExtension);
+			}
+		}
+
 		//Check if current extension is in list of desired extensions
 		if (_desiredDeviceExtensionCount == 0) { continue; }
 		for (std::size_t j{ 0 }; j<_desiredDeviceExtensionCount; ++j)
@@ -659,6 +729,7 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 	//Remove duplicates
 	std::sort(deviceExtensionNamesToBeAdded.begin(), deviceExtensionNamesToBeAdded.end(), [](const char* a, const char* b){ return std::strcmp(a,b) < 0; });
 	deviceExtensionNamesToBeAdded.erase(std::unique(deviceExtensionNamesToBeAdded.begin(), deviceExtensionNamesToBeAdded.end(), [](const char* a, const char* b) { return std::strcmp(a, b) == 0; }), deviceExtensionNamesToBeAdded.end());
+	enabledDeviceExtensions.assign(deviceExtensionNamesToBeAdded.begin(), deviceExtensionNamesToBeAdded.end());
 	
 	for (const std::string& extensionName : deviceExtensionNamesToBeAdded)
 	{
@@ -693,22 +764,80 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 	{
 		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "Sampler anisotropy is not supported by this device.\n");
 	}
+	//BC formats are universal on desktop but absent on most mobile GPUs - ImageFactory checks format support before uploading block-compressed textures
+	if (supportedFeatures.textureCompressionBC) { requiredFeatures.textureCompressionBC = VK_TRUE; }
+	else
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "BC texture compression is not supported by this device.\n");
+	}
+
+	//Buffer device addresses are core in 1.2, otherwise they come from VK_KHR_buffer_device_address (which, for simplicity, is only used on 1.1 devices where VkMemoryAllocateFlagsInfo is core)
+	//Enabling the feature costs nothing - individual buffers still have to opt in with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+	bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+	bufferDeviceAddressFeatures.pNext = nullptr;
+	bufferDeviceAddressEnabled = false;
+	//Scalar block layout lets shaders read the tightly packed structs they're handed device addresses to - it's only requested where it's core (1.2)
+	VkPhysicalDeviceScalarBlockLayoutFeatures scalarBlockLayoutFeatures{};
+	scalarBlockLayoutFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SCALAR_BLOCK_LAYOUT_FEATURES;
+	scalarBlockLayoutFeatures.pNext = nullptr;
+	scalarBlockLayoutEnabled = false;
+	if (deviceApiVersion >= VK_API_VERSION_1_2 || (deviceApiVersion >= VK_API_VERSION_1_1 && IsDeviceExtensionEnabled(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)))
+	{
+		VkPhysicalDeviceFeatures2 supportedFeatures2{};
+		supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures2.pNext = &bufferDeviceAddressFeatures;
+		bufferDeviceAddressFeatures.pNext = deviceApiVersion >= VK_API_VERSION_1_2 ? &scalarBlockLayoutFeatures : nullptr;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+		bufferDeviceAddressEnabled = bufferDeviceAddressFeatures.bufferDeviceAddress == VK_TRUE;
+		scalarBlockLayoutEnabled = deviceApiVersion >= VK_API_VERSION_1_2 && scalarBlockLayoutFeatures.scalarBlockLayout == VK_TRUE;
+
+		//Only request the one feature
+		bufferDeviceAddressFeatures.bufferDeviceAddressCaptureReplay = VK_FALSE;
+		bufferDeviceAddressFeatures.bufferDeviceAddressMultiDevice = VK_FALSE;
+	}
+	if (!bufferDeviceAddressEnabled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "Buffer device addresses are not supported by this device.\n");
+	}
+	if (!scalarBlockLayoutEnabled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "Scalar block layout is not supported by this device.\n");
+	}
+
+	//Chain only the feature structs whose features are being enabled
+	void* featureChain{ nullptr };
+	if (scalarBlockLayoutEnabled)
+	{
+		scalarBlockLayoutFeatures.pNext = featureChain;
+		featureChain = &scalarBlockLayoutFeatures;
+	}
+	if (bufferDeviceAddressEnabled)
+	{
+		bufferDeviceAddressFeatures.pNext = featureChain;
+		featureChain = &bufferDeviceAddressFeatures;
+	}
 
-	VkDeviceQueueCreateInfo queueCreateInfo{};
-	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueCreateInfo.pNext = nullptr;
-	queueCreateInfo.flags = 0;
-	queueCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-	queueCreateInfo.queueCount = 1;
+	//One queue from the graphics family, plus one from the transfer family if it's a different one
 	constexpr float queuePriority{ 1.0f };
-	queueCreateInfo.pQueuePriorities = &queuePriority;
+	VkDeviceQueueCreateInfo queueCreateInfos[2]{};
+	std::uint32_t queueCreateInfoCount{ HasDedicatedTransferQueue() ? 2u : 1u };
+	for (std::uint32_t i{ 0 }; i < queueCreateInfoCount; ++i)
+	{
+		queueCreateInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfos[i].pNext = nullptr;
+		queueCreateInfos[i].flags = 0;
+		queueCreateInfos[i].queueFamilyIndex = (i == 0) ? graphicsQueueFamilyIndex : transferQueueFamilyIndex;
+		queueCreateInfos[i].queueCount = 1;
+		queueCreateInfos[i].pQueuePriorities = &queuePriority;
+	}
 
 	VkDeviceCreateInfo deviceCreateInfo{};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCreateInfo.pNext = nullptr;
+	deviceCreateInfo.pNext = featureChain;
 	deviceCreateInfo.flags = 0;
-	deviceCreateInfo.queueCreateInfoCount = 1;
-	deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+	deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
+	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
 	deviceCreateInfo.enabledLayerCount = deviceLayerNamesToBeAdded.size();
 	deviceCreateInfo.ppEnabledLayerNames = deviceLayerNamesToBeAdded.data();
 	deviceCreateInfo.enabledExtensionCount = deviceExtensionNamesToBeAdded.size();
@@ -727,9 +856,14 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 		return;
 	}
 
-	//Get the queue handle
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "Getting queue handle\n");
+	//Get the queue handles
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "Getting queue handle" + std::string(HasDedicatedTransferQueue() ? "s" : "") + "\n");
 	vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
+	transferQueue = graphicsQueue;
+	if (HasDedicatedTransferQueue())
+	{
+		vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue);
+	}
 }
 
 
@@ -739,6 +873,45 @@ const VkPhysicalDevice& VulkanDevice::GetPhysicalDevice() const { return physica
 const VkDevice& VulkanDevice::GetDevice() const { return device; }
 const VkQueue& VulkanDevice::GetGraphicsQueue() const { return graphicsQueue; }
 const std::size_t& VulkanDevice::GetGraphicsQueueFamilyIndex() const { return graphicsQueueFamilyIndex; }
+const VkQueue& VulkanDevice::GetTransferQueue() const { return transferQueue; }
+const std::size_t& VulkanDevice::GetTransferQueueFamilyIndex() const { return transferQueueFamilyIndex; }
+bool VulkanDevice::HasDedicatedTransferQueue() const { return transferQueueFamilyIndex != graphicsQueueFamilyIndex; }
+std::uint32_t VulkanDevice::GetInstanceApiVersion() const { return instanceApiVersion; }
+std::uint32_t VulkanDevice::GetDeviceApiVersion() const { return deviceApiVersion; }
+bool VulkanDevice::IsBufferDeviceAddressEnabled() const { return bufferDeviceAddressEnabled; }
+bool VulkanDevice::IsScalarBlockLayoutEnabled() const { return scalarBlockLayoutEnabled; }
+MemoryTypeSelector& VulkanDevice::GetMemoryTypeSelector() const { return *memoryTypeSelector; }
+
+
+
+bool VulkanDevice::IsInstanceExtensionEnabled(const char* _extensionName) const
+{
+	return std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), _extensionName) != enabledInstanceExtensions.end();
+}
+
+
+
+bool VulkanDevice::IsDeviceExtensionEnabled(const char* _extensionName) const
+{
+	return std::find(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(), _extensionName) != enabledDeviceExtensions.end();
+}
+
+
+
+bool VulkanDevice::IsFormatSupported(VkFormat _format, VkImageTiling _tiling, VkFormatFeatureFlags _features) const
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, _format, &props);
+	if (_tiling == VK_IMAGE_TILING_LINEAR)
+	{
+		return (props.linearTilingFeatures & _features) == _features;
+	}
+	if (_tiling == VK_IMAGE_TILING_OPTIMAL)
+	{
+		return (props.optimalTilingFeatures & _features) == _features;
+	}
+	return false;
+}
 
 
 
@@ -746,13 +919,7 @@ VkFormat VulkanDevice::FindSupportedFormat(const std::vector<VkFormat>& _candida
 {
 	for (const VkFormat& format : _candidates)
 	{
-		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-		if (_tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & _features) == _features)
-		{
-			return format;
-		}
-		if (_tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & _features) == _features)
+		if (IsFormatSupported(format, _tiling, _features))
 		{
 			return format;
 		}
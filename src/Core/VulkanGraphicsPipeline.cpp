@@ -1,6 +1,6 @@
 #include "NekiVK/Core/VulkanGraphicsPipeline.h"
+#include "NekiVK/Utils/Files/FileView.h"
 #include <stdexcept>
-#include <fstream>
 
 namespace Neki
 {
@@ -57,31 +57,21 @@ void VulkanGraphicsPipeline::CreateShaderModules(const std::vector<const char*>&
 
 	//Read vertex shader
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::PIPELINE, "Reading vertex shader (" + std::string(_filepaths[0]) + ".spv)", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	std::ifstream vertFile(std::string(_filepaths[0]) + std::string(".spv"), std::ios::ate | std::ios::binary);
-	logger.Log(vertFile.is_open() ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::PIPELINE, vertFile.is_open() ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (!vertFile.is_open())
+	const std::shared_ptr<const FileView> vertFile{ FileView::Open(std::string(_filepaths[0]) + std::string(".spv")) };
+	logger.Log(vertFile ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::PIPELINE, vertFile ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (!vertFile)
 	{
 		throw std::runtime_error("");
 	}
-	std::streamsize vertShaderFileSize{ static_cast<std::streamsize>(vertFile.tellg()) };
-	std::vector<char> vertShaderBuf(vertShaderFileSize);
-	vertFile.seekg(0);
-	vertFile.read(vertShaderBuf.data(), vertShaderFileSize);
-	vertFile.close();
 	
 	//Read fragment shader
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::PIPELINE, "Reading fragment shader (" + std::string(_filepaths[1]) + ".spv)", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	std::ifstream fragFile(std::string(_filepaths[1]) + std::string(".spv"), std::ios::ate | std::ios::binary);
-	logger.Log(fragFile.is_open() ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::PIPELINE, fragFile.is_open() ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (!fragFile.is_open())
+	const std::shared_ptr<const FileView> fragFile{ FileView::Open(std::string(_filepaths[1]) + std::string(".spv")) };
+	logger.Log(fragFile ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::PIPELINE, fragFile ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (!fragFile)
 	{
 		throw std::runtime_error("");
 	}
-	std::streamsize fragShaderFileSize{ static_cast<std::streamsize>(fragFile.tellg()) };
-	std::vector<char> fragShaderBuf(fragShaderFileSize);
-	fragFile.seekg(0);
-	fragFile.read(fragShaderBuf.data(), fragShaderFileSize);
-	fragFile.close();
 
 
 	//Create vertexShaderModule
@@ -89,8 +79,8 @@ void VulkanGraphicsPipeline::CreateShaderModules(const std::vector<const char*>&
 	vertShaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	vertShaderModuleInfo.pNext = nullptr;
 	vertShaderModuleInfo.flags = 0;
-	vertShaderModuleInfo.codeSize = vertShaderBuf.size();
-	vertShaderModuleInfo.pCode = reinterpret_cast<const std::uint32_t*>(vertShaderBuf.data());
+	vertShaderModuleInfo.codeSize = vertFile->GetSize();
+	vertShaderModuleInfo.pCode = reinterpret_cast<const std::uint32_t*>(vertFile->GetData()); //Mappings are page-aligned, so the code is suitably aligned
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::PIPELINE, "Creating vertex shader module", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkResult result{ vkCreateShaderModule(device.GetDevice(), &vertShaderModuleInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &(shaderModules[0])) };
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::PIPELINE, result == VK_SUCCESS ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
@@ -105,8 +95,8 @@ void VulkanGraphicsPipeline::CreateShaderModules(const std::vector<const char*>&
 	fragShaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	fragShaderModuleInfo.pNext = nullptr;
 	fragShaderModuleInfo.flags = 0;
-	fragShaderModuleInfo.codeSize = fragShaderBuf.size();
-	fragShaderModuleInfo.pCode = reinterpret_cast<const std::uint32_t*>(fragShaderBuf.data());
+	fragShaderModuleInfo.codeSize = fragFile->GetSize();
+	fragShaderModuleInfo.pCode = reinterpret_cast<const std::uint32_t*>(fragFile->GetData()); //Mappings are page-aligned, so the code is suitably aligned
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::PIPELINE, "Creating fragment shader module", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	result = vkCreateShaderModule(device.GetDevice(), &fragShaderModuleInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &(shaderModules[1]));
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::PIPELINE, result == VK_SUCCESS ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
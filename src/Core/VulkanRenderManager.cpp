@@ -183,6 +183,16 @@ void VulkanRenderManager::StartFrame(std::uint32_t _clearValueCount, const VkCle
 	//Reset back to unsignalled - fence will be signalled again once rendering of this frame has finished
 	vkResetFences(device.GetDevice(), 1, &(inFlightFences[currentFrame]));
 
+	//The GPU is done with this frame's previous transient allocations
+	for (FrameLinearAllocator* frameAllocator : frameAllocators)
+	{
+		frameAllocator->BeginFrame(currentFrame);
+	}
+	for (GrowableBuffer* growableBuffer : growableBuffers)
+	{
+		growableBuffer->BeginFrame(currentFrame);
+	}
+
 
 	//Start recording the command buffer
 	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
@@ -231,10 +241,15 @@ void VulkanRenderManager::SubmitAndPresent()
 	submitInfo.pNext = nullptr;
 
 	//Todo: get wait stages from render pass create info
-	constexpr VkPipelineStageFlags waitStages[]{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &(imageAvailableSemaphores[currentFrame]);
-	submitInfo.pWaitDstStageMask = waitStages;
+	std::vector<VkSemaphore> waitSemaphores{ imageAvailableSemaphores[currentFrame] };
+	std::vector<VkPipelineStageFlags> waitStages{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	waitSemaphores.insert(waitSemaphores.end(), additionalWaitSemaphores.begin(), additionalWaitSemaphores.end());
+	waitStages.insert(waitStages.end(), additionalWaitStages.begin(), additionalWaitStages.end());
+	additionalWaitSemaphores.clear();
+	additionalWaitStages.clear();
+	submitInfo.waitSemaphoreCount = static_cast<std::uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 	submitInfo.signalSemaphoreCount = 1;
@@ -267,6 +282,59 @@ void VulkanRenderManager::SubmitAndPresent()
 
 
 
+void VulkanRenderManager::AttachFrameAllocator(FrameLinearAllocator& _frameAllocator)
+{
+	if (_frameAllocator.GetFramesInFlight() != framesInFlight)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Frame allocator has " + std::to_string(_frameAllocator.GetFramesInFlight()) + " frames in flight, render manager has " + std::to_string(framesInFlight) + "\n");
+		throw std::runtime_error("");
+	}
+	if (std::find(frameAllocators.begin(), frameAllocators.end(), &_frameAllocator) == frameAllocators.end())
+	{
+		frameAllocators.push_back(&_frameAllocator);
+	}
+	_frameAllocator.BeginFrame(currentFrame);
+}
+
+
+
+void VulkanRenderManager::DetachFrameAllocator(FrameLinearAllocator& _frameAllocator)
+{
+	std::erase(frameAllocators, &_frameAllocator);
+}
+
+
+
+void VulkanRenderManager::AttachGrowableBuffer(GrowableBuffer& _growableBuffer)
+{
+	if (_growableBuffer.GetFramesInFlight() != framesInFlight)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Growable buffer has " + std::to_string(_growableBuffer.GetFramesInFlight()) + " frames in flight, render manager has " + std::to_string(framesInFlight) + "\n");
+		throw std::runtime_error("");
+	}
+	if (std::find(growableBuffers.begin(), growableBuffers.end(), &_growableBuffer) == growableBuffers.end())
+	{
+		growableBuffers.push_back(&_growableBuffer);
+	}
+}
+
+
+
+void VulkanRenderManager::DetachGrowableBuffer(GrowableBuffer& _growableBuffer)
+{
+	std::erase(growableBuffers, &_growableBuffer);
+}
+
+
+
+void VulkanRenderManager::WaitOnSemaphore(VkSemaphore _semaphore, VkPipelineStageFlags _waitStage)
+{
+	additionalWaitSemaphores.push_back(_semaphore);
+	additionalWaitStages.push_back(_waitStage);
+}
+
+
+
 VkCommandBuffer VulkanRenderManager::GetCurrentCommandBuffer()
 {
 	return commandBuffers[currentFrame];
@@ -274,6 +342,20 @@ VkCommandBuffer VulkanRenderManager::GetCurrentCommandBuffer()
 
 
 
+std::size_t VulkanRenderManager::GetCurrentFrameIndex() const
+{
+	return currentFrame;
+}
+
+
+
+std::size_t VulkanRenderManager::GetFramesInFlight() const
+{
+	return framesInFlight;
+}
+
+
+
 VkRenderPass VulkanRenderManager::GetRenderPass()
 {
 	return renderPass;
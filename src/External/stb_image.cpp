@@ -1,2 +1,8 @@
+#include "NekiVK/Utils/Loaders/ImageLoader.h"
+
+//Route stb_image's allocations through ImageLoader so that ImageLoader::LoadInto() can have images decoded straight into their destination
+#define STBI_MALLOC(_size) ImageLoader::DecodeMalloc(_size)
+#define STBI_REALLOC(_pointer, _size) ImageLoader::DecodeRealloc(_pointer, _size)
+#define STBI_FREE(_pointer) ImageLoader::DecodeFree(_pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "NekiVK/Memory/BufferFactory.h"
 #include "NekiVK/Utils/Strings/format.h"
 
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include <algorithm>
 
@@ -11,10 +13,57 @@ namespace Neki
 
 
 BufferFactory::BufferFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VulkanCommandPool& _commandPool)
-							: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), commandPool(_commandPool)
+							: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), commandPool(_commandPool),
+							  memoryHeap(_logger, _deviceDebugAllocator, _device, VK_LOGGER_LAYER::BUFFER_FACTORY)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY, "Buffer Factory Initialised\n");
+
+	//Uploads are recorded into command buffers for the transfer queue if the device has one of its own
+	if (device.HasDedicatedTransferQueue())
+	{
+		transferCommandPool = std::make_unique<VulkanCommandPool>(logger, deviceDebugAllocator, device, VK_COMMAND_POOL_TYPE::TRANSFER);
+	}
+
+	directWriteAvailable = DetectDirectWrite();
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Device-local uploads will " + std::string(directWriteAvailable ? "be written directly by the host (device-local memory is host-visible)" : "go through the staging ring") + "\n");
+
+	//vkBindBufferMemory2 is core in 1.1, otherwise it comes from VK_KHR_bind_memory2 - without either, buffers are bound one at a time
+	bindBufferMemory2 = nullptr;
+	if (device.GetDeviceApiVersion() >= VK_API_VERSION_1_1)
+	{
+		bindBufferMemory2 = reinterpret_cast<PFN_vkBindBufferMemory2>(vkGetDeviceProcAddr(device.GetDevice(), "vkBindBufferMemory2"));
+	}
+	else if (device.IsDeviceExtensionEnabled(VK_KHR_BIND_MEMORY_2_EXTENSION_NAME))
+	{
+		bindBufferMemory2 = reinterpret_cast<PFN_vkBindBufferMemory2>(vkGetDeviceProcAddr(device.GetDevice(), "vkBindBufferMemory2KHR"));
+	}
+
+	//vkGetBufferDeviceAddress is core in 1.2, otherwise it comes from VK_KHR_buffer_device_address
+	getBufferDeviceAddress = nullptr;
+	if (device.IsBufferDeviceAddressEnabled())
+	{
+		const char* functionName{ device.GetDeviceApiVersion() >= VK_API_VERSION_1_2 ? "vkGetBufferDeviceAddress" : "vkGetBufferDeviceAddressKHR" };
+		getBufferDeviceAddress = reinterpret_cast<PFN_vkGetBufferDeviceAddress>(vkGetDeviceProcAddr(device.GetDevice(), functionName));
+	}
+
+	//Host allocations can only be imported as VkDeviceMemory with VK_EXT_external_memory_host
+	getMemoryHostPointerProperties = nullptr;
+	hostImportAlignment = 0;
+	if (device.IsDeviceExtensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+	{
+		getMemoryHostPointerProperties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(device.GetDevice(), "vkGetMemoryHostPointerPropertiesEXT"));
+
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties{};
+		hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+		hostProperties.pNext = nullptr;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &hostProperties;
+		vkGetPhysicalDeviceProperties2(device.GetPhysicalDevice(), &properties2);
+		hostImportAlignment = hostProperties.minImportedHostPointerAlignment;
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Host memory can be imported (minimum alignment: " + GetFormattedSizeString(hostImportAlignment) + ")\n");
+	}
 }
 
 
@@ -22,9 +71,19 @@ BufferFactory::BufferFactory(const VKLogger& _logger, VKDebugAllocator& _deviceD
 BufferFactory::~BufferFactory()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY,"Shutting down BufferFactory\n");
-	while (!bufferMemoryMap.empty())
+	stagingRing.reset();
+	ReleaseRetiredBuffers(true);
+	for (const RetiredBuffer& retired : retiredBuffers)
 	{
-		VkBuffer buffer{ bufferMemoryMap.begin()->first };
+		//Freed mid-move, by a pass whose batch never completed
+		vkDestroyBuffer(device.GetDevice(), retired.buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		memoryHeap.Free(retired.allocation);
+	}
+	retiredBuffers.clear();
+	while (!buffers.Empty())
+	{
+		//Free from the back so that the slot map doesn't have to move any records
+		BufferHandle buffer{ buffers.GetHandle(buffers.Size() - 1) };
 		FreeBufferImpl(buffer);
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  All buffers and underlying memory freed\n");
@@ -32,28 +91,27 @@ BufferFactory::~BufferFactory()
 
 
 
-VkBuffer BufferFactory::AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags)
+BufferHandle BufferFactory::AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags, const VkMemoryPropertyFlags _preferredMemFlags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating 1 Buffer And Associated Memory\n");
-	return AllocateBufferImpl(_size, _usage, _sharingMode, _requiredMemFlags);
+	return AllocateBufferImpl(_size, _usage, _sharingMode, _requiredMemFlags, _preferredMemFlags);
 }
 
 
 
-std::vector<VkBuffer> BufferFactory::AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, const VkMemoryPropertyFlags* _requiredMemFlags)
+std::vector<BufferHandle> BufferFactory::AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, const VkMemoryPropertyFlags* _requiredMemFlags, const VkMemoryPropertyFlags* _preferredMemFlags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating " + std::to_string(_count) + " Buffer" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkBuffer> buffers;
-	for (std::size_t i{ 0 }; i<_count; ++i)
+	if (_count == 1)
 	{
-		buffers.push_back(AllocateBufferImpl(_sizes[i], _usages[i], _sharingModes[i], _requiredMemFlags[i]));
+		return { AllocateBufferImpl(_sizes[0], _usages[0], _sharingModes ? _sharingModes[0] : VK_SHARING_MODE_EXCLUSIVE, _requiredMemFlags ? _requiredMemFlags[0] : 0, _preferredMemFlags ? _preferredMemFlags[0] : 0) };
 	}
-	return buffers;
+	return AllocateBuffersPacked(_count, _sizes, _usages, _sharingModes, _requiredMemFlags, _preferredMemFlags);
 }
 
 
 
-void BufferFactory::FreeBuffer(VkBuffer& _buffer)
+void BufferFactory::FreeBuffer(BufferHandle& _buffer)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Freeing 1 Buffer And Associated Memory\n");
 	FreeBufferImpl(_buffer);
@@ -61,7 +119,7 @@ void BufferFactory::FreeBuffer(VkBuffer& _buffer)
 
 
 
-void BufferFactory::FreeBuffers(std::uint32_t _count, VkBuffer* _buffers)
+void BufferFactory::FreeBuffers(std::uint32_t _count, BufferHandle* _buffers)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY,"Freeing " + std::to_string(_count) + " Buffer" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n");
 	for (std::size_t i{ 0 }; i<_count; ++i)
@@ -72,74 +130,522 @@ void BufferFactory::FreeBuffers(std::uint32_t _count, VkBuffer* _buffers)
 
 
 
-VkBuffer BufferFactory::TransferToDeviceLocalBuffer(VkBuffer& _buffer, bool _freeSourceBuffer, VkCommandBuffer* _commandBuffer)
+BufferHandle BufferFactory::TransferToDeviceLocalBuffer(BufferHandle& _buffer, bool _freeSourceBuffer, VkCommandBuffer* _commandBuffer)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Transferring Host-Visible Buffer To Device-Local Heap\n");
-	if ((bufferMetadataMap[_buffer].usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
+	bool copied{ false };
+	BufferHandle dstBuffer{ TransferToDeviceLocalBufferImpl(_buffer, copied) };
+	if (copied)
 	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Source buffer wasn't created with the TRANSFER_SRC_BIT usage flag\n");
+		//The host has already written the new buffer - there's nothing to submit or wait for
+		if (_freeSourceBuffer)
+		{
+			FreeBuffer(_buffer);
+		}
+		return dstBuffer;
+	}
+
+	if (_commandBuffer == nullptr)
+	{
+		//Record into a temporary batch and block until the copy is complete
+		const std::unique_ptr<UploadBatch> uploadBatch{ CreateUploadBatch() };
+		RecordOwnershipTransfers(_buffer, *uploadBatch);
+		RecordOwnershipTransfers(dstBuffer, *uploadBatch);
+		uploadBatch->CopyBuffer(GetBuffer(_buffer), GetBuffer(dstBuffer), GetMetadata(_buffer).size);
+		if (_freeSourceBuffer)
+		{
+			uploadBatch->DeferFree(_buffer);
+			_buffer = {};
+		}
+		uploadBatch->Wait();
+		return dstBuffer;
+	}
+
+	//Record copy command
+	VkBufferCopy region{};
+	region.size = GetMetadata(_buffer).size;
+	region.srcOffset = 0;
+	region.dstOffset = 0;
+	vkCmdCopyBuffer(*_commandBuffer, GetBuffer(_buffer), GetBuffer(dstBuffer), 1, &region);
+	if (_freeSourceBuffer)
+	{
+		FreeBuffer(_buffer);
+	}
+	return dstBuffer;
+}
+
+
+
+BufferHandle BufferFactory::TransferToDeviceLocalBuffer(BufferHandle& _buffer, UploadBatch& _uploadBatch, bool _freeSourceBuffer)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Recording Transfer Of Host-Visible Buffer To Device-Local Heap\n");
+	bool copied{ false };
+	BufferHandle dstBuffer{ TransferToDeviceLocalBufferImpl(_buffer, copied) };
+	if (copied)
+	{
+		if (_freeSourceBuffer)
+		{
+			FreeBuffer(_buffer);
+		}
+		return dstBuffer;
+	}
+
+	RecordOwnershipTransfers(_buffer, _uploadBatch);
+	RecordOwnershipTransfers(dstBuffer, _uploadBatch);
+	_uploadBatch.CopyBuffer(GetBuffer(_buffer), GetBuffer(dstBuffer), GetMetadata(_buffer).size);
+	if (_freeSourceBuffer)
+	{
+		_uploadBatch.DeferFree(_buffer);
+		_buffer = {};
+	}
+	return dstBuffer;
+}
+
+
+
+BufferHandle BufferFactory::AllocateDeviceLocalBuffer(const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, UploadBatch& _uploadBatch, VkSharingMode _sharingMode)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating 1 Device-Local Buffer Populated With " + GetFormattedSizeString(_size) + " Of Data\n");
+
+	//TRANSFER_DST is always added - even with direct writes available, the host-visible device-local heap may be out of budget and force the staging path
+	const BufferHandle buffer{ AllocateBufferImpl(_size, _usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, directWriteAvailable ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : 0) };
+	if (void* mapped{ memoryHeap.GetMappedPointer(GetRecord(buffer).allocation) })
+	{
+		memcpy(mapped, _data, static_cast<std::size_t>(_size));
+		FlushBuffer(buffer);
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Data written directly to device-local memory\n");
+		return buffer;
+	}
+
+	UploadToBuffer(buffer, _data, _size, _uploadBatch);
+	return buffer;
+}
+
+
+
+std::vector<BufferHandle> BufferFactory::AllocateDeviceLocalBuffers(std::uint32_t _count, const void** _data, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, UploadBatch& _uploadBatch)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating " + std::to_string(_count) + " Device-Local Buffer" + std::string(_count == 1 ? "" : "s") + " Populated With Data\n");
+
+	std::vector<VkBufferUsageFlags> usages(_count);
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		usages[i] = _usages[i] | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	}
+	const std::vector<VkMemoryPropertyFlags> requiredMemFlags(_count, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	const std::vector<VkMemoryPropertyFlags> preferredMemFlags(_count, directWriteAvailable ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : 0);
+	std::vector<BufferHandle> handles{ _count == 1 ?
+		std::vector<BufferHandle>{ AllocateBufferImpl(_sizes[0], usages[0], VK_SHARING_MODE_EXCLUSIVE, requiredMemFlags[0], preferredMemFlags[0]) } :
+		AllocateBuffersPacked(_count, _sizes, usages.data(), nullptr, requiredMemFlags.data(), preferredMemFlags.data()) };
+
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		if (void* mapped{ memoryHeap.GetMappedPointer(GetRecord(handles[i]).allocation) })
+		{
+			memcpy(mapped, _data[i], static_cast<std::size_t>(_sizes[i]));
+			FlushBuffer(handles[i]);
+		}
+		else
+		{
+			UploadToBuffer(handles[i], _data[i], _sizes[i], _uploadBatch);
+		}
+	}
+	return handles;
+}
+
+
+
+bool BufferFactory::IsDirectWriteAvailable() const
+{
+	return directWriteAvailable;
+}
+
+
+
+BufferHandle BufferFactory::ImportHostBuffer(void* _hostPointer, VkDeviceSize _size, VkBufferUsageFlags _usage)
+{
+	if (getMemoryHostPointerProperties == nullptr || _hostPointer == nullptr || _size == 0)
+	{
+		return {};
+	}
+	if (reinterpret_cast<std::uintptr_t>(_hostPointer) % hostImportAlignment != 0 || _size % hostImportAlignment != 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Host pointer or size isn't a multiple of the minimum import alignment (" + GetFormattedSizeString(hostImportAlignment) + ") - it can't be imported\n");
+		return {};
+	}
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Importing " + GetFormattedSizeString(_size) + " Of Host Memory As A Buffer\n");
+
+	//Not every pointer can be imported (e.g.: memory-mapped files on some drivers) - the driver reports which memory types it can be imported as
+	VkMemoryHostPointerPropertiesEXT pointerProperties{};
+	pointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+	pointerProperties.pNext = nullptr;
+	if (getMemoryHostPointerProperties(device.GetDevice(), VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, _hostPointer, &pointerProperties) != VK_SUCCESS || pointerProperties.memoryTypeBits == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Driver can't import the host pointer\n");
+		return {};
+	}
+
+	VkExternalMemoryBufferCreateInfo externalInfo{};
+	externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+	externalInfo.pNext = nullptr;
+	externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = &externalInfo;
+	bufferInfo.size = _size;
+	bufferInfo.usage = _usage | MOVABLE_USAGE_FLAGS;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VkBuffer buffer;
+	VkResult result{ vkCreateBuffer(device.GetDevice(), &bufferInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &buffer) };
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to create buffer for imported host memory (" + std::to_string(result) + ")\n");
 		throw std::runtime_error("");
 	}
-	if ((bufferMetadataMap[_buffer].flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+
+	//Only HOST_COHERENT types are accepted so that imported buffers never need flushing
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device.GetDevice(), buffer, &memRequirements);
+	const std::uint32_t memoryTypeIndex{ device.GetMemoryTypeSelector().SelectMemoryType(memRequirements.memoryTypeBits & pointerProperties.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
+	if (memoryTypeIndex == UINT32_MAX)
 	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Source buffer wasn't created with the HOST_VISIBLE memory property flag\n");
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  No HOST_COHERENT memory type can import the host pointer\n");
+		vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		return {};
+	}
+
+	VkImportMemoryHostPointerInfoEXT importInfo{};
+	importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+	importInfo.pNext = nullptr;
+	importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+	importInfo.pHostPointer = _hostPointer;
+
+	VkMemoryAllocateFlagsInfo allocFlagsInfo{};
+	allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	allocFlagsInfo.pNext = nullptr;
+	allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+	allocFlagsInfo.deviceMask = 0;
+	if (device.IsBufferDeviceAddressEnabled())
+	{
+		importInfo.pNext = &allocFlagsInfo;
+	}
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = &importInfo;
+	allocInfo.allocationSize = _size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+	VkDeviceMemory memory;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Importing host memory (memory type " + std::to_string(memoryTypeIndex) + ")", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	result = vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &memory);
+	if (result == VK_SUCCESS)
+	{
+		result = vkBindBufferMemory(device.GetDevice(), buffer, memory, 0);
+		if (result != VK_SUCCESS)
+		{
+			vkFreeMemory(device.GetDevice(), memory, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		}
+	}
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		return {};
+	}
+
+	//Imported memory is pinned system memory rather than a new allocation from the heap, so it isn't reported to the MemoryTypeSelector
+	BufferRecord record{};
+	record.buffer = buffer;
+	record.allocation.memory = memory;
+	record.allocation.offset = 0;
+	record.allocation.size = _size;
+	record.allocation.memoryTypeIndex = memoryTypeIndex;
+	record.allocation.blockIndex = UINT32_MAX;
+	record.allocation.node = UINT32_MAX;
+	record.metadata.size = _size;
+	record.metadata.usage = _usage;
+	record.metadata.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	record.metadata.flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	record.packIndex = UINT32_MAX;
+	record.moving = false;
+	record.importedPointer = _hostPointer;
+	return buffers.Insert(record);
+}
+
+
+
+bool BufferFactory::IsHostImportAvailable() const
+{
+	return getMemoryHostPointerProperties != nullptr;
+}
+
+
+
+VkDeviceSize BufferFactory::GetHostImportAlignment() const
+{
+	return hostImportAlignment;
+}
+
+
+
+VkDeviceSize BufferFactory::Defragment(UploadBatch& _uploadBatch, VkDeviceSize _maxBytesToMove)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Recording Defragmentation Pass (budget: " + GetFormattedSizeString(_maxBytesToMove) + ")\n");
+
+	ReleaseRetiredBuffers(false);
+
+	VkDeviceSize bytesMoved{ 0 };
+	std::uint32_t buffersMoved{ 0 };
+	const VkPhysicalDeviceMemoryProperties& memoryProperties{ memoryHeap.GetMemoryProperties() };
+	for (std::uint32_t memTypeIndex{ 0 }; memTypeIndex < memoryProperties.memoryTypeCount; ++memTypeIndex)
+	{
+		//Empty the memory type's sparsest block into its denser ones, so the heap can release it once everything has moved out
+		const std::uint32_t sourceBlockIndex{ memoryHeap.GetSparsestBlock(memTypeIndex) };
+		if (sourceBlockIndex == UINT32_MAX) { continue; }
+
+		for (std::size_t i{ 0 }; i < buffers.Size(); ++i)
+		{
+			const BufferHandle handle{ buffers.GetHandle(i) };
+			BufferRecord& record{ *buffers.Get(handle) };
+			if (record.allocation.memoryTypeIndex != memTypeIndex || record.allocation.blockIndex != sourceBlockIndex) { continue; }
+
+			//Packed buffers share their region with the rest of their pack, the user may be holding mapped pointers to buffers that required HOST_VISIBLE memory, device addresses may have been written into other buffers, and descriptors may have been written with the buffer
+			if (record.packIndex != UINT32_MAX || record.moving || (record.metadata.flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || (record.metadata.usage & (VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | DESCRIPTOR_USAGE_FLAGS))) { continue; }
+			if (record.importedPointer != nullptr) { continue; }
+			if (bytesMoved + record.metadata.size > _maxBytesToMove) { continue; }
+
+			//Create the buffer's replacement and place it in one of the memory type's other blocks
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.pNext = nullptr;
+			bufferInfo.size = record.metadata.size;
+			bufferInfo.usage = record.metadata.usage | MOVABLE_USAGE_FLAGS;
+			bufferInfo.sharingMode = record.metadata.sharingMode;
+			VkBuffer newBuffer;
+			VkResult result{ vkCreateBuffer(device.GetDevice(), &bufferInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &newBuffer) };
+			if (result != VK_SUCCESS)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to create replacement buffer (" + std::to_string(result) + ") - ending pass early\n");
+				break;
+			}
+			VkMemoryRequirements memRequirements;
+			vkGetBufferMemoryRequirements(device.GetDevice(), newBuffer, &memRequirements);
+			MemoryAllocation newAllocation{};
+			if (!(memRequirements.memoryTypeBits & (1u << memTypeIndex)) || !memoryHeap.AllocateForMove(memRequirements, memTypeIndex, sourceBlockIndex, newAllocation))
+			{
+				vkDestroyBuffer(device.GetDevice(), newBuffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+				continue;
+			}
+			result = vkBindBufferMemory(device.GetDevice(), newBuffer, newAllocation.memory, newAllocation.offset);
+			if (result != VK_SUCCESS)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to bind replacement buffer memory (" + std::to_string(result) + ") - ending pass early\n");
+				vkDestroyBuffer(device.GetDevice(), newBuffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+				memoryHeap.Free(newAllocation);
+				break;
+			}
+
+			//Mark the move and take what's needed from the record up front - recording into the batch may reach back into the factory, so the reference isn't held past here
+			record.moving = true;
+			const VkBuffer oldBuffer{ record.buffer };
+			const VkDeviceSize size{ record.metadata.size };
+			const VkSharingMode sharingMode{ record.metadata.sharingMode };
+
+			//Copy the contents across, and only point the handle at the replacement once the copy has completed
+			//Frames submitted before the batch completes still read the original, so it's handed back to the graphics queue along with its replacement
+			RecordOwnershipTransfers(handle, _uploadBatch);
+			if (sharingMode == VK_SHARING_MODE_EXCLUSIVE)
+			{
+				_uploadBatch.ReleaseBuffer(newBuffer);
+			}
+			_uploadBatch.CopyBuffer(oldBuffer, newBuffer, size);
+			_uploadBatch.AddCompletionCallback([this, handle, oldBuffer, newBuffer, newAllocation]() { CompleteMove(handle, oldBuffer, newBuffer, newAllocation); });
+			bytesMoved += size;
+			++buffersMoved;
+		}
+	}
+
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Recorded " + std::to_string(buffersMoved) + " buffer move" + std::string(buffersMoved == 1 ? "" : "s") + " (" + GetFormattedSizeString(bytesMoved) + ")\n");
+	return bytesMoved;
+}
+
+
+
+std::unique_ptr<UploadBatch> BufferFactory::CreateUploadBatch()
+{
+	return std::make_unique<UploadBatch>(logger, deviceDebugAllocator, device, commandPool, transferCommandPool.get(), *this);
+}
+
+
+
+void BufferFactory::RecordOwnershipTransfers(BufferHandle _buffer, UploadBatch& _uploadBatch) const
+{
+	const BufferRecord& record{ GetRecord(_buffer) };
+	if (record.metadata.sharingMode == VK_SHARING_MODE_EXCLUSIVE)
+	{
+		_uploadBatch.AcquireBuffer(record.buffer);
+		_uploadBatch.ReleaseBuffer(record.buffer);
+	}
+}
+
+
+
+void BufferFactory::UploadToBuffer(BufferHandle _dstBuffer, const void* _data, VkDeviceSize _size, UploadBatch& _uploadBatch, VkDeviceSize _dstOffset)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Recording Upload Of " + GetFormattedSizeString(_size) + " To Buffer\n");
+	const BufferRecord& dst{ GetRecord(_dstBuffer) };
+	if ((dst.metadata.usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Destination buffer wasn't created with the TRANSFER_DST_BIT usage flag\n");
 		throw std::runtime_error("");
 	}
 
-	//For new buffer, remove TRANSFER_SRC_BIT usage flag and add TRANSFER_DST_BIT
-	VkBufferUsageFlags newUsageFlags{ (bufferMetadataMap[_buffer].usage & (~VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
-	VkBuffer dstBuffer{ AllocateBufferImpl(bufferMetadataMap[_buffer].size, newUsageFlags, bufferMetadataMap[_buffer].sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+	//(Copy the VkBuffer out - creating the staging ring on first use allocates a buffer, which may grow the slot map)
+	const VkBuffer dstBuffer{ dst.buffer };
+	StagingRing& ring{ GetStagingRing() };
+	const char* src{ static_cast<const char*>(_data) };
+	VkDeviceSize uploaded{ 0 };
+	while (uploaded < _size)
+	{
+		const VkDeviceSize chunkSize{ std::min(_size - uploaded, ring.GetMaxAllocationSize()) };
+		const StagingAllocation staging{ ring.Allocate(chunkSize, 4, _uploadBatch) };
+		memcpy(staging.mapped, src + uploaded, static_cast<std::size_t>(chunkSize));
+		RecordOwnershipTransfers(_dstBuffer, _uploadBatch); //(After allocating - the ring may have had to submit the batch, handing the buffer back to the graphics queue)
+		_uploadBatch.CopyBuffer(staging.buffer, dstBuffer, chunkSize, staging.offset, _dstOffset + uploaded);
+		uploaded += chunkSize;
+	}
+}
 
-	//Record command buffer for copy command
-	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? commandPool.AllocateCommandBuffer() : *_commandBuffer };
-	if (_commandBuffer == nullptr)
+
+
+StagingRing& BufferFactory::GetStagingRing()
+{
+	if (!stagingRing)
 	{
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		stagingRing = std::make_unique<StagingRing>(logger, *this);
 	}
+	return *stagingRing;
+}
 
-	VkBufferCopy region{};
-	region.size = bufferMetadataMap[_buffer].size;
-	region.srcOffset = 0;
-	region.dstOffset = 0;
-	vkCmdCopyBuffer(commandBuffer, _buffer, dstBuffer, 1, &region);
 
-	if (_commandBuffer == nullptr)
+
+bool BufferFactory::IsValid(BufferHandle _buffer) const
+{
+	return buffers.Contains(_buffer);
+}
+
+
+
+VkBuffer BufferFactory::GetBuffer(BufferHandle _buffer) const
+{
+	return GetRecord(_buffer).buffer;
+}
+
+
+
+const BufferMetadata& BufferFactory::GetMetadata(BufferHandle _buffer) const
+{
+	return GetRecord(_buffer).metadata;
+}
+
+
+
+const MemoryAllocation& BufferFactory::GetMemory(BufferHandle _buffer) const
+{
+	return GetRecord(_buffer).allocation;
+}
+
+
+
+void* BufferFactory::GetMappedPointer(BufferHandle _buffer) const
+{
+	const BufferRecord& record{ GetRecord(_buffer) };
+	if (record.importedPointer != nullptr)
+	{
+		return record.importedPointer;
+	}
+	void* mapped{ memoryHeap.GetMappedPointer(record.allocation) };
+	if (mapped == nullptr)
 	{
-		vkEndCommandBuffer(commandBuffer);
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Attempted to get mapped pointer of a buffer that isn't HOST_VISIBLE\n");
+		throw std::runtime_error("");
+	}
+	return mapped;
+}
 
-		//Execute the command buffer
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pNext = nullptr;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(device.GetGraphicsQueue());
-		commandPool.FreeCommandBuffer(commandBuffer);
+
+
+VkDeviceAddress BufferFactory::GetDeviceAddress(BufferHandle _buffer) const
+{
+	const BufferRecord& record{ GetRecord(_buffer) };
+	if (getBufferDeviceAddress == nullptr)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Attempted to get device address of a buffer, but buffer device addresses aren't enabled on this device\n");
+		throw std::runtime_error("");
+	}
+	if ((record.metadata.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Attempted to get device address of a buffer that wasn't created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT\n");
+		throw std::runtime_error("");
 	}
 
-	if (_freeSourceBuffer)
+	VkBufferDeviceAddressInfo addressInfo{};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.pNext = nullptr;
+	addressInfo.buffer = record.buffer;
+	return getBufferDeviceAddress(device.GetDevice(), &addressInfo);
+}
+
+
+
+MemoryStatistics BufferFactory::GetMemoryStatistics() const
+{
+	//Anything allocated from the heap that a live buffer doesn't occupy is padding
+	MemoryStatistics statistics{ memoryHeap.GetStatistics() };
+	VkDeviceSize usedBytes[VK_MAX_MEMORY_TYPES]{};
+	for (const BufferRecord& record : buffers)
 	{
-		FreeBuffer(_buffer);
+		if (record.importedPointer != nullptr) { continue; }
+		usedBytes[record.allocation.memoryTypeIndex] += record.metadata.size;
+	}
+	for (const RetiredBuffer& retired : retiredBuffers)
+	{
+		usedBytes[retired.allocation.memoryTypeIndex] += retired.allocation.size;
 	}
 
-	return dstBuffer;
+	statistics.total.paddingBytes = 0;
+	for (std::uint32_t i{ 0 }; i < statistics.memoryTypeCount; ++i)
+	{
+		MemoryTypeStatistics& typeStatistics{ statistics.memoryTypes[i] };
+		typeStatistics.paddingBytes = typeStatistics.allocationBytes - std::min(typeStatistics.allocationBytes, usedBytes[i]);
+		statistics.total.paddingBytes += typeStatistics.paddingBytes;
+	}
+	return statistics;
+}
+
+
+
+void BufferFactory::FlushBuffer(BufferHandle _buffer, VkDeviceSize _offset, VkDeviceSize _size) const
+{
+	const BufferRecord& record{ GetRecord(_buffer) };
+	if (record.importedPointer != nullptr) { return; } //Imported memory is always HOST_COHERENT
+	memoryHeap.Flush(record.allocation, _offset, _size == VK_WHOLE_SIZE ? record.metadata.size - _offset : _size);
 }
 
 
 
-VkDeviceMemory BufferFactory::GetMemory(VkBuffer _buffer)
+void BufferFactory::InvalidateBuffer(BufferHandle _buffer, VkDeviceSize _offset, VkDeviceSize _size) const
 {
-	return bufferMemoryMap[_buffer];
+	const BufferRecord& record{ GetRecord(_buffer) };
+	if (record.importedPointer != nullptr) { return; } //Imported memory is always HOST_COHERENT
+	memoryHeap.Invalidate(record.allocation, _offset, _size == VK_WHOLE_SIZE ? record.metadata.size - _offset : _size);
 }
 
 
 
-VkBuffer BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags)
+BufferHandle BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags, const VkMemoryPropertyFlags _preferredMemFlags)
 {
 	VkBuffer buffer;
 	
@@ -148,7 +654,7 @@ VkBuffer BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBu
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.pNext = nullptr;
 	bufferInfo.size = _size; //1 MiB
-	bufferInfo.usage = _usage;
+	bufferInfo.usage = _usage | MOVABLE_USAGE_FLAGS;
 	bufferInfo.sharingMode = _sharingMode;
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Creating buffer (size: " + GetFormattedSizeString(bufferInfo.size) + ")", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkResult result{ vkCreateBuffer(device.GetDevice(), &bufferInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &buffer) };
@@ -179,92 +685,447 @@ VkBuffer BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBu
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  - Allocated to memory-type-index in {" + allowedMemTypeIndicesStr + "}\n");
 
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  User-requested buffer memory requirements:\n");
-	std::string memTypePropFlagsString;
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) { memTypePropFlagsString += "DEVICE_LOCAL | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) { memTypePropFlagsString += "HOST_VISIBLE | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) { memTypePropFlagsString += "HOST_COHERENT | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) { memTypePropFlagsString += "HOST_CACHED | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) { memTypePropFlagsString += "LAZILY_ALLOCATED | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_PROTECTED_BIT) { memTypePropFlagsString += "PROTECTED | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD) { memTypePropFlagsString += "DEVICE_COHERENT_AMD | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD) { memTypePropFlagsString += "DEVICE_UNCACHED_AMD | "; }
-	if (_requiredMemFlags & VK_MEMORY_PROPERTY_RDMA_CAPABLE_BIT_NV) { memTypePropFlagsString += "RDMA_CAPABLE_NV | "; }
-	if (!memTypePropFlagsString.empty())
-	{
-		memTypePropFlagsString.resize(memTypePropFlagsString.length() - 3);
-	}
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  - Memory flag bits: " + std::string(memTypePropFlagsString.empty() ? "NONE" : memTypePropFlagsString) + "\n");
-
-	//Find a memory type that fits the requirements
-	std::uint32_t memTypeIndex{ UINT32_MAX };
-	VkPhysicalDeviceMemoryProperties physicalDeviceMemProps;
-	vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &physicalDeviceMemProps);
-	for (std::uint32_t i{ 0 }; i < physicalDeviceMemProps.memoryTypeCount; ++i)
-	{
-		//Check if this memory type is allowed for our buffer
-		if (!(memRequirements.memoryTypeBits & (1 << i))) { continue; }
-		if ((physicalDeviceMemProps.memoryTypes[i].propertyFlags & _requiredMemFlags) != _requiredMemFlags) { continue; }
-		
-		//This memory type is allowed
-		memTypeIndex = i;
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Found compatible memory type at index " + std::to_string(i) + "\n");
-		break;
-	}
-	if (memTypeIndex == UINT32_MAX)
-	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  No available memory types were found\n");
-		throw std::runtime_error("");
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  - Required memory flag bits: " + GetMemoryPropertyFlagsString(_requiredMemFlags) + "\n");
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  - Preferred memory flag bits: " + GetMemoryPropertyFlagsString(_preferredMemFlags) + "\n");
+
+	//Sub-allocate memory for the buffer from the best memory type that fits the requirements (falling back to the next best if its heap is exhausted)
+	MemoryAllocation allocation{};
+	try
+	{
+		allocation = memoryHeap.AllocateByFlags(memRequirements, _requiredMemFlags, _preferredMemFlags);
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		throw;
 	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Allocated from memory type at index " + std::to_string(allocation.memoryTypeIndex) + " (" + GetMemoryPropertyFlagsString(memoryHeap.GetMemoryProperties().memoryTypes[allocation.memoryTypeIndex].propertyFlags) + ")\n");
 
-	//Allocate memory for the buffer
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext = nullptr;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = memTypeIndex;
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Allocating buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	result = vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &bufferMemoryMap[buffer]);
+	//Bind the allocated memory region to the buffer
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Binding buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	result = vkBindBufferMemory(device.GetDevice(), buffer, allocation.memory, allocation.offset);
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
 	if (result != VK_SUCCESS)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		memoryHeap.Free(allocation);
 		throw std::runtime_error("");
 	}
 
-	//Bind the allocated memory region to the buffer
+	//Populate the buffer's record
+	BufferRecord record{};
+	record.buffer = buffer;
+	record.allocation = allocation;
+	record.metadata.size = _size;
+	record.metadata.usage = _usage;
+	record.metadata.sharingMode = _sharingMode;
+	record.metadata.flags = _requiredMemFlags;
+	record.packIndex = UINT32_MAX;
+	record.moving = false;
+	record.importedPointer = nullptr;
+	
+	return buffers.Insert(record);
+}
+
+
+
+std::vector<BufferHandle> BufferFactory::AllocateBuffersPacked(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, const VkMemoryPropertyFlags* _requiredMemFlags, const VkMemoryPropertyFlags* _preferredMemFlags)
+{
+	//Create every buffer up front so that all of their memory requirements are known before anything is allocated
+	std::vector<VkBuffer> vkBuffers(_count, VK_NULL_HANDLE);
+	std::vector<VkMemoryRequirements> memRequirements(_count);
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = _sizes[i];
+		bufferInfo.usage = _usages[i] | MOVABLE_USAGE_FLAGS;
+		bufferInfo.sharingMode = _sharingModes ? _sharingModes[i] : VK_SHARING_MODE_EXCLUSIVE;
+		const VkResult result{ vkCreateBuffer(device.GetDevice(), &bufferInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &vkBuffers[i]) };
+		if (result != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to create buffer " + std::to_string(i) + " (size: " + GetFormattedSizeString(_sizes[i]) + ") (" + std::to_string(result) + ")\n");
+			for (std::uint32_t j{ 0 }; j < i; ++j)
+			{
+				vkDestroyBuffer(device.GetDevice(), vkBuffers[j], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+			}
+			throw std::runtime_error("");
+		}
+		vkGetBufferMemoryRequirements(device.GetDevice(), vkBuffers[i], &memRequirements[i]);
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Created " + std::to_string(_count) + " buffers\n");
+
+	//Group the buffers by the memory type that best suits each of them
+	MemoryTypeSelector& memoryTypeSelector{ device.GetMemoryTypeSelector() };
+	std::vector<std::uint32_t> memTypeIndices(_count);
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		memTypeIndices[i] = memoryTypeSelector.SelectMemoryType(memRequirements[i].memoryTypeBits, _requiredMemFlags ? _requiredMemFlags[i] : 0, _preferredMemFlags ? _preferredMemFlags[i] : 0, memRequirements[i].size);
+		if (memTypeIndices[i] == UINT32_MAX)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  No available memory types were found for buffer " + std::to_string(i) + " (required: " + GetMemoryPropertyFlagsString(_requiredMemFlags ? _requiredMemFlags[i] : 0) + ")\n");
+			for (const VkBuffer buffer : vkBuffers)
+			{
+				vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+			}
+			throw std::runtime_error("");
+		}
+	}
+
+	//Lay out each group back to back and give it a single region of memory
+	//Buffers are padded out to whole non-coherent atoms so that flushing or invalidating one of them can never touch its neighbours
+	const VkDeviceSize atomSize{ memoryHeap.GetNonCoherentAtomSize() };
+	std::vector<VkDeviceSize> packOffsets(_count);
+	std::vector<std::uint32_t> packIndices(_count);
+	std::vector<bool> packed(_count, false);
+	std::vector<std::uint32_t> createdPackIndices;
+	for (std::uint32_t first{ 0 }; first < _count; ++first)
+	{
+		if (packed[first]) { continue; }
+
+		VkMemoryRequirements packRequirements{};
+		packRequirements.memoryTypeBits = ~0u;
+		VkMemoryPropertyFlags packRequiredFlags{ 0 };
+		VkMemoryPropertyFlags packPreferredFlags{ 0 };
+		std::uint32_t packBufferCount{ 0 };
+		for (std::uint32_t i{ first }; i < _count; ++i)
+		{
+			if (packed[i] || memTypeIndices[i] != memTypeIndices[first]) { continue; }
+			const VkDeviceSize alignment{ std::max(memRequirements[i].alignment, atomSize) };
+			packOffsets[i] = ((packRequirements.size + alignment - 1) / alignment) * alignment;
+			packRequirements.size = packOffsets[i] + ((memRequirements[i].size + atomSize - 1) / atomSize) * atomSize;
+			packRequirements.alignment = std::max(packRequirements.alignment, alignment);
+			packRequirements.memoryTypeBits &= memRequirements[i].memoryTypeBits;
+			packRequiredFlags |= _requiredMemFlags ? _requiredMemFlags[i] : 0;
+			packPreferredFlags |= _preferredMemFlags ? _preferredMemFlags[i] : 0;
+			++packBufferCount;
+		}
+
+		//If the heap is out of memory (or over budget), release everything this call has created so far before passing the error on
+		BufferPack pack{};
+		try
+		{
+			pack.allocation = memoryHeap.AllocateByFlags(packRequirements, packRequiredFlags, packPreferredFlags);
+		}
+		catch (...)
+		{
+			for (const std::uint32_t createdPackIndex : createdPackIndices)
+			{
+				memoryHeap.Free(packs[createdPackIndex].allocation);
+				packs[createdPackIndex] = {};
+				freePackIndices.push_back(createdPackIndex);
+			}
+			for (const VkBuffer buffer : vkBuffers)
+			{
+				vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+			}
+			throw;
+		}
+		pack.liveBuffers = packBufferCount;
+		std::uint32_t packIndex;
+		if (freePackIndices.empty())
+		{
+			packIndex = static_cast<std::uint32_t>(packs.size());
+			packs.push_back(pack);
+		}
+		else
+		{
+			packIndex = freePackIndices.back();
+			freePackIndices.pop_back();
+			packs[packIndex] = pack;
+		}
+		createdPackIndices.push_back(packIndex);
+		for (std::uint32_t i{ first }; i < _count; ++i)
+		{
+			if (packed[i] || memTypeIndices[i] != memTypeIndices[first]) { continue; }
+			packIndices[i] = packIndex;
+			packed[i] = true;
+		}
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Packed " + std::to_string(packBufferCount) + " buffer" + std::string(packBufferCount == 1 ? "" : "s") + " into " + GetFormattedSizeString(packRequirements.size) + " (memory type " + std::to_string(pack.allocation.memoryTypeIndex) + ")\n");
+	}
+
+	//Bind every buffer to its slice of its pack in one go
+	std::vector<VkBindBufferMemoryInfo> bindInfos(_count);
+	std::vector<BufferHandle> handles;
+	handles.reserve(_count);
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		BufferRecord record{};
+		record.buffer = vkBuffers[i];
+		record.allocation = packs[packIndices[i]].allocation;
+		record.allocation.offset += packOffsets[i];
+		record.allocation.size = memRequirements[i].size;
+		record.metadata.size = _sizes[i];
+		record.metadata.usage = _usages[i];
+		record.metadata.sharingMode = _sharingModes ? _sharingModes[i] : VK_SHARING_MODE_EXCLUSIVE;
+		record.metadata.flags = _requiredMemFlags ? _requiredMemFlags[i] : 0;
+		record.packIndex = packIndices[i];
+		record.moving = false;
+		record.importedPointer = nullptr;
+
+		bindInfos[i].sType = VK_STRUCTURE_TYPE_BIND_BUFFER_MEMORY_INFO;
+		bindInfos[i].pNext = nullptr;
+		bindInfos[i].buffer = record.buffer;
+		bindInfos[i].memory = record.allocation.memory;
+		bindInfos[i].memoryOffset = record.allocation.offset;
+
+		handles.push_back(buffers.Insert(record));
+	}
+
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Binding buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	result = vkBindBufferMemory(device.GetDevice(), buffer, bufferMemoryMap[buffer], 0);
+	VkResult result{ VK_SUCCESS };
+	if (bindBufferMemory2 != nullptr)
+	{
+		result = bindBufferMemory2(device.GetDevice(), _count, bindInfos.data());
+	}
+	else
+	{
+		for (std::uint32_t i{ 0 }; i < _count && result == VK_SUCCESS; ++i)
+		{
+			result = vkBindBufferMemory(device.GetDevice(), bindInfos[i].buffer, bindInfos[i].memory, bindInfos[i].memoryOffset);
+		}
+	}
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
 	if (result != VK_SUCCESS)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		for (BufferHandle& handle : handles)
+		{
+			FreeBufferImpl(handle);
+		}
 		throw std::runtime_error("");
 	}
 
-	//Populate buffer-metadata entry
-	bufferMetadataMap[buffer].size = _size;
-	bufferMetadataMap[buffer].usage = _usage;
-	bufferMetadataMap[buffer].sharingMode = _sharingMode;
-	bufferMetadataMap[buffer].flags = _requiredMemFlags;
-	
-	return buffer;
+	return handles;
+}
+
+
+
+BufferHandle BufferFactory::TransferToDeviceLocalBufferImpl(BufferHandle _buffer, bool& _out_copied)
+{
+	const BufferRecord& src{ GetRecord(_buffer) };
+	const BufferMetadata& srcMetadata{ src.metadata };
+	if ((srcMetadata.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Source buffer wasn't created with the TRANSFER_SRC_BIT usage flag\n");
+		throw std::runtime_error("");
+	}
+	if ((srcMetadata.flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Source buffer wasn't created with the HOST_VISIBLE memory property flag\n");
+		throw std::runtime_error("");
+	}
+
+	//For new buffer, remove TRANSFER_SRC_BIT usage flag and add TRANSFER_DST_BIT
+	//(Copy the record out - allocating the new buffer may grow the slot map and invalidate references into it)
+	const VkDeviceSize size{ srcMetadata.size };
+	const VkBufferUsageFlags newUsageFlags{ (srcMetadata.usage & (~VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+	const VkSharingMode sharingMode{ srcMetadata.sharingMode };
+	const BufferHandle dstBuffer{ AllocateBufferImpl(size, newUsageFlags, sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, directWriteAvailable ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : 0) };
+
+	//If the new buffer landed in host-visible memory, copy on the host rather than recording a copy command
+	_out_copied = false;
+	if (void* dstMapped{ memoryHeap.GetMappedPointer(GetRecord(dstBuffer).allocation) })
+	{
+		//Read the source through its handle - imported buffers aren't backed by one of the heap's blocks, so their allocation can't be mapped
+		memcpy(dstMapped, GetMappedPointer(_buffer), static_cast<std::size_t>(size));
+		FlushBuffer(dstBuffer);
+		_out_copied = true;
+	}
+
+	return dstBuffer;
+}
+
+
+
+bool BufferFactory::DetectDirectWrite() const
+{
+	//Discrete GPUs without resizable BAR still expose a small (typically 256MiB) DEVICE_LOCAL | HOST_VISIBLE window - that's too small to put every static buffer in
+	//Only write directly if the largest device-local heap itself is host-visible (resizable BAR, UMA, and software implementations)
+	const VkPhysicalDeviceMemoryProperties& memoryProperties{ memoryHeap.GetMemoryProperties() };
+	std::uint32_t largestHeapIndex{ UINT32_MAX };
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		if (!(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) { continue; }
+		if (largestHeapIndex == UINT32_MAX || memoryProperties.memoryHeaps[i].size > memoryProperties.memoryHeaps[largestHeapIndex].size)
+		{
+			largestHeapIndex = i;
+		}
+	}
+
+	constexpr VkMemoryPropertyFlags directWriteFlags{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT };
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		if (memoryProperties.memoryTypes[i].heapIndex == largestHeapIndex && (memoryProperties.memoryTypes[i].propertyFlags & directWriteFlags) == directWriteFlags)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+void BufferFactory::CompleteMove(BufferHandle _buffer, VkBuffer _oldBuffer, VkBuffer _newBuffer, const MemoryAllocation& _newAllocation)
+{
+	ReleaseRetiredBuffers(false);
+
+	if (BufferRecord* record{ buffers.Get(_buffer) })
+	{
+		//Work submitted before now may still reference the old buffer, so it's retired rather than destroyed
+		RetireBuffer(record->buffer, record->allocation);
+		record->buffer = _newBuffer;
+		record->allocation = _newAllocation;
+		record->moving = false;
+		return;
+	}
+
+	//The buffer was freed mid-move - nothing else can be referencing its replacement, and the original is released now as FreeBuffer() would have done
+	vkDestroyBuffer(device.GetDevice(), _newBuffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	memoryHeap.Free(_newAllocation);
+	for (std::vector<RetiredBuffer>::iterator it{ retiredBuffers.begin() }; it != retiredBuffers.end(); ++it)
+	{
+		if (it->buffer == _oldBuffer && it->fence == VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device.GetDevice(), it->buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+			memoryHeap.Free(it->allocation);
+			retiredBuffers.erase(it);
+			break;
+		}
+	}
+}
+
+
+
+void BufferFactory::RetireBuffer(VkBuffer _buffer, const MemoryAllocation& _allocation)
+{
+	//An empty submission's fence is signalled once everything submitted to the queue before it has completed
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.pNext = nullptr;
+	fenceInfo.flags = 0;
+	VkFence fence{ VK_NULL_HANDLE };
+	VkResult result{ vkCreateFence(device.GetDevice(), &fenceInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &fence) };
+	if (result == VK_SUCCESS)
+	{
+		result = vkQueueSubmit(device.GetGraphicsQueue(), 0, nullptr, fence);
+		if (result == VK_SUCCESS)
+		{
+			retiredBuffers.push_back({ _buffer, _allocation, fence });
+			return;
+		}
+		vkDestroyFence(device.GetDevice(), fence, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	}
+
+	//Couldn't fence the queue - wait for it instead
+	logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to fence retired buffer (" + std::to_string(result) + ") - waiting for the graphics queue to idle\n");
+	vkQueueWaitIdle(device.GetGraphicsQueue());
+	vkDestroyBuffer(device.GetDevice(), _buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	memoryHeap.Free(_allocation);
+}
+
+
+
+void BufferFactory::ReleaseRetiredBuffers(bool _wait)
+{
+	for (std::vector<RetiredBuffer>::iterator it{ retiredBuffers.begin() }; it != retiredBuffers.end();)
+	{
+		//Buffers without a fence are released when the move copying out of them completes
+		if (it->fence == VK_NULL_HANDLE)
+		{
+			++it;
+			continue;
+		}
+		if (_wait)
+		{
+			vkWaitForFences(device.GetDevice(), 1, &it->fence, VK_TRUE, UINT64_MAX);
+		}
+		else if (vkGetFenceStatus(device.GetDevice(), it->fence) != VK_SUCCESS)
+		{
+			++it;
+			continue;
+		}
+		vkDestroyFence(device.GetDevice(), it->fence, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		vkDestroyBuffer(device.GetDevice(), it->buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		memoryHeap.Free(it->allocation);
+		it = retiredBuffers.erase(it);
+	}
 }
 
 
 
-void BufferFactory::FreeBufferImpl(VkBuffer& _buffer)
+void BufferFactory::FreeBufferImpl(BufferHandle& _buffer)
 {
-	bufferMetadataMap.erase(_buffer);
-	if (bufferMemoryMap[_buffer] != VK_NULL_HANDLE)
+	if (const BufferRecord* record{ buffers.Get(_buffer) })
 	{
-		vkFreeMemory(device.GetDevice(), bufferMemoryMap[_buffer], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		if (record->moving)
+		{
+			//A defragmentation pass may still be copying from the buffer - it's released once the move completes instead
+			retiredBuffers.push_back({ record->buffer, record->allocation, VK_NULL_HANDLE });
+			buffers.Erase(_buffer);
+			_buffer = {};
+			return;
+		}
+
+		vkDestroyBuffer(device.GetDevice(), record->buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		if (record->importedPointer != nullptr)
+		{
+			//Imported memory belongs to the buffer alone - the host allocation itself is still owned by the user
+			vkFreeMemory(device.GetDevice(), record->allocation.memory, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		}
+		else if (record->packIndex == UINT32_MAX)
+		{
+			memoryHeap.Free(record->allocation);
+		}
+		else if (--packs[record->packIndex].liveBuffers == 0)
+		{
+			//Last buffer in the pack - the pack's region can now be returned to the heap
+			memoryHeap.Free(packs[record->packIndex].allocation);
+			freePackIndices.push_back(record->packIndex);
+		}
+		buffers.Erase(_buffer);
+	}
+	else if (!_buffer.IsNull())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Attempted to free a stale buffer handle (the buffer has already been freed)\n");
+	}
+	_buffer = {};
+}
+
+
+
+const BufferFactory::BufferRecord& BufferFactory::GetRecord(BufferHandle _buffer) const
+{
+	const BufferRecord* record{ buffers.Get(_buffer) };
+	if (record == nullptr)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, _buffer.IsNull() ? "  Attempted to use a null buffer handle\n" : "  Attempted to use a stale buffer handle (the buffer has been freed)\n");
+		throw std::runtime_error("");
 	}
-	bufferMemoryMap.erase(_buffer);
-	if (_buffer != VK_NULL_HANDLE)
+	return *record;
+}
+
+
+
+std::string BufferFactory::GetMemoryPropertyFlagsString(VkMemoryPropertyFlags _flags)
+{
+	std::string flagsString;
+	if (_flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) { flagsString += "DEVICE_LOCAL | "; }
+	if (_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) { flagsString += "HOST_VISIBLE | "; }
+	if (_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) { flagsString += "HOST_COHERENT | "; }
+	if (_flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) { flagsString += "HOST_CACHED | "; }
+	if (_flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) { flagsString += "LAZILY_ALLOCATED | "; }
+	if (_flags & VK_MEMORY_PROPERTY_PROTECTED_BIT) { flagsString += "PROTECTED | "; }
+	if (_flags & VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD) { flagsString += "DEVICE_COHERENT_AMD | "; }
+	if (_flags & VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD) { flagsString += "DEVICE_UNCACHED_AMD | "; }
+	if (_flags & VK_MEMORY_PROPERTY_RDMA_CAPABLE_BIT_NV) { flagsString += "RDMA_CAPABLE_NV | "; }
+	if (flagsString.empty())
 	{
-		vkDestroyBuffer(device.GetDevice(), _buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		return "NONE";
 	}
-	_buffer = VK_NULL_HANDLE;
+	flagsString.resize(flagsString.length() - 3);
+	return flagsString;
 }
 
 
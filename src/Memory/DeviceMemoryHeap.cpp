@@ -0,0 +1,480 @@
+#include "NekiVK/Memory/DeviceMemoryHeap.h"
+#include "NekiVK/Utils/Strings/format.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+DeviceMemoryHeap::DeviceMemoryHeap(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VK_LOGGER_LAYER _layer, VkDeviceSize _preferredBlockSize)
+								  : logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), layer(_layer), preferredBlockSize(_preferredBlockSize)
+{
+	memoryProperties = device.GetMemoryTypeSelector().GetMemoryProperties();
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device.GetPhysicalDevice(), &deviceProperties);
+	nonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
+
+	statistics = {};
+	statistics.memoryTypeCount = memoryProperties.memoryTypeCount;
+}
+
+
+
+DeviceMemoryHeap::~DeviceMemoryHeap()
+{
+	std::size_t numBlocks{ 0 };
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		for (std::uint32_t j{ 0 }; j < blocks[i].size(); ++j)
+		{
+			if (blocks[i][j].memory == VK_NULL_HANDLE) { continue; }
+			//Dedicated blocks are released with their allocation, so any that remain are still live
+			const std::uint32_t liveAllocations{ blocks[i][j].dedicated ? 1 : blocks[i][j].allocator->GetAllocationCount() };
+			if (liveAllocations != 0)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::WARNING, layer, "  Memory block " + std::to_string(j) + " of memory type " + std::to_string(i) + " still has " + std::to_string(liveAllocations) + " live allocation(s)\n");
+			}
+			FreeBlock(i, j);
+			++numBlocks;
+		}
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, layer, "  " + std::to_string(numBlocks) + " device memory block" + std::string(numBlocks == 1 ? "" : "s") + " freed\n");
+}
+
+
+
+MemoryAllocation DeviceMemoryHeap::Allocate(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, bool _dedicated)
+{
+	MemoryAllocation allocation{};
+	if (!TryAllocate(_requirements, _memoryTypeIndex, _dedicated, allocation))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, "  Memory type " + std::to_string(_memoryTypeIndex) + " is out of memory\n");
+		throw std::runtime_error("");
+	}
+	return allocation;
+}
+
+
+
+MemoryAllocation DeviceMemoryHeap::AllocateByFlags(const VkMemoryRequirements& _requirements, VkMemoryPropertyFlags _requiredFlags, VkMemoryPropertyFlags _preferredFlags, bool _dedicated)
+{
+	MemoryTypeSelector& selector{ device.GetMemoryTypeSelector() };
+	std::uint32_t memoryTypeBits{ _requirements.memoryTypeBits };
+	while (true)
+	{
+		const std::uint32_t memoryTypeIndex{ selector.SelectMemoryType(memoryTypeBits, _requiredFlags, _preferredFlags, _requirements.size) };
+		if (memoryTypeIndex == UINT32_MAX)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, "  No compatible memory types have room for " + GetFormattedSizeString(_requirements.size) + "\n");
+			throw std::runtime_error("");
+		}
+
+		MemoryAllocation allocation{};
+		if (TryAllocate(_requirements, memoryTypeIndex, _dedicated, allocation))
+		{
+			return allocation;
+		}
+
+		//The memory type's heap is exhausted - exclude it and fall back to the next best memory type
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, layer, "  Memory type " + std::to_string(memoryTypeIndex) + " is out of memory - falling back to the next best memory type\n");
+		memoryTypeBits &= ~(1u << memoryTypeIndex);
+	}
+}
+
+
+
+bool DeviceMemoryHeap::TryAllocate(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, bool _dedicated, MemoryAllocation& _out_allocation)
+{
+	const VkMemoryRequirements requirements{ GetPaddedRequirements(_requirements, _memoryTypeIndex) };
+
+	MemoryAllocation allocation{};
+	allocation.memoryTypeIndex = _memoryTypeIndex;
+	allocation.size = requirements.size;
+
+	const VkDeviceSize blockSize{ GetBlockSize(_memoryTypeIndex) };
+	TLSFAllocation subAllocation{};
+
+	//Large requests get their own block - placing them in a shared block would mostly just fragment it
+	if (_dedicated || requirements.size > blockSize / 2)
+	{
+		allocation.blockIndex = CreateBlock(_memoryTypeIndex, requirements.size, true);
+		if (allocation.blockIndex == UINT32_MAX)
+		{
+			return false;
+		}
+		subAllocation = { 0, TLSFAllocator::INVALID_NODE }; //The allocation is the whole block
+	}
+	else
+	{
+		//Try to fit the request into an existing block
+		allocation.blockIndex = UINT32_MAX;
+		for (std::uint32_t i{ 0 }; i < blocks[_memoryTypeIndex].size(); ++i)
+		{
+			MemoryBlock& block{ blocks[_memoryTypeIndex][i] };
+			if (block.memory == VK_NULL_HANDLE || block.dedicated) { continue; }
+			if (block.allocator->Allocate(requirements.size, requirements.alignment, subAllocation))
+			{
+				allocation.blockIndex = i;
+				break;
+			}
+		}
+
+		//No existing block has room, allocate a new one
+		if (allocation.blockIndex == UINT32_MAX)
+		{
+			allocation.blockIndex = CreateBlock(_memoryTypeIndex, blockSize, false);
+			if (allocation.blockIndex == UINT32_MAX)
+			{
+				//The heap can't fit a whole new block, but it may still fit just this request
+				allocation.blockIndex = CreateBlock(_memoryTypeIndex, requirements.size, true);
+				if (allocation.blockIndex == UINT32_MAX)
+				{
+					return false;
+				}
+				subAllocation = { 0, TLSFAllocator::INVALID_NODE };
+			}
+			else if (!blocks[_memoryTypeIndex][allocation.blockIndex].allocator->Allocate(requirements.size, requirements.alignment, subAllocation))
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, "  Failed to sub-allocate " + GetFormattedSizeString(requirements.size) + " from a fresh memory block\n");
+				throw std::runtime_error("");
+			}
+		}
+	}
+
+	allocation.memory = blocks[_memoryTypeIndex][allocation.blockIndex].memory;
+	allocation.offset = subAllocation.offset;
+	allocation.node = subAllocation.node;
+	RecordAllocation(statistics, _memoryTypeIndex, allocation.size);
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, layer, "  Sub-allocated " + GetFormattedSizeString(allocation.size) + " at offset " + std::to_string(allocation.offset) + " (memory type " + std::to_string(_memoryTypeIndex) + ", block " + std::to_string(allocation.blockIndex) + ")\n");
+
+	_out_allocation = allocation;
+	return true;
+}
+
+
+
+std::uint32_t DeviceMemoryHeap::GetSparsestBlock(std::uint32_t _memoryTypeIndex) const
+{
+	//Empty blocks are never evacuated (there's nothing to move) or moved into (that would just swap one block for another)
+	std::uint32_t sparsestBlockIndex{ UINT32_MAX };
+	std::uint32_t nonEmptyBlockCount{ 0 };
+	VkDeviceSize totalFreeSize{ 0 };
+	for (std::uint32_t i{ 0 }; i < blocks[_memoryTypeIndex].size(); ++i)
+	{
+		const MemoryBlock& block{ blocks[_memoryTypeIndex][i] };
+		if (block.memory == VK_NULL_HANDLE || block.dedicated || block.allocator->IsEmpty()) { continue; }
+		++nonEmptyBlockCount;
+		totalFreeSize += block.size - block.allocator->GetUsedSize();
+		if (sparsestBlockIndex == UINT32_MAX || block.allocator->GetUsedSize() < blocks[_memoryTypeIndex][sparsestBlockIndex].allocator->GetUsedSize())
+		{
+			sparsestBlockIndex = i;
+		}
+	}
+	if (nonEmptyBlockCount < 2)
+	{
+		return UINT32_MAX;
+	}
+
+	//Only worth starting on the block if everything in it can go somewhere else
+	const MemoryBlock& sparsestBlock{ blocks[_memoryTypeIndex][sparsestBlockIndex] };
+	const VkDeviceSize freeSizeElsewhere{ totalFreeSize - (sparsestBlock.size - sparsestBlock.allocator->GetUsedSize()) };
+	return sparsestBlock.allocator->GetUsedSize() <= freeSizeElsewhere ? sparsestBlockIndex : UINT32_MAX;
+}
+
+
+
+bool DeviceMemoryHeap::AllocateForMove(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, std::uint32_t _excludedBlockIndex, MemoryAllocation& _out_allocation)
+{
+	const VkMemoryRequirements requirements{ GetPaddedRequirements(_requirements, _memoryTypeIndex) };
+	for (std::uint32_t i{ 0 }; i < blocks[_memoryTypeIndex].size(); ++i)
+	{
+		MemoryBlock& block{ blocks[_memoryTypeIndex][i] };
+		if (i == _excludedBlockIndex || block.memory == VK_NULL_HANDLE || block.dedicated || block.allocator->IsEmpty()) { continue; }
+
+		TLSFAllocation subAllocation{};
+		if (block.allocator->Allocate(requirements.size, requirements.alignment, subAllocation))
+		{
+			_out_allocation.memory = block.memory;
+			_out_allocation.offset = subAllocation.offset;
+			_out_allocation.size = requirements.size;
+			_out_allocation.memoryTypeIndex = _memoryTypeIndex;
+			_out_allocation.blockIndex = i;
+			_out_allocation.node = subAllocation.node;
+			RecordAllocation(statistics, _memoryTypeIndex, requirements.size);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+void DeviceMemoryHeap::Free(const MemoryAllocation& _allocation)
+{
+	if (_allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	MemoryBlock& block{ blocks[_allocation.memoryTypeIndex][_allocation.blockIndex] };
+	RecordFree(statistics, _allocation.memoryTypeIndex, _allocation.size);
+
+	//Dedicated blocks hold exactly one allocation, so they're always released with it
+	if (block.dedicated)
+	{
+		FreeBlock(_allocation.memoryTypeIndex, _allocation.blockIndex);
+		return;
+	}
+
+	block.allocator->Free(_allocation.node);
+	if (!block.allocator->IsEmpty())
+	{
+		return;
+	}
+
+	//Shared blocks are only released if there's another shared block of this memory type to fall back on
+	bool releaseBlock{ false };
+	for (std::uint32_t i{ 0 }; i < blocks[_allocation.memoryTypeIndex].size(); ++i)
+	{
+		const MemoryBlock& other{ blocks[_allocation.memoryTypeIndex][i] };
+		if (i != _allocation.blockIndex && other.memory != VK_NULL_HANDLE && !other.dedicated)
+		{
+			releaseBlock = true;
+			break;
+		}
+	}
+	if (releaseBlock)
+	{
+		FreeBlock(_allocation.memoryTypeIndex, _allocation.blockIndex);
+	}
+}
+
+
+
+void* DeviceMemoryHeap::GetMappedPointer(const MemoryAllocation& _allocation) const
+{
+	const MemoryBlock& block{ blocks[_allocation.memoryTypeIndex][_allocation.blockIndex] };
+	if (block.mapped == nullptr)
+	{
+		return nullptr;
+	}
+	return static_cast<char*>(block.mapped) + _allocation.offset;
+}
+
+
+
+void DeviceMemoryHeap::Flush(const MemoryAllocation& _allocation, VkDeviceSize _offset, VkDeviceSize _size) const
+{
+	if (!IsNonCoherent(_allocation.memoryTypeIndex))
+	{
+		return;
+	}
+	const VkMappedMemoryRange range{ GetMappedRange(_allocation, _offset, _size) };
+	const VkResult result{ vkFlushMappedMemoryRanges(device.GetDevice(), 1, &range) };
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, "  Failed to flush mapped memory range (" + std::to_string(result) + ")\n");
+		throw std::runtime_error("");
+	}
+}
+
+
+
+void DeviceMemoryHeap::Invalidate(const MemoryAllocation& _allocation, VkDeviceSize _offset, VkDeviceSize _size) const
+{
+	if (!IsNonCoherent(_allocation.memoryTypeIndex))
+	{
+		return;
+	}
+	const VkMappedMemoryRange range{ GetMappedRange(_allocation, _offset, _size) };
+	const VkResult result{ vkInvalidateMappedMemoryRanges(device.GetDevice(), 1, &range) };
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, "  Failed to invalidate mapped memory range (" + std::to_string(result) + ")\n");
+		throw std::runtime_error("");
+	}
+}
+
+
+
+const VkPhysicalDeviceMemoryProperties& DeviceMemoryHeap::GetMemoryProperties() const
+{
+	return memoryProperties;
+}
+
+
+
+VkDeviceSize DeviceMemoryHeap::GetNonCoherentAtomSize() const
+{
+	return nonCoherentAtomSize;
+}
+
+
+
+MemoryStatistics DeviceMemoryHeap::GetStatistics() const
+{
+	MemoryStatistics result{ statistics };
+	VkDeviceSize totalFreeBytes{ 0 };
+	VkDeviceSize totalLargestFreeBytes{ 0 };
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		//Fragmentation is the fraction of free space that isn't in its block's largest free region - i.e.: how much of it can't be used by the largest allocation that fits
+		MemoryTypeStatistics& typeStatistics{ result.memoryTypes[i] };
+		VkDeviceSize freeBytes{ 0 };
+		VkDeviceSize largestFreeBytes{ 0 };
+		for (const MemoryBlock& block : blocks[i])
+		{
+			if (block.memory == VK_NULL_HANDLE) { continue; }
+			typeStatistics.largestBlock = std::max(typeStatistics.largestBlock, block.size);
+			if (block.dedicated) { continue; }
+			const VkDeviceSize largestFreeRegion{ block.allocator->GetLargestFreeRegion() };
+			typeStatistics.largestFreeRegion = std::max(typeStatistics.largestFreeRegion, largestFreeRegion);
+			freeBytes += block.size - block.allocator->GetUsedSize();
+			largestFreeBytes += largestFreeRegion;
+		}
+		typeStatistics.fragmentation = freeBytes == 0 ? 0.0f : 1.0f - static_cast<float>(largestFreeBytes) / static_cast<float>(freeBytes);
+
+		result.total.largestBlock = std::max(result.total.largestBlock, typeStatistics.largestBlock);
+		result.total.largestFreeRegion = std::max(result.total.largestFreeRegion, typeStatistics.largestFreeRegion);
+		totalFreeBytes += freeBytes;
+		totalLargestFreeBytes += largestFreeBytes;
+	}
+	result.total.fragmentation = totalFreeBytes == 0 ? 0.0f : 1.0f - static_cast<float>(totalLargestFreeBytes) / static_cast<float>(totalFreeBytes);
+	return result;
+}
+
+
+
+std::uint32_t DeviceMemoryHeap::CreateBlock(std::uint32_t _memoryTypeIndex, VkDeviceSize _size, bool _dedicated)
+{
+	//Any buffer bound to the block might want its device address taken, and VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT has no cost for those that don't
+	VkMemoryAllocateFlagsInfo allocFlagsInfo{};
+	allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	allocFlagsInfo.pNext = nullptr;
+	allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+	allocFlagsInfo.deviceMask = 0;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = device.IsBufferDeviceAddressEnabled() ? &allocFlagsInfo : nullptr;
+	allocInfo.allocationSize = _size;
+	allocInfo.memoryTypeIndex = _memoryTypeIndex;
+	VkDeviceMemory memory;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, layer, "  Allocating " + std::string(_dedicated ? "dedicated" : "shared") + " memory block (" + GetFormattedSizeString(_size) + ", memory type " + std::to_string(_memoryTypeIndex) + ")", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	const VkResult result{ vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &memory) };
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, layer, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+		{
+			return UINT32_MAX;
+		}
+		throw std::runtime_error("");
+	}
+	device.GetMemoryTypeSelector().NotifyAllocation(_memoryTypeIndex, _size);
+	RecordBlockAllocation(statistics, _memoryTypeIndex, _size);
+
+	//Reuse a released slot if there is one so that existing block indices remain stable
+	std::vector<MemoryBlock>& typeBlocks{ blocks[_memoryTypeIndex] };
+	std::uint32_t index{ 0 };
+	while (index < typeBlocks.size() && typeBlocks[index].memory != VK_NULL_HANDLE) { ++index; }
+	if (index == typeBlocks.size()) { typeBlocks.emplace_back(); }
+
+	typeBlocks[index].memory = memory;
+	typeBlocks[index].allocator = _dedicated ? nullptr : std::make_unique<TLSFAllocator>(_size);
+	typeBlocks[index].size = _size;
+	typeBlocks[index].dedicated = _dedicated;
+	typeBlocks[index].mapped = nullptr;
+
+	//Persistently map HOST_VISIBLE blocks - every allocation within the block shares the one mapping
+	if (memoryProperties.memoryTypes[_memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		const VkResult mapResult{ vkMapMemory(device.GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, &typeBlocks[index].mapped) };
+		if (mapResult != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, layer, "  Failed to map memory block " + std::to_string(index) + " of memory type " + std::to_string(_memoryTypeIndex) + " (" + std::to_string(mapResult) + ")\n");
+			FreeBlock(_memoryTypeIndex, index);
+			throw std::runtime_error("");
+		}
+	}
+
+	return index;
+}
+
+
+
+void DeviceMemoryHeap::FreeBlock(std::uint32_t _memoryTypeIndex, std::uint32_t _blockIndex)
+{
+	MemoryBlock& block{ blocks[_memoryTypeIndex][_blockIndex] };
+	if (block.mapped != nullptr)
+	{
+		vkUnmapMemory(device.GetDevice(), block.memory);
+	}
+	vkFreeMemory(device.GetDevice(), block.memory, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	device.GetMemoryTypeSelector().NotifyFree(_memoryTypeIndex, block.size);
+	RecordBlockFree(statistics, _memoryTypeIndex, block.size);
+	block.memory = VK_NULL_HANDLE;
+	block.allocator.reset();
+	block.size = 0;
+	block.mapped = nullptr;
+}
+
+
+
+VkMappedMemoryRange DeviceMemoryHeap::GetMappedRange(const MemoryAllocation& _allocation, VkDeviceSize _offset, VkDeviceSize _size) const
+{
+	const MemoryBlock& block{ blocks[_allocation.memoryTypeIndex][_allocation.blockIndex] };
+	const VkDeviceSize size{ _size == VK_WHOLE_SIZE ? _allocation.size - _offset : _size };
+
+	//Offsets must be a multiple of nonCoherentAtomSize, and sizes must be too unless the range ends at the end of the block
+	const VkDeviceSize begin{ ((_allocation.offset + _offset) / nonCoherentAtomSize) * nonCoherentAtomSize };
+	const VkDeviceSize end{ ((_allocation.offset + _offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize) * nonCoherentAtomSize };
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.pNext = nullptr;
+	range.memory = block.memory;
+	range.offset = begin;
+	range.size = end >= block.size ? VK_WHOLE_SIZE : end - begin;
+	return range;
+}
+
+
+
+VkMemoryRequirements DeviceMemoryHeap::GetPaddedRequirements(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex) const
+{
+	VkMemoryRequirements requirements{ _requirements };
+	if (IsNonCoherent(_memoryTypeIndex))
+	{
+		requirements.alignment = std::max(requirements.alignment, nonCoherentAtomSize);
+		requirements.size = ((requirements.size + nonCoherentAtomSize - 1) / nonCoherentAtomSize) * nonCoherentAtomSize;
+	}
+	return requirements;
+}
+
+
+
+bool DeviceMemoryHeap::IsNonCoherent(std::uint32_t _memoryTypeIndex) const
+{
+	const VkMemoryPropertyFlags flags{ memoryProperties.memoryTypes[_memoryTypeIndex].propertyFlags };
+	return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+
+
+VkDeviceSize DeviceMemoryHeap::GetBlockSize(std::uint32_t _memoryTypeIndex) const
+{
+	//Keep blocks to at most 1/8th of their heap so that small heaps (e.g.: 256MiB BAR heaps) aren't exhausted by a couple of blocks
+	const VkDeviceSize heapSize{ memoryProperties.memoryHeaps[memoryProperties.memoryTypes[_memoryTypeIndex].heapIndex].size };
+	return std::min(preferredBlockSize, std::max<VkDeviceSize>(heapSize / 8, 1));
+}
+
+
+
+}
\ No newline at end of file
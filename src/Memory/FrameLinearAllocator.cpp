@@ -0,0 +1,96 @@
+#include "NekiVK/Memory/FrameLinearAllocator.h"
+#include "NekiVK/Utils/Strings/format.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+FrameLinearAllocator::FrameLinearAllocator(const VKLogger& _logger, const VulkanDevice& _device, BufferFactory& _bufferFactory, std::size_t _framesInFlight, VkDeviceSize _frameSize, VkBufferUsageFlags _usage)
+										  : logger(_logger), bufferFactory(_bufferFactory), framesInFlight(_framesInFlight)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(_device.GetPhysicalDevice(), &deviceProperties);
+	defaultAlignment = std::max(deviceProperties.limits.minUniformBufferOffsetAlignment, deviceProperties.limits.minStorageBufferOffsetAlignment);
+	frameSize = ((_frameSize + defaultAlignment - 1) / defaultAlignment) * defaultAlignment;
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Creating Frame Linear Allocator (" + std::to_string(framesInFlight) + " frames of " + GetFormattedSizeString(frameSize) + ")\n");
+	bufferHandle = bufferFactory.AllocateBuffer(frameSize * framesInFlight, _usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	buffer = bufferFactory.GetBuffer(bufferHandle);
+	mapped = static_cast<char*>(bufferFactory.GetMappedPointer(bufferHandle));
+
+	currentFrame = 0;
+	head = 0;
+}
+
+
+
+FrameLinearAllocator::~FrameLinearAllocator()
+{
+	bufferFactory.FreeBuffer(bufferHandle);
+}
+
+
+
+FrameAllocation FrameLinearAllocator::Allocate(VkDeviceSize _size, VkDeviceSize _alignment)
+{
+	const VkDeviceSize alignment{ _alignment == 0 ? defaultAlignment : _alignment };
+	const VkDeviceSize offset{ ((head + alignment - 1) / alignment) * alignment };
+	if (offset + _size > frameSize)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Frame linear allocator out of space for frame " + std::to_string(currentFrame) + " (requested " + GetFormattedSizeString(_size) + ", " + GetFormattedSizeString(frameSize - std::min(offset, frameSize)) + " remaining)\n");
+		throw std::runtime_error("");
+	}
+	head = offset + _size;
+
+	FrameAllocation allocation{};
+	allocation.buffer = buffer;
+	allocation.offset = frameSize * currentFrame + offset;
+	allocation.size = _size;
+	allocation.mapped = mapped + allocation.offset;
+	return allocation;
+}
+
+
+
+void FrameLinearAllocator::BeginFrame(std::size_t _frameIndex)
+{
+	currentFrame = _frameIndex % framesInFlight;
+	head = 0;
+}
+
+
+
+VkBuffer FrameLinearAllocator::GetBuffer() const
+{
+	return buffer;
+}
+
+
+
+std::size_t FrameLinearAllocator::GetFramesInFlight() const
+{
+	return framesInFlight;
+}
+
+
+
+VkDeviceSize FrameLinearAllocator::GetFrameSize() const
+{
+	return frameSize;
+}
+
+
+
+VkDeviceSize FrameLinearAllocator::GetUsedSize() const
+{
+	return head;
+}
+
+
+
+}
@@ -0,0 +1,187 @@
+#include "NekiVK/Memory/GrowableBuffer.h"
+#include "NekiVK/Utils/Strings/format.h"
+
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+GrowableBuffer::GrowableBuffer(const VKLogger& _logger, BufferFactory& _bufferFactory, std::size_t _framesInFlight, VkBufferUsageFlags _usage, VkDeviceSize _initialCapacity)
+							  : logger(_logger), bufferFactory(_bufferFactory), framesInFlight(_framesInFlight)
+{
+	usage = _usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	size = 0;
+	capacity = std::max<VkDeviceSize>(_initialCapacity, 4);
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Creating Growable Buffer (initial capacity: " + GetFormattedSizeString(capacity) + ")\n");
+	bufferHandle = bufferFactory.AllocateBuffer(capacity, usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+
+
+GrowableBuffer::~GrowableBuffer()
+{
+	for (RetiredBuffer& retired : retiredBuffers)
+	{
+		bufferFactory.FreeBuffer(retired.buffer);
+	}
+	bufferFactory.FreeBuffer(bufferHandle);
+}
+
+
+
+VkDeviceSize GrowableBuffer::Append(const void* _data, VkDeviceSize _size, UploadBatch& _uploadBatch, VkDeviceSize _alignment)
+{
+	const VkDeviceSize alignment{ std::max<VkDeviceSize>(_alignment, 1) };
+	const VkDeviceSize offset{ ((size + alignment - 1) / alignment) * alignment };
+	if (offset + _size > capacity)
+	{
+		//Grow geometrically so that a run of appends only reallocates O(log n) times
+		VkDeviceSize newCapacity{ capacity };
+		while (newCapacity < offset + _size)
+		{
+			newCapacity *= GROWTH_FACTOR;
+		}
+		Grow(newCapacity, _uploadBatch);
+	}
+
+	bufferFactory.UploadToBuffer(bufferHandle, _data, _size, _uploadBatch, offset);
+	RecordTransferBarrier(_uploadBatch);
+	size = offset + _size;
+	return offset;
+}
+
+
+
+void GrowableBuffer::Reserve(VkDeviceSize _capacity, UploadBatch& _uploadBatch)
+{
+	if (_capacity > capacity)
+	{
+		Grow(_capacity, _uploadBatch);
+		RecordTransferBarrier(_uploadBatch);
+	}
+}
+
+
+
+void GrowableBuffer::Clear()
+{
+	size = 0;
+}
+
+
+
+void GrowableBuffer::BeginFrame(std::size_t _frameIndex)
+{
+	static_cast<void>(_frameIndex);
+	for (RetiredBuffer& retired : retiredBuffers)
+	{
+		if (retired.framesRemaining > 0)
+		{
+			--retired.framesRemaining;
+		}
+		if (retired.framesRemaining == 0 && retired.copyComplete)
+		{
+			bufferFactory.FreeBuffer(retired.buffer);
+		}
+	}
+	std::erase_if(retiredBuffers, [](const RetiredBuffer& _retired){ return _retired.buffer.IsNull(); });
+}
+
+
+
+BufferHandle GrowableBuffer::GetBufferHandle() const
+{
+	return bufferHandle;
+}
+
+
+
+VkBuffer GrowableBuffer::GetBuffer() const
+{
+	return bufferFactory.GetBuffer(bufferHandle);
+}
+
+
+
+VkDeviceSize GrowableBuffer::GetSize() const
+{
+	return size;
+}
+
+
+
+VkDeviceSize GrowableBuffer::GetCapacity() const
+{
+	return capacity;
+}
+
+
+
+std::size_t GrowableBuffer::GetFramesInFlight() const
+{
+	return framesInFlight;
+}
+
+
+
+void GrowableBuffer::Grow(VkDeviceSize _capacity, UploadBatch& _uploadBatch)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Growing Growable Buffer (" + GetFormattedSizeString(capacity) + " -> " + GetFormattedSizeString(_capacity) + ")\n");
+	const BufferHandle newBufferHandle{ bufferFactory.AllocateBuffer(_capacity, usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+	if (size > 0)
+	{
+		//The old buffer goes back to the graphics queue too - frames in flight may still be reading it
+		bufferFactory.RecordOwnershipTransfers(bufferHandle, _uploadBatch);
+		_uploadBatch.ReleaseBuffer(bufferFactory.GetBuffer(newBufferHandle));
+		_uploadBatch.CopyBuffer(bufferFactory.GetBuffer(bufferHandle), bufferFactory.GetBuffer(newBufferHandle), size);
+	}
+
+	//Frames recorded before now may still reference the old buffer, and the copy above reads from it - only free it once both are done with it
+	RetiredBuffer retired{};
+	retired.buffer = bufferHandle;
+	retired.copyComplete = false;
+	retired.framesRemaining = framesInFlight;
+	retiredBuffers.push_back(retired);
+	_uploadBatch.AddCompletionCallback([this, oldBufferHandle{ bufferHandle }]()
+	{
+		for (RetiredBuffer& retiredBuffer : retiredBuffers)
+		{
+			if (retiredBuffer.buffer == oldBufferHandle)
+			{
+				retiredBuffer.copyComplete = true;
+
+				//No frames to wait for (the buffer isn't attached to a render manager) - the copy was the last thing reading it
+				if (retiredBuffer.framesRemaining == 0)
+				{
+					bufferFactory.FreeBuffer(retiredBuffer.buffer);
+				}
+			}
+		}
+		std::erase_if(retiredBuffers, [](const RetiredBuffer& _retired){ return _retired.buffer.IsNull(); });
+	});
+
+	bufferHandle = newBufferHandle;
+	capacity = _capacity;
+}
+
+
+
+void GrowableBuffer::RecordTransferBarrier(UploadBatch& _uploadBatch)
+{
+	//A pipeline barrier's second scope covers everything later in submission order - including other submissions to the same queue
+	//(With a dedicated transfer queue, the ownership acquire on the graphics queue is what makes the writes visible - this barrier is then just ordering within the transfer queue)
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	vkCmdPipelineBarrier(_uploadBatch.GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+
+}
\ No newline at end of file
@@ -1,10 +1,13 @@
 #include "NekiVK/Memory/ImageFactory.h"
+#include "NekiVK/Utils/Pixels/PixelKernels.h"
 #include "NekiVK/Utils/Strings/format.h"
 
 #include <cstring>
 #include <climits>
 #include <stdexcept>
 #include <algorithm>
+#include <bit>
+#include <numeric>
 
 namespace Neki
 {
@@ -16,6 +19,9 @@ ImageFactory::ImageFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDeb
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::IMAGE_FACTORY, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::IMAGE_FACTORY, "Image Factory Initialised\n");
+
+	memoryStatistics = {};
+	memoryStatistics.memoryTypeCount = device.GetMemoryTypeSelector().GetMemoryProperties().memoryTypeCount;
 }
 
 
@@ -29,9 +35,10 @@ ImageFactory::~ImageFactory()
 		FreeImageViewImpl(imgView);
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  All image views freed\n");
-	while (!imageMemoryMap.empty())
+	while (!images.Empty())
 	{
-		VkImage img{ imageMemoryMap.begin()->first };
+		//Free from the back so that the slot map doesn't have to move any records
+		ImageHandle img{ images.GetHandle(images.Size() - 1) };
 		FreeImageImpl(img);
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  All images and underlying memory freed\n");
@@ -46,15 +53,22 @@ ImageFactory::~ImageFactory()
 
 
 
-VkImage ImageFactory::AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata)
+ImageHandle ImageFactory::AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata, UploadBatch* _uploadBatch, bool _generateMipmaps)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Allocating 1 Image And Associated Memory\n");
-	return AllocateImageImpl(_filepath, _flags, _formatOverride, _textureType, _flipImage, _out_metadata);
+	if (_uploadBatch != nullptr)
+	{
+		return AllocateImageImpl(_filepath, _flags, _formatOverride, _textureType, _flipImage, _generateMipmaps, _out_metadata, *_uploadBatch);
+	}
+	const std::unique_ptr<UploadBatch> uploadBatch{ bufferFactory.CreateUploadBatch() };
+	ImageHandle image{ AllocateImageImpl(_filepath, _flags, _formatOverride, _textureType, _flipImage, _generateMipmaps, _out_metadata, *uploadBatch) };
+	uploadBatch->Wait();
+	return image;
 }
 
 
 
-VkImage ImageFactory::AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags)
+ImageHandle ImageFactory::AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Allocating 1 Empty Image And Associated Memory\n");
 	return AllocateImageImpl(_size, _format, _flags);
@@ -62,44 +76,77 @@ VkImage ImageFactory::AllocateImage(VkExtent2D _size, VkFormat _format, const Vk
 
 
 
-std::vector<VkImage> ImageFactory::AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, VkFormat* _formatOverrides, MODEL_TEXTURE_TYPE* _textureTypes, bool* _flipImages, ImageMetadata* _out_metadata)
+std::vector<ImageHandle> ImageFactory::AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, VkFormat* _formatOverrides, MODEL_TEXTURE_TYPE* _textureTypes, bool* _flipImages, ImageMetadata* _out_metadata, UploadBatch* _uploadBatch, bool* _generateMipmaps)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Allocating " + std::to_string(_count) + " Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkImage> images;
+
+	//Record all uploads into the one batch so that they're submitted (and waited on) together
+	std::unique_ptr<UploadBatch> ownedUploadBatch{ _uploadBatch == nullptr ? bufferFactory.CreateUploadBatch() : nullptr };
+	UploadBatch& uploadBatch{ _uploadBatch == nullptr ? *ownedUploadBatch : *_uploadBatch };
+
+	std::vector<ImageHandle> handles;
 	for (std::size_t i{ 0 }; i < _count; ++i)
 	{
 		VkFormat formatOverride{ _formatOverrides == nullptr ? VK_FORMAT_UNDEFINED : _formatOverrides[i] };
 		MODEL_TEXTURE_TYPE textureType{ _textureTypes == nullptr ? MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES : _textureTypes[i] };
 		bool flipImage{ _flipImages == nullptr ? false : _flipImages[i] };
-		images.push_back(AllocateImageImpl(_filepaths[i], _flags[i], formatOverride, textureType, flipImage, &(_out_metadata[i])));
+		bool generateMipmaps{ _generateMipmaps == nullptr ? false : _generateMipmaps[i] };
+		handles.push_back(AllocateImageImpl(_filepaths[i], _flags[i], formatOverride, textureType, flipImage, generateMipmaps, _out_metadata == nullptr ? nullptr : &(_out_metadata[i]), uploadBatch));
 	}
-	return images;
+
+	if (ownedUploadBatch)
+	{
+		ownedUploadBatch->Wait();
+	}
+	return handles;
 }
 
 
 
-std::vector<VkImage> ImageFactory::AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags, bool* _flipImages)
+std::vector<ImageHandle> ImageFactory::AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags, bool* _flipImages)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Allocating " + std::to_string(_count) + " Empty Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkImage> images;
+	std::vector<ImageHandle> handles;
 	for (std::size_t i{ 0 }; i < _count; ++i)
 	{
-		images.push_back(AllocateImageImpl(_sizes[i], _formats[i], _flags[i], _flipImages == nullptr ? false : _flipImages[i]));
+		handles.push_back(AllocateImageImpl(_sizes[i], _formats[i], _flags[i], _flipImages == nullptr ? false : _flipImages[i]));
 	}
-	return images;
+	return handles;
 }
 
 
 
-VkImage ImageFactory::AllocateImageArray(std::uint32_t _arrSize, const char** _filepaths, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata)
+ImageHandle ImageFactory::AllocateImageArray(std::uint32_t _arrSize, const char** _filepaths, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata, UploadBatch* _uploadBatch, bool _generateMipmaps)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Allocating Image Array Of Size " + std::to_string(_arrSize) + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	return AllocateImageArrayImpl(_arrSize, _filepaths, _flags, _formatOverride, _textureType, _flipImage, _out_metadata);
+	if (_uploadBatch != nullptr)
+	{
+		return AllocateImageArrayImpl(_arrSize, _filepaths, _flags, _formatOverride, _textureType, _flipImage, _generateMipmaps, _out_metadata, *_uploadBatch);
+	}
+	const std::unique_ptr<UploadBatch> uploadBatch{ bufferFactory.CreateUploadBatch() };
+	ImageHandle imageArray{ AllocateImageArrayImpl(_arrSize, _filepaths, _flags, _formatOverride, _textureType, _flipImage, _generateMipmaps, _out_metadata, *uploadBatch) };
+	uploadBatch->Wait();
+	return imageArray;
+}
+
+
+
+ImageHandle ImageFactory::AllocateImageArray(std::uint32_t _arrSize, const unsigned char* const* _pixels, VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, UploadBatch* _uploadBatch, bool _generateMipmaps, std::uint32_t _maxMipLevels)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Allocating Image Array Of Size " + std::to_string(_arrSize) + " From Memory And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (_uploadBatch != nullptr)
+	{
+		return AllocateImageArrayImpl(_arrSize, _pixels, _size, _format, _flags, _generateMipmaps, _maxMipLevels, *_uploadBatch);
+	}
+	const std::unique_ptr<UploadBatch> uploadBatch{ bufferFactory.CreateUploadBatch() };
+	ImageHandle imageArray{ AllocateImageArrayImpl(_arrSize, _pixels, _size, _format, _flags, _generateMipmaps, _maxMipLevels, *uploadBatch) };
+	uploadBatch->Wait();
+	return imageArray;
 }
 
 
 
-void ImageFactory::FreeImage(VkImage& _image)
+void ImageFactory::FreeImage(ImageHandle& _image)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Freeing 1 Image And Associated Memory\n");
 	FreeImageImpl(_image);
@@ -107,7 +154,7 @@ void ImageFactory::FreeImage(VkImage& _image)
 
 
 
-void ImageFactory::FreeImages(std::uint32_t _count, VkImage* _images)
+void ImageFactory::FreeImages(std::uint32_t _count, ImageHandle* _images)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Freeing " + std::to_string(_count) + " Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	for (std::size_t i{ 0 }; i < _count; ++i)
@@ -118,17 +165,45 @@ void ImageFactory::FreeImages(std::uint32_t _count, VkImage* _images)
 
 
 
-void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstLayout, VkImageAspectFlags _aspectMask, VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask, std::size_t _layers, VkImage& _image, VkCommandBuffer* _commandBuffer)
+bool ImageFactory::IsValid(ImageHandle _image) const
+{
+	return images.Contains(_image);
+}
+
+
+
+VkImage ImageFactory::GetImage(ImageHandle _image) const
+{
+	return GetRecord(_image).image;
+}
+
+
+
+std::uint32_t ImageFactory::GetMipLevels(ImageHandle _image) const
 {
-	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? commandPool.AllocateCommandBuffer() : *_commandBuffer };
-	if (_commandBuffer == nullptr)
+	return GetRecord(_image).mipLevels;
+}
+
+
+
+MemoryStatistics ImageFactory::GetMemoryStatistics() const
+{
+	MemoryStatistics statistics{ memoryStatistics };
+	for (const ImageRecord& record : images)
 	{
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		statistics.memoryTypes[record.memoryTypeIndex].largestBlock = std::max(statistics.memoryTypes[record.memoryTypeIndex].largestBlock, record.memorySize);
+		statistics.total.largestBlock = std::max(statistics.total.largestBlock, record.memorySize);
 	}
+	return statistics;
+}
+
+
+
+void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstLayout, VkImageAspectFlags _aspectMask, VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask, std::size_t _layers, ImageHandle _image, VkCommandBuffer* _commandBuffer)
+{
+	//If no command buffer was provided, record into a temporary batch's graphics command buffer (transitions may use stages the transfer queue doesn't support) and block on its fence
+	std::unique_ptr<UploadBatch> uploadBatch{ _commandBuffer == nullptr ? bufferFactory.CreateUploadBatch() : nullptr };
+	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? uploadBatch->GetGraphicsCommandBuffer() : *_commandBuffer };
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -137,35 +212,25 @@ void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstL
 	barrier.newLayout = _dstLayout;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = _image;
+	barrier.image = GetImage(_image);
 	barrier.subresourceRange.aspectMask = _aspectMask;
 	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.levelCount = GetMipLevels(_image);
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = _layers;
 	barrier.srcAccessMask = _srcAccessMask;
 	barrier.dstAccessMask = _dstAccessMask;
 	vkCmdPipelineBarrier(commandBuffer, _srcStageMask, _dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-	if (_commandBuffer == nullptr)
+	if (uploadBatch)
 	{
-		vkEndCommandBuffer(commandBuffer);
-
-		//Execute the command buffer
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pNext = nullptr;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(device.GetGraphicsQueue());
-		commandPool.FreeCommandBuffer(commandBuffer);
+		uploadBatch->Wait();
 	}
 }
 
 
 
-VkImageView ImageFactory::CreateImageView(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags, bool _arrayView, std::uint32_t _layerCount)
+VkImageView ImageFactory::CreateImageView(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags, bool _arrayView, std::uint32_t _layerCount)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Creating 1 Image View\n");
 	return CreateImageViewImpl(_image, _format, _aspectFlags, _arrayView, _layerCount);
@@ -173,7 +238,7 @@ VkImageView ImageFactory::CreateImageView(const VkImage& _image, const VkFormat&
 
 
 
-std::vector<VkImageView> ImageFactory::CreateImageViews(std::uint32_t _count, const VkImage* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags, bool* _arrayViews, std::uint32_t* _layerCounts)
+std::vector<VkImageView> ImageFactory::CreateImageViews(std::uint32_t _count, const ImageHandle* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags, bool* _arrayViews, std::uint32_t* _layerCounts)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "Creating " + std::to_string(_count) + " Image View" + std::string(_count == 1 ? "" : "s") + "\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	std::vector<VkImageView> imageViews;
@@ -248,7 +313,7 @@ void ImageFactory::FreeSampler(std::uint32_t _count, VkSampler* _samplers)
 
 
 
-VkFormat ImageFactory::ChooseFormat(int _nrChannels, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType)
+VkFormat ImageFactory::ChooseFormat(int _nrChannels, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType) const
 {
 	//If format override is specified, prioritise it over anything else
 	if (_formatOverride != VK_FORMAT_UNDEFINED)
@@ -256,71 +321,245 @@ VkFormat ImageFactory::ChooseFormat(int _nrChannels, VkFormat _formatOverride, M
 		return _formatOverride;
 	}
 
-	//For colour maps (or if texture type hasn't been set), always use SRGB
+	//Prefer the format matching the image's own channel count, only expanding to 4 channels if the device can't sample it (R8G8B8 especially is rarely supported)
+	//For colour maps (or if texture type hasn't been set), always use SRGB - grey + alpha colour maps go straight to 4 channels so that their alpha isn't SRGB-encoded
+	std::vector<VkFormat> candidates;
 	if (_textureType == MODEL_TEXTURE_TYPE::DIFFUSE || _textureType == MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES)
 	{
 		switch (_nrChannels)
 		{
-		case 1: return VK_FORMAT_R8_SRGB;
-		case 2: return VK_FORMAT_R8G8_SRGB;
-		case 3: return VK_FORMAT_R8G8B8_SRGB;
-		case 4: return VK_FORMAT_R8G8B8A8_SRGB;
-		default: return VK_FORMAT_R8G8B8A8_SRGB; //Fallback
+		case 1: candidates = { VK_FORMAT_R8_SRGB, VK_FORMAT_R8G8B8A8_SRGB }; break;
+		case 3: candidates = { VK_FORMAT_R8G8B8_SRGB, VK_FORMAT_R8G8B8A8_SRGB }; break;
+		default: candidates = { VK_FORMAT_R8G8B8A8_SRGB }; break;
 		}
 	}
 
 	//For all other (data) maps (normals, specular, roughness, etc.), always use UNORM
-	switch (_nrChannels)
+	else
+	{
+		switch (_nrChannels)
+		{
+		case 1: candidates = { VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }; break;
+		case 2: candidates = { VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }; break;
+		case 3: candidates = { VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }; break;
+		default: candidates = { VK_FORMAT_R8G8B8A8_UNORM }; break;
+		}
+	}
+
+	return device.FindSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+
+
+int ImageFactory::GetFormatChannels(VkFormat _format)
+{
+	switch (_format)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+		return 1;
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SRGB:
+		return 2;
+	case VK_FORMAT_R8G8B8_UNORM:
+	case VK_FORMAT_R8G8B8_SRGB:
+	case VK_FORMAT_B8G8R8_UNORM:
+	case VK_FORMAT_B8G8R8_SRGB:
+		return 3;
+	default:
+		return 4; //Anything else is assumed to take RGBA8 data
+	}
+}
+
+
+
+VkComponentMapping ImageFactory::GetChannelSwizzle(int _channels)
+{
+	//Greyscale images are stored as R (grey) or RG (grey + alpha), but should sample like the RGBA images they would decode to
+	switch (_channels)
 	{
-	case 1: return VK_FORMAT_R8_UNORM;
-	case 2: return VK_FORMAT_R8G8_UNORM;
-	case 3: return VK_FORMAT_R8G8B8_UNORM;
-	case 4: return VK_FORMAT_R8G8B8A8_UNORM;
-	default: return VK_FORMAT_R8G8B8A8_UNORM; //Fallback
+	case 1: return { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+	case 2: return { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G };
+	default: return { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
 	}
 }
 
 
 
-VkImage ImageFactory::AllocateImageImpl(const char* _filepath, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata)
+const unsigned char* ImageFactory::ConvertChannelsForUpload(const ImageData& _imageData, int _channels, std::vector<unsigned char>& _out_convertedPixels)
 {
+	if (_imageData.metadata.channels == _channels)
+	{
+		return _imageData.pixels;
+	}
+	_out_convertedPixels.resize(static_cast<std::size_t>(_imageData.metadata.width) * _imageData.metadata.height * _channels);
+	PixelKernels::ConvertChannels(_imageData.pixels, static_cast<std::size_t>(_imageData.metadata.width) * _imageData.metadata.height, _imageData.metadata.channels, _channels, _out_convertedPixels.data());
+	return _out_convertedPixels.data();
+}
+
+
+
+VkFormat ImageFactory::ChooseCompressedFormat(const char* _filepath, VkFormat _fileFormat, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType) const
+{
+	//The blocks are uploaded as-is, so an override can only reinterpret them as another format with the same block size (e.g.: BC7_UNORM -> BC7_SRGB)
+	VkFormat format{ _fileFormat };
+	if (_formatOverride != VK_FORMAT_UNDEFINED)
+	{
+		if (ImageLoader::GetBlockSize(_formatOverride) != ImageLoader::GetBlockSize(_fileFormat))
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Format override (" + std::to_string(_formatOverride) + ") is incompatible with the block-compressed format of " + std::string(_filepath) + " (" + std::to_string(_fileFormat) + ")\n");
+			throw std::runtime_error("");
+		}
+		format = _formatOverride;
+	}
+
+	//If a texture type has been set, it decides the colour space like it does for uncompressed images (BC4 and BC5 have no SRGB variants)
+	//Otherwise, the file's own format is trusted
+	else if (_textureType != MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES)
+	{
+		const bool srgb{ _textureType == MODEL_TEXTURE_TYPE::DIFFUSE };
+		switch (_fileFormat)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK: format = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK; break;
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: format = srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK: format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK; break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK: format = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK; break;
+		default: break;
+		}
+	}
+
+	//There's no fallback - decompressing on the CPU would defeat the point of shipping compressed textures
+	if (!device.IsFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Block-compressed format (" + std::to_string(format) + ") of " + std::string(_filepath) + " is not supported by this device\n");
+		throw std::runtime_error("");
+	}
+
+	return format;
+}
+
+
+
+ImageHandle ImageFactory::AllocateImageImpl(const char* _filepath, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, bool _generateMipmaps, ImageMetadata* _out_metadata, UploadBatch& _uploadBatch)
+{
+	//Uncompressed images that don't need a CPU mip chain are decoded straight into staging memory, skipping the intermediate pixel buffer and copy
+	const ImageMetadata info{ ImageLoader::GetInfo(_filepath, _flipImage) };
+	if (!info.blockCompressed)
+	{
+		const VkFormat format{ ChooseFormat(info.channels, _formatOverride, _textureType) };
+		if (format != VK_FORMAT_R16G16B16A16_SFLOAT && (!_generateMipmaps || CanBlitMipmaps(format)))
+		{
+			return AllocateImageDirect(_filepath, info, format, _flags, _formatOverride, _flipImage, _generateMipmaps, _out_metadata, _uploadBatch);
+		}
+	}
+
 	//Load the data to disk
 	ImageData imgData{ ImageLoader::Load(_filepath, _flipImage) };
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Loaded " + std::string(_filepath) + " from disk (" + std::to_string(imgData.metadata.width) + "x" + std::to_string(imgData.metadata.height) + ", " + std::to_string(imgData.metadata.channels) + " channels)\n");
 
-	//Create temporary staging buffer
-	const VkDeviceSize imgSize{ static_cast<VkDeviceSize>(imgData.metadata.width * imgData.metadata.height * imgData.metadata.channels) }; //Assume 1 byte per channel
-	VkBuffer stagingBuffer{ bufferFactory.AllocateBuffer(imgSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Created temporary staging buffer of size " + GetFormattedSizeString(imgSize) + "\n");
+	//Create destination image in device local memory
+	//Block-compressed images bring their own mip chain
+	const bool blockCompressed{ imgData.metadata.blockCompressed };
+	VkFormat format{ blockCompressed ? ChooseCompressedFormat(_filepath, imgData.metadata.vkFormat, _formatOverride, _textureType) : ChooseFormat(imgData.metadata.channels, _formatOverride, _textureType) };
+	const int uploadChannels{ blockCompressed ? imgData.metadata.channels : GetFormatChannels(format) };
+	const bool halfFloat{ !blockCompressed && format == VK_FORMAT_R16G16B16A16_SFLOAT }; //Widened from RGBA8 on the CPU
+	if (blockCompressed && _generateMipmaps)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mipmaps can't be generated for block-compressed images - using the " + std::to_string(imgData.mipLevels.size()) + " mip level(s) stored in the file\n");
+	}
+	const bool generateMipmaps{ _generateMipmaps && (!halfFloat || CanBlitMipmaps(format)) };
+	if (halfFloat && _generateMipmaps && !generateMipmaps)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mipmaps can only be generated on the CPU for 8-bit formats - the half-float image will only have 1 mip level\n");
+	}
+	const std::uint32_t mipLevels{ blockCompressed ? static_cast<std::uint32_t>(imgData.mipLevels.size()) : generateMipmaps ? static_cast<std::uint32_t>(std::bit_width(static_cast<std::uint32_t>(std::max(imgData.metadata.width, imgData.metadata.height)))) : 1 };
+	ImageHandle image{ AllocateImageImpl(VkExtent2D(imgData.metadata.width, imgData.metadata.height), format, _flags, 1, mipLevels) };
+	const bool blitMipmaps{ !blockCompressed && mipLevels > 1 && CanBlitMipmaps(format) };
+	if (!blockCompressed && _formatOverride == VK_FORMAT_UNDEFINED) { images.Get(image)->components = GetChannelSwizzle(uploadChannels); }
 
-	//Copy pixel data to staging buffer
-	void* mappedMemory;
-	vkMapMemory(device.GetDevice(), bufferFactory.GetMemory(stagingBuffer), 0, imgSize, 0, &mappedMemory);
-	memcpy(mappedMemory, imgData.pixels, imgSize);
-	vkUnmapMemory(device.GetDevice(), bufferFactory.GetMemory(stagingBuffer));
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Pixel Data copied to staging buffer\n");
+	//Record the transitions and copy into the upload batch (the pixel data is streamed through the staging ring)
+	VkCommandBuffer commandBuffer{ _uploadBatch.GetCommandBuffer() };
+	TransitionImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 1, image, &commandBuffer);
+	if (blockCompressed)
+	{
+		UploadCompressedMipLevels(image, imgData, 0, mipLevels, _uploadBatch);
+	}
+	else if (halfFloat)
+	{
+		//Colour maps (or images without a texture type) are decoded from sRGB on the way, as there's no SRGB half-float format to do it when sampling
+		const std::size_t texelCount{ static_cast<std::size_t>(imgData.metadata.width) * imgData.metadata.height };
+		std::vector<unsigned char> convertedPixels;
+		const unsigned char* pixels{ ConvertChannelsForUpload(imgData, 4, convertedPixels) };
+		std::vector<std::uint16_t> halfPixels(texelCount * 4);
+		PixelKernels::ConvertRGBA8ToRGBA16F(pixels, texelCount, _textureType == MODEL_TEXTURE_TYPE::DIFFUSE || _textureType == MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, halfPixels.data());
+		UploadToImage(image, halfPixels.data(), imgData.metadata.width, imgData.metadata.height, 8, 0, 0, _uploadBatch);
+	}
+	else
+	{
+		if (mipLevels > 1 && !blitMipmaps)
+		{
+			//The CPU mip chain is filtered from the converted texels, so convert them up front
+			std::vector<unsigned char> convertedPixels;
+			const unsigned char* pixels{ ConvertChannelsForUpload(imgData, uploadChannels, convertedPixels) };
+			UploadToImage(image, pixels, imgData.metadata.width, imgData.metadata.height, uploadChannels, 0, 0, _uploadBatch); //Assume 1 byte per channel
+			UploadMipmaps(image, pixels, imgData.metadata.width, imgData.metadata.height, uploadChannels, 0, _uploadBatch);
+		}
+		else
+		{
+			//Otherwise, the texels are converted as they're written into the staging ring
+			UploadToImage(image, imgData.pixels, imgData.metadata.width, imgData.metadata.height, uploadChannels, 0, 0, _uploadBatch, 1, imgData.metadata.channels);
+		}
+	}
+	imgData.metadata.vkFormat = format;
+	imgData.metadata.channels = uploadChannels;
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Pixel Data copied to staging ring\n");
 
-	//Free the image data as it's in the staging buffer now
+	//Free the image data as it's in the staging ring now
 	ImageLoader::Free(imgData.pixels);
 
-	//Create destination image in device local memory
-	VkFormat format{ ChooseFormat(imgData.metadata.channels, _formatOverride, _textureType) };
-	imgData.metadata.vkFormat = format;
-	VkImage image{ AllocateImageImpl(VkExtent2D(imgData.metadata.width, imgData.metadata.height), format, _flags) };
+	FinishUpload(image, blitMipmaps, _uploadBatch);
+
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture upload recorded to upload batch\n");
+
+	if (_out_metadata != nullptr) { *_out_metadata = imgData.metadata; }
+
+	return image;
+}
 
-	//Record command buffer for copy command
-	VkCommandBuffer commandBuffer{ commandPool.AllocateCommandBuffer() };
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.pNext = nullptr;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-	TransitionImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 1, image, &commandBuffer);
 
-	//Copy the staging buffer to the image
+ImageHandle ImageFactory::AllocateImageDirect(const char* _filepath, const ImageMetadata& _info, VkFormat _format, const VkImageUsageFlags _flags, VkFormat _formatOverride, bool _flipImage, bool _generateMipmaps, ImageMetadata* _out_metadata, UploadBatch& _uploadBatch)
+{
+	const int uploadChannels{ GetFormatChannels(_format) };
+	const std::uint32_t mipLevels{ _generateMipmaps ? static_cast<std::uint32_t>(std::bit_width(static_cast<std::uint32_t>(std::max(_info.width, _info.height)))) : 1 };
+	ImageHandle image{ AllocateImageImpl(VkExtent2D(_info.width, _info.height), _format, _flags, 1, mipLevels) };
+	if (_formatOverride == VK_FORMAT_UNDEFINED) { images.Get(image)->components = GetChannelSwizzle(uploadChannels); }
+
+	//The whole image has to be decoded in one go, so images too large for the staging ring get a dedicated staging buffer, freed once the batch completes
+	StagingRing& ring{ bufferFactory.GetStagingRing() };
+	const VkDeviceSize size{ static_cast<VkDeviceSize>(_info.width) * _info.height * uploadChannels };
+	StagingAllocation staging{};
+	if (size <= ring.GetMaxAllocationSize())
+	{
+		staging = ring.Allocate(size, std::lcm(static_cast<VkDeviceSize>(4), static_cast<VkDeviceSize>(uploadChannels)), _uploadBatch);
+	}
+	else
+	{
+		const BufferHandle stagingBuffer{ bufferFactory.AllocateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT) };
+		staging = { bufferFactory.GetBuffer(stagingBuffer), 0, size, bufferFactory.GetMappedPointer(stagingBuffer) };
+		_uploadBatch.DeferFree(stagingBuffer);
+	}
+	ImageMetadata metadata{ ImageLoader::LoadInto(_filepath, _flipImage, uploadChannels, static_cast<unsigned char*>(staging.mapped), static_cast<std::size_t>(_info.width) * uploadChannels) };
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Decoded " + std::string(_filepath) + " into staging memory (" + std::to_string(metadata.width) + "x" + std::to_string(metadata.height) + ", " + std::to_string(_info.channels) + " channels)\n");
+
+	VkCommandBuffer commandBuffer{ _uploadBatch.GetCommandBuffer() };
+	TransitionImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 1, image, &commandBuffer);
 	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
+	region.bufferOffset = staging.offset;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -328,37 +567,22 @@ VkImage ImageFactory::AllocateImageImpl(const char* _filepath, const VkImageUsag
 	region.imageSubresource.baseArrayLayer = 0;
 	region.imageSubresource.layerCount = 1;
 	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { static_cast<std::uint32_t>(imgData.metadata.width), static_cast<std::uint32_t>(imgData.metadata.height), 1 };
-	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	TransitionImage(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 1, image, &commandBuffer);
+	region.imageExtent = { static_cast<std::uint32_t>(metadata.width), static_cast<std::uint32_t>(metadata.height), 1 };
+	_uploadBatch.CopyBufferToImage(staging.buffer, GetImage(image), 1, &region);
 
-	vkEndCommandBuffer(commandBuffer);
+	FinishUpload(image, mipLevels > 1, _uploadBatch);
 
-	//Execute the command buffer
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext = nullptr;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-	vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(device.GetGraphicsQueue());
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture upload recorded to upload batch\n");
 
-
-	//Cleanup
-	commandPool.FreeCommandBuffer(commandBuffer);
-	bufferFactory.FreeBuffer(stagingBuffer);
-
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture data successfully transferred to device local memory\n");
-
-	if (_out_metadata != nullptr) { *_out_metadata = imgData.metadata; }
+	metadata.vkFormat = _format;
+	if (_out_metadata != nullptr) { *_out_metadata = metadata; }
 
 	return image;
 }
 
 
 
-VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, std::size_t _layers)
+ImageHandle ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, std::size_t _layers, std::uint32_t _mipLevels)
 {
 	VkImageCreateInfo imgInfo{};
 	imgInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -368,12 +592,12 @@ VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, cons
 	imgInfo.extent.width = _size.width;
 	imgInfo.extent.height = _size.height;
 	imgInfo.extent.depth = 1;
-	imgInfo.mipLevels = 1;
+	imgInfo.mipLevels = _mipLevels;
 	imgInfo.arrayLayers = _layers;
 	imgInfo.format = _format;
 	imgInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imgInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imgInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | _flags;
+	imgInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | _flags | (_mipLevels > 1 ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0); //Each mip level is blitted from the one before it
 	imgInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imgInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -391,19 +615,10 @@ VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, cons
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Searching for compatible memory type for image that is DEVICE_LOCAL", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(device.GetDevice(), image, &memRequirements);
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &memProperties);
-	std::uint32_t memTypeIndex{ UINT_MAX };
-	for (std::uint32_t i{ 0 }; i < memProperties.memoryTypeCount; ++i)
-	{
-		if ((memRequirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
-		{
-			memTypeIndex = i;
-			break;
-		}
-	}
-	logger.Log(memTypeIndex != UINT_MAX ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, memTypeIndex != UINT_MAX ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (memTypeIndex == UINT_MAX)
+	MemoryTypeSelector& memoryTypeSelector{ device.GetMemoryTypeSelector() };
+	const std::uint32_t memTypeIndex{ memoryTypeSelector.SelectMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memRequirements.size) };
+	logger.Log(memTypeIndex != UINT32_MAX ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, memTypeIndex != UINT32_MAX ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (memTypeIndex == UINT32_MAX)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "(" + std::to_string(result) + ")", VK_LOGGER_WIDTH::DEFAULT, false);
 		throw std::runtime_error("");
@@ -415,149 +630,389 @@ VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, cons
 	allocInfo.allocationSize = memRequirements.size;
 	allocInfo.memoryTypeIndex = memTypeIndex;
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Allocating DEVICE_LOCAL memory for image", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	result = vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &(imageMemoryMap[image]));
+	VkDeviceMemory memory;
+	result = vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &memory);
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
 	if (result != VK_SUCCESS)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "(" + std::to_string(result) + ")", VK_LOGGER_WIDTH::DEFAULT, false);
+		vkDestroyImage(device.GetDevice(), image, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
 		throw std::runtime_error("");
 	}
+	memoryTypeSelector.NotifyAllocation(memTypeIndex, memRequirements.size);
+	RecordBlockAllocation(memoryStatistics, memTypeIndex, memRequirements.size);
+	RecordAllocation(memoryStatistics, memTypeIndex, memRequirements.size);
 
 	//Bind the allocated memory to the VkImage handle
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Binding allocated memory to image\n");
-	vkBindImageMemory(device.GetDevice(), image, imageMemoryMap[image], 0);
-
-	return image;
+	vkBindImageMemory(device.GetDevice(), image, memory, 0);
+
+	//Populate the image's record
+	ImageRecord record{};
+	record.image = image;
+	record.memory = memory;
+	record.memoryTypeIndex = memTypeIndex;
+	record.memorySize = memRequirements.size;
+	record.extent = _size;
+	record.format = _format;
+	record.layers = static_cast<std::uint32_t>(_layers);
+	record.mipLevels = _mipLevels;
+	record.usage = imgInfo.usage;
+	record.components = GetChannelSwizzle(4);
+
+	return images.Insert(record);
 }
 
 
 
-VkImage ImageFactory::AllocateImageArrayImpl(std::uint32_t _arrSize, const char** _filepaths, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, ImageMetadata* _out_metadata)
+ImageHandle ImageFactory::AllocateImageArrayImpl(std::uint32_t _arrSize, const char** _filepaths, const VkImageUsageFlags _flags, VkFormat _formatOverride, MODEL_TEXTURE_TYPE _textureType, bool _flipImage, bool _generateMipmaps, ImageMetadata* _out_metadata, UploadBatch& _uploadBatch)
 {
 	//Images in an image array must all have the same format and dimensions
 	//Require format to be the same across all images
 	//Pad dimensions of all images to be max dimension sizes
 
-	//Get max dimensions while loading all image data into a vector (I would use stbi_info for this but it's broken for pngs - returns "no SOI" stbi_failure_reason())...
+	//Get max dimensions after loading all image data into a vector (I would use stbi_info for this but it's broken for pngs - returns "no SOI" stbi_failure_reason())...
 	//...They said they fixed this in 2022....
-	std::vector<ImageData> imageData(_arrSize);
-	imageData[0] = ImageLoader::Load(_filepaths[0], _flipImage);
+	//The layers are decoded in parallel
+	std::vector<ImageData> imageData{ ImageLoader::LoadMany(_arrSize, _filepaths, _flipImage) };
 	int maxWidth{ imageData[0].metadata.width };
 	int maxHeight{ imageData[0].metadata.height };
-	int requiredNrChannels{ imageData[0].metadata.channels };
-	VkFormat format{ ChooseFormat(requiredNrChannels, _formatOverride, _textureType) };
-	imageData[0].metadata.vkFormat = format;
+	const bool blockCompressed{ imageData[0].metadata.blockCompressed };
+	const VkFormat compressedFileFormat{ imageData[0].metadata.vkFormat };
+	std::uint32_t storedMipLevels{ static_cast<std::uint32_t>(imageData[0].mipLevels.size()) };
+	bool anyColour{ imageData[0].metadata.channels >= 3 };
+	bool anyAlpha{ imageData[0].metadata.channels == 2 || imageData[0].metadata.channels == 4 };
 	for (std::size_t i{ 1 }; i < _arrSize; ++i)
 	{
-		imageData[i] = ImageLoader::Load(_filepaths[i], _flipImage);
 		int width{ imageData[i].metadata.width };
 		int height{ imageData[i].metadata.height };
 		int nrChannels{ imageData[i].metadata.channels };
-		imageData[i].metadata.vkFormat = format;
-		if (nrChannels != requiredNrChannels && _formatOverride == VK_FORMAT_UNDEFINED)
+
+		//Block-compressed layers are uploaded as-is, so they can't be converted or padded to match each other
+		if (imageData[i].metadata.blockCompressed != blockCompressed)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "Image " + std::to_string(i) + " is" + std::string(blockCompressed ? " not" : "") + " block-compressed but image 0 is" + std::string(blockCompressed ? "" : " not") + " - block-compressed and uncompressed images can't share an image array\n");
+			throw std::runtime_error("");
+		}
+		if (blockCompressed && (imageData[i].metadata.vkFormat != compressedFileFormat || width != imageData[0].metadata.width || height != imageData[0].metadata.height))
 		{
-			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "Number of channels for image " + std::to_string(i) + " (" + std::to_string(nrChannels) + ") does not match required number of channels (" + std::to_string(requiredNrChannels) + ")\n");
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "Block-compressed image " + std::to_string(i) + " (format " + std::to_string(imageData[i].metadata.vkFormat) + ", " + std::to_string(width) + "x" + std::to_string(height) + ") does not match the format and dimensions of image 0 (format " + std::to_string(compressedFileFormat) + ", " + std::to_string(imageData[0].metadata.width) + "x" + std::to_string(imageData[0].metadata.height) + ")\n");
 			throw std::runtime_error("");
 		}
+		storedMipLevels = std::min(storedMipLevels, static_cast<std::uint32_t>(imageData[i].mipLevels.size()));
+		anyColour = anyColour || nrChannels >= 3;
+		anyAlpha = anyAlpha || nrChannels == 2 || nrChannels == 4;
 
 		if (width > maxWidth) { maxWidth = width; }
 		if (height > maxHeight) { maxHeight = height; }
 	}
 
+	//Uncompressed layers with different channel counts are all converted to the fewest channels that lose nothing from any of them
+	const int requiredNrChannels{ anyColour ? (anyAlpha ? 4 : 3) : (anyAlpha ? 2 : 1) };
+	const VkFormat format{ blockCompressed ? ChooseCompressedFormat(_filepaths[0], compressedFileFormat, _formatOverride, _textureType) : ChooseFormat(requiredNrChannels, _formatOverride, _textureType) };
+	const int uploadChannels{ blockCompressed ? requiredNrChannels : GetFormatChannels(format) };
 
-	//Create image array
-	VkImage imageArray{ AllocateImageImpl(VkExtent2D(maxWidth, maxHeight), format, _flags, _arrSize) };
 
-	//Create temporary staging buffer
-	const VkDeviceSize imgSize{ static_cast<VkDeviceSize>(maxWidth * maxHeight * requiredNrChannels) }; //Assume 1 byte per channel
-	VkBuffer stagingBuffer{ bufferFactory.AllocateBuffer(imgSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Created temporary staging buffer of size " + GetFormattedSizeString(imgSize) + "\n");
+	//Create image array
+	//Block-compressed layers bring their own mip chains - the array gets as many levels as every layer has
+	if (blockCompressed && _generateMipmaps)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mipmaps can't be generated for block-compressed images - using the " + std::to_string(storedMipLevels) + " mip level(s) stored in every file\n");
+	}
+	const std::uint32_t mipLevels{ blockCompressed ? storedMipLevels : _generateMipmaps ? static_cast<std::uint32_t>(std::bit_width(static_cast<std::uint32_t>(std::max(maxWidth, maxHeight)))) : 1 };
+	ImageHandle imageArray{ AllocateImageImpl(VkExtent2D(maxWidth, maxHeight), format, _flags, _arrSize, mipLevels) };
+	const bool blitMipmaps{ !blockCompressed && mipLevels > 1 && CanBlitMipmaps(format) };
+	if (!blockCompressed && _formatOverride == VK_FORMAT_UNDEFINED) { images.Get(imageArray)->components = GetChannelSwizzle(uploadChannels); }
 
-	//Copy pixel data to staging buffer
+	//Record the transitions and copies into the upload batch (the pixel data is streamed through the staging ring)
 	//Keep track of number of padding bytes for logging
 	std::uint32_t numPaddingBytes{ 0 };
-	VkCommandBuffer commandBuffer{ commandPool.AllocateCommandBuffer() };
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.pNext = nullptr;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	VkCommandBuffer commandBuffer{ _uploadBatch.GetCommandBuffer() };
 	TransitionImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, _arrSize, imageArray, &commandBuffer);
 	for (std::size_t i{ 0 }; i < _arrSize; ++i)
 	{
 		//Load the data to disk
-		if (_out_metadata != nullptr) { _out_metadata[i] = imageData[i].metadata; }
 		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Image " + std::to_string(i) + ": Loaded " + std::string(_filepaths[i]) + " from disk (" + std::to_string(imageData[i].metadata.width) + "x" + std::to_string(imageData[i].metadata.height) + ", " + std::to_string(imageData[i].metadata.channels) + " channels)\n");
 
-		void* mappedMemory;
-		vkMapMemory(device.GetDevice(), bufferFactory.GetMemory(stagingBuffer), 0, imgSize, 0, &mappedMemory);
-		memcpy(mappedMemory, imageData[i].pixels, imageData[i].metadata.width * imageData[i].metadata.height * imageData[i].metadata.channels);
-		vkUnmapMemory(device.GetDevice(), bufferFactory.GetMemory(stagingBuffer));
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Image " + std::to_string(i) + ": Pixel Data copied to staging buffer\n");
+		if (blockCompressed)
+		{
+			UploadCompressedMipLevels(imageArray, imageData[i], i, mipLevels, _uploadBatch);
+		}
+		else
+		{
+			if (mipLevels > 1 && !blitMipmaps)
+			{
+				std::vector<unsigned char> convertedPixels;
+				const unsigned char* pixels{ ConvertChannelsForUpload(imageData[i], uploadChannels, convertedPixels) };
+				UploadToImage(imageArray, pixels, imageData[i].metadata.width, imageData[i].metadata.height, uploadChannels, i, 0, _uploadBatch); //Assume 1 byte per channel
+				UploadMipmaps(imageArray, pixels, imageData[i].metadata.width, imageData[i].metadata.height, uploadChannels, i, _uploadBatch);
+			}
+			else
+			{
+				UploadToImage(imageArray, imageData[i].pixels, imageData[i].metadata.width, imageData[i].metadata.height, uploadChannels, i, 0, _uploadBatch, 1, imageData[i].metadata.channels);
+			}
+		}
+		imageData[i].metadata.vkFormat = format;
+		imageData[i].metadata.channels = uploadChannels;
+		if (_out_metadata != nullptr) { _out_metadata[i] = imageData[i].metadata; }
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Image " + std::to_string(i) + ": Pixel Data copied to staging ring\n");
 
-		//Free the image data as it's in the staging buffer now
+		//Free the image data as it's in the staging ring now
 		ImageLoader::Free(imageData[i].pixels);
 
-		//Copy the staging buffer to the image
+		const std::size_t currentNumPaddingBytes{ (static_cast<std::size_t>(maxWidth) * maxHeight - static_cast<std::size_t>(imageData[i].metadata.width) * imageData[i].metadata.height) * uploadChannels };
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Image " + std::to_string(i) + ": " + GetFormattedSizeString(currentNumPaddingBytes) + " padding bytes added\n");
+		numPaddingBytes += currentNumPaddingBytes;
+	}
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  " + GetFormattedSizeString(numPaddingBytes) + " total padding bytes added\n");
+
+	FinishUpload(imageArray, blitMipmaps, _uploadBatch);
+
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture array upload recorded to upload batch\n");
+
+	return imageArray;
+}
+
+
+
+ImageHandle ImageFactory::AllocateImageArrayImpl(std::uint32_t _arrSize, const unsigned char* const* _pixels, VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, bool _generateMipmaps, std::uint32_t _maxMipLevels, UploadBatch& _uploadBatch)
+{
+	const int channels{ GetFormatChannels(_format) };
+	const std::uint32_t mipLevels{ _generateMipmaps ? std::clamp(static_cast<std::uint32_t>(std::bit_width(std::max(_size.width, _size.height))), 1u, std::max(_maxMipLevels, 1u)) : 1 };
+	ImageHandle imageArray{ AllocateImageImpl(_size, _format, _flags, _arrSize, mipLevels) };
+	const bool blitMipmaps{ mipLevels > 1 && CanBlitMipmaps(_format) };
+
+	//Record the transitions and copies into the upload batch (the pixel data is streamed through the staging ring)
+	VkCommandBuffer commandBuffer{ _uploadBatch.GetCommandBuffer() };
+	TransitionImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, _arrSize, imageArray, &commandBuffer);
+	for (std::uint32_t i{ 0 }; i < _arrSize; ++i)
+	{
+		UploadToImage(imageArray, _pixels[i], _size.width, _size.height, channels, i, 0, _uploadBatch);
+		if (mipLevels > 1 && !blitMipmaps)
+		{
+			UploadMipmaps(imageArray, _pixels[i], _size.width, _size.height, channels, i, _uploadBatch);
+		}
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Pixel Data copied to staging ring\n");
+
+	FinishUpload(imageArray, blitMipmaps, _uploadBatch);
+
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture array upload recorded to upload batch\n");
+
+	return imageArray;
+}
+
+
+
+void ImageFactory::UploadToImage(ImageHandle _image, const void* _pixels, std::uint32_t _width, std::uint32_t _height, std::uint32_t _texelSize, std::uint32_t _layer, std::uint32_t _mipLevel, UploadBatch& _uploadBatch, std::uint32_t _blockExtent, std::uint32_t _srcChannels)
+{
+	//Stream the image through the staging ring in bands of whole rows (of blocks, for block-compressed formats), so that images larger than the ring can still be uploaded
+	const VkImage image{ GetImage(_image) };
+	StagingRing& ring{ bufferFactory.GetStagingRing() };
+	const std::uint32_t blockColumns{ (_width + _blockExtent - 1) / _blockExtent };
+	const std::uint32_t blockRows{ (_height + _blockExtent - 1) / _blockExtent };
+	const VkDeviceSize rowSize{ static_cast<VkDeviceSize>(blockColumns) * _texelSize };
+	const std::uint32_t rowsPerChunk{ static_cast<std::uint32_t>(std::max<VkDeviceSize>(ring.GetMaxAllocationSize() / rowSize, 1)) };
+
+	//Buffer offsets for buffer-image copies must be a multiple of both 4 and the texel (or block) size
+	const VkDeviceSize alignment{ std::lcm(static_cast<VkDeviceSize>(4), static_cast<VkDeviceSize>(_texelSize)) };
+
+	const unsigned char* src{ static_cast<const unsigned char*>(_pixels) };
+	const bool convert{ _srcChannels != 0 && _srcChannels != _texelSize };
+	const VkDeviceSize srcRowSize{ convert ? static_cast<VkDeviceSize>(_width) * _srcChannels : rowSize };
+	for (std::uint32_t row{ 0 }; row < blockRows; row += rowsPerChunk)
+	{
+		const std::uint32_t rowCount{ std::min(rowsPerChunk, blockRows - row) };
+		const StagingAllocation staging{ ring.Allocate(rowSize * rowCount, alignment, _uploadBatch) };
+		if (convert)
+		{
+			PixelKernels::ConvertChannels(src + srcRowSize * row, static_cast<std::size_t>(_width) * rowCount, static_cast<int>(_srcChannels), static_cast<int>(_texelSize), static_cast<unsigned char*>(staging.mapped));
+		}
+		else
+		{
+			memcpy(staging.mapped, src + rowSize * row, static_cast<std::size_t>(rowSize * rowCount));
+		}
+
+		//The extent is in texels - partial blocks are only allowed where they meet the edge of the image
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = staging.offset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = i;
+		region.imageSubresource.mipLevel = _mipLevel;
+		region.imageSubresource.baseArrayLayer = _layer;
 		region.imageSubresource.layerCount = 1;
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = { static_cast<std::uint32_t>(imageData[i].metadata.width), static_cast<std::uint32_t>(imageData[i].metadata.height), 1 };
-		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, imageArray, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		region.imageOffset = { 0, static_cast<std::int32_t>(row * _blockExtent), 0 };
+		region.imageExtent = { _width, std::min(rowCount * _blockExtent, _height - row * _blockExtent), 1 };
+		_uploadBatch.CopyBufferToImage(staging.buffer, image, 1, &region);
+	}
+}
 
-		const std::size_t currentNumPaddingBytes{ static_cast<std::size_t>((maxWidth - imageData[i].metadata.width) * (maxHeight - imageData[i].metadata.height) * (requiredNrChannels - imageData[i].metadata.channels)) };
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Image " + std::to_string(i) + ": " + GetFormattedSizeString(currentNumPaddingBytes) + " padding bytes added\n");
-		numPaddingBytes += currentNumPaddingBytes;
+
+
+void ImageFactory::UploadCompressedMipLevels(ImageHandle _image, const ImageData& _imageData, std::uint32_t _layer, std::uint32_t _mipLevels, UploadBatch& _uploadBatch)
+{
+	const std::uint32_t blockSize{ ImageLoader::GetBlockSize(_imageData.metadata.vkFormat) };
+	for (std::uint32_t level{ 0 }; level < _mipLevels; ++level)
+	{
+		const ImageMipLevel& mipLevel{ _imageData.mipLevels[level] };
+		UploadToImage(_image, _imageData.pixels + mipLevel.offset, mipLevel.width, mipLevel.height, blockSize, _layer, level, _uploadBatch, 4);
 	}
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  " + GetFormattedSizeString(numPaddingBytes) + " total padding bytes added\n");
+}
 
-	TransitionImage(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, _arrSize, imageArray, &commandBuffer);
-	vkEndCommandBuffer(commandBuffer);
 
-	//Execute the command buffer
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext = nullptr;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-	vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(device.GetGraphicsQueue());
 
-	//Cleanup
-	commandPool.FreeCommandBuffer(commandBuffer);
-	bufferFactory.FreeBuffer(stagingBuffer);
+bool ImageFactory::CanBlitMipmaps(VkFormat _format) const
+{
+	return device.IsFormatSupported(_format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
 
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture data successfully transferred to device local memory\n");
 
-	return imageArray;
+
+void ImageFactory::UploadMipmaps(ImageHandle _image, const unsigned char* _pixels, std::uint32_t _width, std::uint32_t _height, std::uint32_t _channels, std::uint32_t _layer, UploadBatch& _uploadBatch)
+{
+	const VkFormat format{ GetRecord(_image).format };
+	const bool srgb{ format == VK_FORMAT_R8_SRGB || format == VK_FORMAT_R8G8_SRGB || format == VK_FORMAT_R8G8B8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB };
+	const std::uint32_t mipLevels{ GetMipLevels(_image) };
+
+	//Each level is filtered from the one before it - only the previous level needs to be kept around
+	std::vector<unsigned char> previous;
+	std::vector<unsigned char> current;
+	const unsigned char* src{ _pixels };
+	std::uint32_t width{ _width };
+	std::uint32_t height{ _height };
+	for (std::uint32_t level{ 1 }; level < mipLevels; ++level)
+	{
+		const std::uint32_t levelWidth{ std::max(width / 2, 1u) };
+		const std::uint32_t levelHeight{ std::max(height / 2, 1u) };
+		current.resize(static_cast<std::size_t>(levelWidth) * levelHeight * _channels);
+		ImageLoader::Downsample(src, static_cast<int>(width), static_cast<int>(height), static_cast<int>(_channels), srgb, current.data());
+		UploadToImage(_image, current.data(), levelWidth, levelHeight, _channels, _layer, level, _uploadBatch);
+
+		previous.swap(current);
+		src = previous.data();
+		width = levelWidth;
+		height = levelHeight;
+	}
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Generated " + std::to_string(mipLevels - 1) + " mip level" + std::string(mipLevels == 2 ? "" : "s") + " on the CPU (format doesn't support linear blits)\n");
 }
 
 
 
-void ImageFactory::FreeImageImpl(VkImage& _image)
+void ImageFactory::FinishUpload(ImageHandle _image, bool _blitMipmaps, UploadBatch& _uploadBatch)
 {
-	if (imageMemoryMap[_image] != VK_NULL_HANDLE)
+	const ImageRecord& record{ GetRecord(_image) };
+	const VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, record.mipLevels, 0, record.layers };
+	if (!_blitMipmaps)
 	{
-		vkFreeMemory(device.GetDevice(), imageMemoryMap[_image], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
-		imageMemoryMap[_image] = VK_NULL_HANDLE;
+		//Hand the image over to the graphics queue, transitioning it for sampling on the way
+		_uploadBatch.ReleaseImage(record.image, range, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		return;
 	}
-	if (_image != VK_NULL_HANDLE)
+
+	//Blits need the graphics queue - hand the image over still in TRANSFER_DST_OPTIMAL, and transition each level for sampling as the blits finish with it
+	_uploadBatch.ReleaseImage(record.image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	RecordMipmapBlits(_image, _uploadBatch);
+}
+
+
+
+void ImageFactory::RecordMipmapBlits(ImageHandle _image, UploadBatch& _uploadBatch)
+{
+	const ImageRecord& record{ GetRecord(_image) };
+	VkCommandBuffer commandBuffer{ _uploadBatch.GetGraphicsCommandBuffer() };
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = record.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = record.layers;
+
+	std::int32_t width{ static_cast<std::int32_t>(record.extent.width) };
+	std::int32_t height{ static_cast<std::int32_t>(record.extent.height) };
+	for (std::uint32_t level{ 1 }; level < record.mipLevels; ++level)
 	{
-		vkDestroyImage(device.GetDevice(), _image, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		//The previous level has been written (by the upload or the last blit) - make it the blit source
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		const std::int32_t levelWidth{ std::max(width / 2, 1) };
+		const std::int32_t levelHeight{ std::max(height / 2, 1) };
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, record.layers };
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, record.layers };
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+		vkCmdBlitImage(commandBuffer, record.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, record.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		//Nothing else reads from the previous level - it's ready to sample
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		width = levelWidth;
+		height = levelHeight;
+	}
+
+	//The last level is only ever blitted to
+	barrier.subresourceRange.baseMipLevel = record.mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Recorded blits for " + std::to_string(record.mipLevels - 1) + " mip level" + std::string(record.mipLevels == 2 ? "" : "s") + "\n");
+}
+
+
+
+void ImageFactory::FreeImageImpl(ImageHandle& _image)
+{
+	if (const ImageRecord* record{ images.Get(_image) })
+	{
+		vkDestroyImage(device.GetDevice(), record->image, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		vkFreeMemory(device.GetDevice(), record->memory, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		device.GetMemoryTypeSelector().NotifyFree(record->memoryTypeIndex, record->memorySize);
+		RecordBlockFree(memoryStatistics, record->memoryTypeIndex, record->memorySize);
+		RecordFree(memoryStatistics, record->memoryTypeIndex, record->memorySize);
+		images.Erase(_image);
+	}
+	else if (!_image.IsNull())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Attempted to free a stale image handle (the image has already been freed)\n");
+	}
+	_image = {};
+}
+
+
+
+const ImageFactory::ImageRecord& ImageFactory::GetRecord(ImageHandle _image) const
+{
+	const ImageRecord* record{ images.Get(_image) };
+	if (record == nullptr)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, _image.IsNull() ? "  Attempted to use a null image handle\n" : "  Attempted to use a stale image handle (the image has been freed)\n");
+		throw std::runtime_error("");
 	}
-	imageMemoryMap.erase(_image);
-	_image = VK_NULL_HANDLE;
+	return *record;
 }
 
 
 
-VkImageView ImageFactory::CreateImageViewImpl(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags, bool _arrayView, std::uint32_t _layerCount)
+VkImageView ImageFactory::CreateImageViewImpl(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags, bool _arrayView, std::uint32_t _layerCount)
 {
 	//Create image view
 	VkImageView imageView;
@@ -566,18 +1021,15 @@ VkImageView ImageFactory::CreateImageViewImpl(const VkImage& _image, const VkFor
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.pNext = nullptr;
 	viewInfo.flags = 0;
-	viewInfo.image = _image;
+	viewInfo.image = GetImage(_image);
 	viewInfo.viewType = _arrayView ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D; //Todo: add more image types
 	viewInfo.format = _format;
 	viewInfo.subresourceRange.aspectMask = _aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = GetMipLevels(_image);
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = _layerCount;
-	viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewInfo.components = GetRecord(_image).components;
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Creating image view", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkResult result{ vkCreateImageView(device.GetDevice(), &viewInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &imageView) };
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
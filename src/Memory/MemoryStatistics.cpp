@@ -0,0 +1,222 @@
+#include "NekiVK/Memory/MemoryStatistics.h"
+#include "NekiVK/Memory/BufferFactory.h"
+#include "NekiVK/Memory/ImageFactory.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+
+namespace Neki
+{
+
+
+
+//Internal helpers for DumpMemoryReport()
+static std::string GetJSONString(const char* _string);
+static std::string GetJSONMemoryPropertyFlags(VkMemoryPropertyFlags _flags);
+static void WriteJSONStatistics(std::ofstream& _file, const MemoryTypeStatistics& _statistics);
+static void WriteJSONFactory(std::ofstream& _file, const char* _name, const MemoryStatistics& _statistics);
+
+
+
+static void RaisePeaks(MemoryTypeStatistics& _statistics)
+{
+	_statistics.peakBlockCount = std::max(_statistics.peakBlockCount, _statistics.blockCount);
+	_statistics.peakBlockBytes = std::max(_statistics.peakBlockBytes, _statistics.blockBytes);
+	_statistics.peakAllocationCount = std::max(_statistics.peakAllocationCount, _statistics.allocationCount);
+	_statistics.peakAllocationBytes = std::max(_statistics.peakAllocationBytes, _statistics.allocationBytes);
+}
+
+
+
+void RecordBlockAllocation(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size)
+{
+	for (MemoryTypeStatistics* statistics : { &_statistics.memoryTypes[_memoryTypeIndex], &_statistics.total })
+	{
+		++statistics->blockCount;
+		statistics->blockBytes += _size;
+		RaisePeaks(*statistics);
+	}
+}
+
+
+
+void RecordBlockFree(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size)
+{
+	for (MemoryTypeStatistics* statistics : { &_statistics.memoryTypes[_memoryTypeIndex], &_statistics.total })
+	{
+		--statistics->blockCount;
+		statistics->blockBytes -= std::min(statistics->blockBytes, _size);
+	}
+}
+
+
+
+void RecordAllocation(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size)
+{
+	for (MemoryTypeStatistics* statistics : { &_statistics.memoryTypes[_memoryTypeIndex], &_statistics.total })
+	{
+		++statistics->allocationCount;
+		statistics->allocationBytes += _size;
+		RaisePeaks(*statistics);
+	}
+}
+
+
+
+void RecordFree(MemoryStatistics& _statistics, std::uint32_t _memoryTypeIndex, VkDeviceSize _size)
+{
+	for (MemoryTypeStatistics* statistics : { &_statistics.memoryTypes[_memoryTypeIndex], &_statistics.total })
+	{
+		--statistics->allocationCount;
+		statistics->allocationBytes -= std::min(statistics->allocationBytes, _size);
+	}
+}
+
+
+
+void DumpMemoryReport(const VKLogger& _logger, const char* _filepath, const VulkanDevice& _device, const BufferFactory* _bufferFactory, const ImageFactory* _imageFactory)
+{
+	std::ofstream file(_filepath, std::ios::trunc);
+	if (!file.is_open())
+	{
+		_logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, "  Failed to open memory report file (" + std::string(_filepath) + ")\n");
+		throw std::runtime_error("");
+	}
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(_device.GetPhysicalDevice(), &deviceProperties);
+	const MemoryTypeSelector& selector{ _device.GetMemoryTypeSelector() };
+	const VkPhysicalDeviceMemoryProperties& memoryProperties{ selector.GetMemoryProperties() };
+
+	file << "{\n";
+	file << "\t\"device\": " << GetJSONString(deviceProperties.deviceName) << ",\n";
+	file << "\t\"memoryBudgetExtension\": " << (selector.IsMemoryBudgetEnabled() ? "true" : "false") << ",\n";
+
+	//Device-wide heap usage (including memory allocated outside of NekiVK if VK_EXT_memory_budget is enabled)
+	file << "\t\"heaps\": [\n";
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		file << "\t\t{ \"index\": " << i;
+		file << ", \"size\": " << memoryProperties.memoryHeaps[i].size;
+		file << ", \"budget\": " << selector.GetHeapBudget(i);
+		file << ", \"usage\": " << selector.GetHeapUsage(i);
+		file << ", \"deviceLocal\": " << ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false");
+		file << " }" << (i + 1 < memoryProperties.memoryHeapCount ? "," : "") << "\n";
+	}
+	file << "\t],\n";
+
+	file << "\t\"memoryTypes\": [\n";
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		file << "\t\t{ \"index\": " << i;
+		file << ", \"heapIndex\": " << memoryProperties.memoryTypes[i].heapIndex;
+		file << ", \"flags\": " << GetJSONMemoryPropertyFlags(memoryProperties.memoryTypes[i].propertyFlags);
+		file << " }" << (i + 1 < memoryProperties.memoryTypeCount ? "," : "") << "\n";
+	}
+	file << "\t],\n";
+
+	file << "\t\"factories\": {";
+	bool firstFactory{ true };
+	if (_bufferFactory != nullptr)
+	{
+		file << "\n";
+		WriteJSONFactory(file, "BufferFactory", _bufferFactory->GetMemoryStatistics());
+		firstFactory = false;
+	}
+	if (_imageFactory != nullptr)
+	{
+		file << (firstFactory ? "\n" : ",\n");
+		WriteJSONFactory(file, "ImageFactory", _imageFactory->GetMemoryStatistics());
+		firstFactory = false;
+	}
+	file << (firstFactory ? "}\n" : "\n\t}\n");
+	file << "}\n";
+
+	if (!file.good())
+	{
+		_logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, "  Failed to write memory report file (" + std::string(_filepath) + ")\n");
+		throw std::runtime_error("");
+	}
+}
+
+
+
+std::string GetJSONString(const char* _string)
+{
+	std::string jsonString{ "\"" };
+	for (const char* c{ _string }; *c != '\0'; ++c)
+	{
+		if (*c == '"' || *c == '\\') { jsonString += '\\'; }
+		if (static_cast<unsigned char>(*c) < 0x20) { continue; }
+		jsonString += *c;
+	}
+	return jsonString + "\"";
+}
+
+
+
+std::string GetJSONMemoryPropertyFlags(VkMemoryPropertyFlags _flags)
+{
+	std::string flagsString{ "[" };
+	const auto appendFlag{ [&](VkMemoryPropertyFlagBits _flag, const char* _name)
+	{
+		if (!(_flags & _flag)) { return; }
+		flagsString += (flagsString.size() > 1 ? ", \"" : "\"") + std::string(_name) + "\"";
+	} };
+	appendFlag(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "DEVICE_LOCAL");
+	appendFlag(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "HOST_VISIBLE");
+	appendFlag(VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "HOST_COHERENT");
+	appendFlag(VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "HOST_CACHED");
+	appendFlag(VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, "LAZILY_ALLOCATED");
+	appendFlag(VK_MEMORY_PROPERTY_PROTECTED_BIT, "PROTECTED");
+	return flagsString + "]";
+}
+
+
+
+void WriteJSONStatistics(std::ofstream& _file, const MemoryTypeStatistics& _statistics)
+{
+	_file << "\"blockCount\": " << _statistics.blockCount;
+	_file << ", \"blockBytes\": " << _statistics.blockBytes;
+	_file << ", \"allocationCount\": " << _statistics.allocationCount;
+	_file << ", \"allocationBytes\": " << _statistics.allocationBytes;
+	_file << ", \"paddingBytes\": " << _statistics.paddingBytes;
+	_file << ", \"largestBlock\": " << _statistics.largestBlock;
+	_file << ", \"largestFreeRegion\": " << _statistics.largestFreeRegion;
+	_file << ", \"fragmentation\": " << _statistics.fragmentation;
+	_file << ", \"peakBlockCount\": " << _statistics.peakBlockCount;
+	_file << ", \"peakBlockBytes\": " << _statistics.peakBlockBytes;
+	_file << ", \"peakAllocationCount\": " << _statistics.peakAllocationCount;
+	_file << ", \"peakAllocationBytes\": " << _statistics.peakAllocationBytes;
+}
+
+
+
+void WriteJSONFactory(std::ofstream& _file, const char* _name, const MemoryStatistics& _statistics)
+{
+	_file << "\t\t\"" << _name << "\": {\n";
+	_file << "\t\t\t\"total\": { ";
+	WriteJSONStatistics(_file, _statistics.total);
+	_file << " },\n";
+
+	//Only memory types the factory has ever used are listed
+	_file << "\t\t\t\"memoryTypes\": [";
+	bool first{ true };
+	for (std::uint32_t i{ 0 }; i < _statistics.memoryTypeCount; ++i)
+	{
+		if (_statistics.memoryTypes[i].peakBlockCount == 0) { continue; }
+		_file << (first ? "\n" : ",\n") << "\t\t\t\t{ \"index\": " << i << ", ";
+		WriteJSONStatistics(_file, _statistics.memoryTypes[i]);
+		_file << " }";
+		first = false;
+	}
+	_file << (first ? "]\n" : "\n\t\t\t]\n");
+	_file << "\t\t}";
+}
+
+
+
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "NekiVK/Memory/MemoryTypeSelector.h"
+#include "NekiVK/Utils/Strings/format.h"
+
+#include <algorithm>
+#include <bit>
+
+
+namespace Neki
+{
+
+
+
+MemoryTypeSelector::MemoryTypeSelector(const VKLogger& _logger, const VulkanDevice& _device)
+									  : logger(_logger), device(_device)
+{
+	vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &memoryProperties);
+	allocationsSinceQuery = 0;
+
+	//VK_EXT_memory_budget is queried through vkGetPhysicalDeviceMemoryProperties2 (core in 1.1, otherwise from VK_KHR_get_physical_device_properties2)
+	getMemoryProperties2 = nullptr;
+	if (device.IsDeviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+	{
+		const char* functionName{ device.IsInstanceExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) ? "vkGetPhysicalDeviceMemoryProperties2KHR" : "vkGetPhysicalDeviceMemoryProperties2" };
+		getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(vkGetInstanceProcAddr(device.GetInstance(), functionName));
+	}
+
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		heapBudgets[i].budget = (memoryProperties.memoryHeaps[i].size / 5) * 4;
+		heapBudgets[i].usage = 0;
+		heapBudgets[i].allocated = 0;
+		heapBudgets[i].allocatedAtLastQuery = 0;
+	}
+	UpdateBudgets();
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "Memory type selector initialised (" + std::string(getMemoryProperties2 == nullptr ? "estimated heap budgets" : "VK_EXT_memory_budget") + ")\n");
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "  Heap " + std::to_string(i) + ": " + GetFormattedSizeString(memoryProperties.memoryHeaps[i].size) + " (budget: " + GetFormattedSizeString(heapBudgets[i].budget) + ")\n");
+	}
+}
+
+
+
+std::uint32_t MemoryTypeSelector::SelectMemoryType(std::uint32_t _memoryTypeBits, VkMemoryPropertyFlags _requiredFlags, VkMemoryPropertyFlags _preferredFlags, VkDeviceSize _size)
+{
+	if (allocationsSinceQuery >= BUDGET_QUERY_INTERVAL)
+	{
+		UpdateBudgets();
+	}
+
+	std::uint32_t bestIndex{ UINT32_MAX };
+	std::int32_t bestScore{ INT32_MIN };
+	bool bestFitsBudget{ false };
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		//Check if this memory type is allowed and has all of the required flags
+		if (!(_memoryTypeBits & (1u << i))) { continue; }
+		const VkMemoryPropertyFlags flags{ memoryProperties.memoryTypes[i].propertyFlags };
+		if ((flags & _requiredFlags) != _requiredFlags) { continue; }
+
+		//Preferred flags outweigh unwanted ones - a type with a preferred flag and an unwanted one beats a type with neither
+		const std::int32_t score{ std::popcount(flags & _preferredFlags) * 8 - std::popcount(flags & ~(_requiredFlags | _preferredFlags)) };
+		const std::uint32_t heapIndex{ memoryProperties.memoryTypes[i].heapIndex };
+		const bool fitsBudget{ GetHeapUsage(heapIndex) + _size <= heapBudgets[heapIndex].budget };
+
+		//Any type that fits in its heap's budget beats one that doesn't, ties go to the lowest index (drivers order types by preference)
+		if (bestIndex == UINT32_MAX || (fitsBudget && !bestFitsBudget) || (fitsBudget == bestFitsBudget && score > bestScore))
+		{
+			bestIndex = i;
+			bestScore = score;
+			bestFitsBudget = fitsBudget;
+		}
+	}
+
+	if (bestIndex != UINT32_MAX && !bestFitsBudget)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "  All compatible memory heaps are over budget - allocation of " + GetFormattedSizeString(_size) + " may fail (memory type " + std::to_string(bestIndex) + ")\n");
+	}
+	return bestIndex;
+}
+
+
+
+void MemoryTypeSelector::NotifyAllocation(std::uint32_t _memoryTypeIndex, VkDeviceSize _size)
+{
+	heapBudgets[memoryProperties.memoryTypes[_memoryTypeIndex].heapIndex].allocated += _size;
+	++allocationsSinceQuery;
+}
+
+
+
+void MemoryTypeSelector::NotifyFree(std::uint32_t _memoryTypeIndex, VkDeviceSize _size)
+{
+	HeapBudget& heap{ heapBudgets[memoryProperties.memoryTypes[_memoryTypeIndex].heapIndex] };
+	heap.allocated -= std::min(heap.allocated, _size);
+	++allocationsSinceQuery;
+}
+
+
+
+void MemoryTypeSelector::UpdateBudgets()
+{
+	allocationsSinceQuery = 0;
+	if (getMemoryProperties2 == nullptr)
+	{
+		//Without the extension, usage is just whatever NekiVK has allocated
+		for (std::uint32_t i{ 0 }; i < memoryProperties.memoryHeapCount; ++i)
+		{
+			heapBudgets[i].usage = heapBudgets[i].allocated;
+			heapBudgets[i].allocatedAtLastQuery = heapBudgets[i].allocated;
+		}
+		return;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	budgetProperties.pNext = nullptr;
+	VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+	memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties2.pNext = &budgetProperties;
+	getMemoryProperties2(device.GetPhysicalDevice(), &memoryProperties2);
+
+	for (std::uint32_t i{ 0 }; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		//Some drivers report a budget of 0 for heaps they don't track - keep the estimate for those
+		if (budgetProperties.heapBudget[i] != 0)
+		{
+			heapBudgets[i].budget = budgetProperties.heapBudget[i];
+		}
+		heapBudgets[i].usage = budgetProperties.heapUsage[i];
+		heapBudgets[i].allocatedAtLastQuery = heapBudgets[i].allocated;
+	}
+}
+
+
+
+VkDeviceSize MemoryTypeSelector::GetHeapBudget(std::uint32_t _heapIndex) const
+{
+	return heapBudgets[_heapIndex].budget;
+}
+
+
+
+VkDeviceSize MemoryTypeSelector::GetHeapUsage(std::uint32_t _heapIndex) const
+{
+	const HeapBudget& heap{ heapBudgets[_heapIndex] };
+	if (heap.allocated >= heap.allocatedAtLastQuery)
+	{
+		return heap.usage + (heap.allocated - heap.allocatedAtLastQuery);
+	}
+	return heap.usage - std::min(heap.usage, heap.allocatedAtLastQuery - heap.allocated);
+}
+
+
+
+const VkPhysicalDeviceMemoryProperties& MemoryTypeSelector::GetMemoryProperties() const
+{
+	return memoryProperties;
+}
+
+
+
+bool MemoryTypeSelector::IsMemoryBudgetEnabled() const
+{
+	return getMemoryProperties2 != nullptr;
+}
+
+
+
+}
\ No newline at end of file
@@ -1,9 +1,14 @@
 #include "NekiVK/Memory/ModelFactory.h"
 #include "NekiVK/Memory/ImageFactory.h"
+#include "NekiVK/Utils/Allocators/SkylinePacker.h"
+#include "NekiVK/Utils/Pixels/PixelKernels.h"
 #include "NekiVK/Utils/Strings/format.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <map>
 #include <stdexcept>
 
 namespace Neki
@@ -11,15 +16,30 @@ namespace Neki
 
 
 
-ModelFactory::ModelFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, BufferFactory& _bufferFactory, ImageFactory& _imageFactory, VulkanDescriptorPool& _descriptorPool)
-: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), bufferFactory(_bufferFactory), imageFactory(_imageFactory), descriptorPool(_descriptorPool)
+ModelFactory::ModelFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, BufferFactory& _bufferFactory, ImageFactory& _imageFactory, VulkanDescriptorPool& _descriptorPool, MODEL_VERTEX_INPUT _vertexInput, bool _generateMipmaps, MODEL_MATERIAL_LAYOUT _materialLayout, std::uint32_t _atlasMaxTextureSize)
+: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), bufferFactory(_bufferFactory), imageFactory(_imageFactory), descriptorPool(_descriptorPool), vertexInput(_vertexInput), generateMipmaps(_generateMipmaps), materialLayout(_materialLayout), atlasMaxTextureSize(_atlasMaxTextureSize)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::MODEL_FACTORY, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::MODEL_FACTORY, "Initialising Model Factory\n");
 
-	constexpr std::size_t numTextureTypes{ static_cast<std::size_t>(MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES) };
-	VkDescriptorSetLayoutBinding bindings[numTextureTypes];
-	for (std::size_t i{ 0 }; i < numTextureTypes; ++i)
+	if (vertexInput == MODEL_VERTEX_INPUT::DEVICE_ADDRESS && !device.IsBufferDeviceAddressEnabled())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, "  MODEL_VERTEX_INPUT::DEVICE_ADDRESS requires buffer device addresses, which aren't enabled on this device (requires Vulkan 1.2 or VK_KHR_buffer_device_address)\n");
+		throw std::runtime_error("");
+	}
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Vertex input: " + std::string(vertexInput == MODEL_VERTEX_INPUT::DEVICE_ADDRESS ? "device address (vertex pulling)" : "vertex buffer") + "\n");
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Material layout: " + std::string(materialLayout == MODEL_MATERIAL_LAYOUT::PACKED_ORM ? "packed occlusion/roughness/metallic" : "separate") + "\n");
+	if (atlasMaxTextureSize > ATLAS_PAGE_SIZE - 2 * ATLAS_GUTTER)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, "  _atlasMaxTextureSize (" + std::to_string(atlasMaxTextureSize) + ") must leave room for the gutters in a " + std::to_string(ATLAS_PAGE_SIZE) + "x" + std::to_string(ATLAS_PAGE_SIZE) + " atlas page (max " + std::to_string(ATLAS_PAGE_SIZE - 2 * ATLAS_GUTTER) + ")\n");
+		throw std::runtime_error("");
+	}
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Texture atlases: " + std::string(atlasMaxTextureSize == 0 ? "disabled" : "textures up to " + std::to_string(atlasMaxTextureSize) + "x" + std::to_string(atlasMaxTextureSize)) + "\n");
+
+	//Packed materials combine occlusion, roughness, and metallic into one binding (see MODEL_MATERIAL_LAYOUT)
+	const std::size_t numBindings{ materialLayout == MODEL_MATERIAL_LAYOUT::PACKED_ORM ? PACKED_ORM_BINDING_COUNT : static_cast<std::size_t>(MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES) };
+	std::vector<VkDescriptorSetLayoutBinding> bindings(numBindings);
+	for (std::size_t i{ 0 }; i < numBindings; ++i)
 	{
 		//Create binding
 		bindings[i].binding = i;
@@ -34,8 +54,8 @@ ModelFactory::ModelFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDeb
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.pNext = nullptr;
 	layoutInfo.flags = 0;
-	layoutInfo.bindingCount = numTextureTypes;
-	layoutInfo.pBindings = bindings;
+	layoutInfo.bindingCount = bindings.size();
+	layoutInfo.pBindings = bindings.data();
 	if (vkCreateDescriptorSetLayout(device.GetDevice(), &layoutInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &materialDescriptorSetLayout) != VK_SUCCESS)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, "  Failed to create descriptor set layout\n");
@@ -54,24 +74,40 @@ ModelFactory::~ModelFactory()
 
 
 
-GPUModel ModelFactory::LoadModel(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags, const VkBufferUsageFlags _indexBufferFlags, bool _flipImage)
+GPUModel ModelFactory::LoadModel(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags, const VkBufferUsageFlags _indexBufferFlags, bool _flipImage, UploadBatch* _uploadBatch)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "Loading 1 Model (" + std::string(_filepath) + ")\n");
-	return LoadModelImpl(_filepath, _samplers, _vertexBufferFlags, _indexBufferFlags, _flipImage);
+	if (_uploadBatch != nullptr)
+	{
+		return LoadModelImpl(_filepath, _samplers, _vertexBufferFlags, _indexBufferFlags, _flipImage, *_uploadBatch);
+	}
+	const std::unique_ptr<UploadBatch> uploadBatch{ bufferFactory.CreateUploadBatch() };
+	GPUModel gpuModel{ LoadModelImpl(_filepath, _samplers, _vertexBufferFlags, _indexBufferFlags, _flipImage, *uploadBatch) };
+	uploadBatch->Wait();
+	return gpuModel;
 }
 
 
 
-std::vector<GPUModel> ModelFactory::LoadModels(std::uint32_t _count, const char** _filepaths, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>* _samplers, const VkBufferUsageFlags* _vertexBufferFlags, const VkBufferUsageFlags* _indexBufferFlags, bool* _flipImages)
+std::vector<GPUModel> ModelFactory::LoadModels(std::uint32_t _count, const char** _filepaths, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>* _samplers, const VkBufferUsageFlags* _vertexBufferFlags, const VkBufferUsageFlags* _indexBufferFlags, bool* _flipImages, UploadBatch* _uploadBatch)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "Loading " + std::to_string(_count) + " Model" + std::string(_count == 1 ? "" : "s") + "\n");
+
+	//Record all uploads into the one batch so that they're submitted (and waited on) together
+	std::unique_ptr<UploadBatch> ownedUploadBatch{ _uploadBatch == nullptr ? bufferFactory.CreateUploadBatch() : nullptr };
+	UploadBatch& uploadBatch{ _uploadBatch == nullptr ? *ownedUploadBatch : *_uploadBatch };
+
 	std::vector<GPUModel> gpuModels;
 	for (std::size_t i{ 0 }; i < _count; ++i)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, std::string(_filepaths[i]) + "\n");
-		gpuModels.push_back(LoadModelImpl(_filepaths[i], _samplers[i], (_vertexBufferFlags == nullptr ? 0 : _vertexBufferFlags[i]), (_indexBufferFlags == nullptr ? 0 : _indexBufferFlags[i]), (_flipImages == nullptr ? false : _flipImages[i])));
+		gpuModels.push_back(LoadModelImpl(_filepaths[i], _samplers[i], (_vertexBufferFlags == nullptr ? 0 : _vertexBufferFlags[i]), (_indexBufferFlags == nullptr ? 0 : _indexBufferFlags[i]), (_flipImages == nullptr ? false : _flipImages[i]), uploadBatch));
 	}
 
+	if (ownedUploadBatch)
+	{
+		ownedUploadBatch->Wait();
+	}
 	return gpuModels;
 }
 
@@ -84,7 +120,43 @@ VkDescriptorSetLayout ModelFactory::GetMaterialDescriptorSetLayout()
 
 
 
-GPUModel ModelFactory::LoadModelImpl(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags, const VkBufferUsageFlags _indexBufferFlags, bool _flipImage)
+MODEL_VERTEX_INPUT ModelFactory::GetVertexInput() const
+{
+	return vertexInput;
+}
+
+
+
+MODEL_MATERIAL_LAYOUT ModelFactory::GetMaterialLayout() const
+{
+	return materialLayout;
+}
+
+
+
+std::uint32_t ModelFactory::GetMaterialBinding(MODEL_TEXTURE_TYPE _textureType) const
+{
+	if (materialLayout == MODEL_MATERIAL_LAYOUT::SEPARATE)
+	{
+		return static_cast<std::uint32_t>(_textureType);
+	}
+
+	switch (_textureType)
+	{
+	case MODEL_TEXTURE_TYPE::DIFFUSE: return 0;
+	case MODEL_TEXTURE_TYPE::NORMAL: return 1;
+	case MODEL_TEXTURE_TYPE::SPECULAR: return 2;
+	case MODEL_TEXTURE_TYPE::METALLIC:
+	case MODEL_TEXTURE_TYPE::ROUGHNESS:
+	case MODEL_TEXTURE_TYPE::AMBIENT_OCCLUSION: return PACKED_ORM_BINDING;
+	case MODEL_TEXTURE_TYPE::EMISSIVE: return 4;
+	default: return UINT32_MAX;
+	}
+}
+
+
+
+GPUModel ModelFactory::LoadModelImpl(const char* _filepath, std::unordered_map<MODEL_TEXTURE_TYPE, VkSampler>& _samplers, const VkBufferUsageFlags _vertexBufferFlags, const VkBufferUsageFlags _indexBufferFlags, bool _flipImage, UploadBatch& _uploadBatch)
 {
 	//Before doing anything, verify _samplers is populated
 	for (std::uint32_t i{ 0 }; i < static_cast<std::uint32_t>(MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES); ++i)
@@ -100,61 +172,65 @@ GPUModel ModelFactory::LoadModelImpl(const char* _filepath, std::unordered_map<M
 	Model cpuModel{ ModelLoader::Load(_filepath) };
 
 	//Load the mesh data
-	for (const Mesh& cpuMesh : cpuModel.meshes)
+	//All of the model's vertex and index buffers are allocated together so that they're packed into as few regions of memory as possible
+	//(Each buffer is written directly if device-local memory is host-visible, otherwise it's copied from the loader's imported geometry arena or uploaded through the staging ring)
+	const std::size_t meshCount{ cpuModel.meshes.size() };
+	std::vector<const void*> meshData(meshCount * 2);
+	std::vector<VkDeviceSize> meshBufferSizes(meshCount * 2);
+	std::vector<VkBufferUsageFlags> meshBufferUsages(meshCount * 2);
+	const bool pullVertices{ vertexInput == MODEL_VERTEX_INPUT::DEVICE_ADDRESS };
+	for (std::size_t i{ 0 }; i < meshCount; ++i)
 	{
-		GPUMesh gpuMesh{};
+		const Mesh& cpuMesh{ cpuModel.meshes[i] };
+		meshData[i * 2] = cpuMesh.vertices.data();
+		meshBufferSizes[i * 2] = sizeof(ModelVertex) * cpuMesh.vertices.size();
+		meshBufferUsages[i * 2] = (pullVertices ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) | _vertexBufferFlags;
+		meshData[i * 2 + 1] = cpuMesh.indices.data();
+		meshBufferSizes[i * 2 + 1] = sizeof(std::uint32_t) * cpuMesh.indices.size();
+		meshBufferUsages[i * 2 + 1] = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | (pullVertices ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0) | _indexBufferFlags;
+	}
 
+	//Without direct writes, every byte would otherwise be copied into the staging ring before the GPU copies it again - importing the arena lets the GPU copy straight out of it
+	BufferHandle importedGeometry{};
+	if (meshCount > 0 && !bufferFactory.IsDirectWriteAvailable() && bufferFactory.IsHostImportAvailable())
+	{
+		importedGeometry = bufferFactory.ImportHostBuffer(cpuModel.geometry->GetData(), cpuModel.geometry->GetCapacity(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	}
 
-		//Create the vertex buffer
-		VkDeviceSize vertexBufferSize{ sizeof(ModelVertex) * cpuMesh.vertices.size() };
-		gpuMesh.vertexBuffer = bufferFactory.AllocateBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "  Vertex buffer allocated (" + std::to_string(cpuMesh.vertices.size()) + " vertices - " + GetFormattedSizeString(sizeof(ModelVertex) * cpuMesh.vertices.size()) + ")\n");
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Populating vertex buffer\n");
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "    Mapping memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-		void* vertexBufferMap;
-		VkMemoryRequirements vertexBufferMemoryRequirements;
-		vkGetBufferMemoryRequirements(device.GetDevice(), gpuMesh.vertexBuffer, &vertexBufferMemoryRequirements);
-		VkResult result{ vkMapMemory(device.GetDevice(), bufferFactory.GetMemory(gpuMesh.vertexBuffer), 0, vertexBufferMemoryRequirements.size, 0, &vertexBufferMap) };
-		logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-		if (result != VK_SUCCESS)
-		{
-			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
-			throw std::runtime_error("");
-		}
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "    Writing to map\n");
-		memcpy(vertexBufferMap, cpuMesh.vertices.data(), static_cast<std::size_t>(vertexBufferSize));
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "    Buffer memory filled with vertex data\n");
-		vkUnmapMemory(device.GetDevice(), bufferFactory.GetMemory(gpuMesh.vertexBuffer));
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "    Buffer memory unmapped\n");
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Transferring host-side vertex temp-staging-buffer to device-local memory\n");
-		gpuMesh.vertexBuffer = bufferFactory.TransferToDeviceLocalBuffer(gpuMesh.vertexBuffer, true);
-
-
-		//Create the index buffer
-		VkDeviceSize indexBufferSize{ sizeof(std::uint32_t) * cpuMesh.indices.size() };
-		gpuMesh.indexBuffer = bufferFactory.AllocateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "  Index buffer allocated (" + std::to_string(cpuMesh.indices.size()) + " indices - " + GetFormattedSizeString(sizeof(std::uint32_t) * cpuMesh.indices.size()) + ")\n");
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Populating index buffer\n");
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "    Mapping memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-		void* indexBufferMap;
-		VkMemoryRequirements indexBufferMemoryRequirements;
-		vkGetBufferMemoryRequirements(device.GetDevice(), gpuMesh.indexBuffer, &indexBufferMemoryRequirements);
-		result = vkMapMemory(device.GetDevice(), bufferFactory.GetMemory(gpuMesh.indexBuffer), 0, indexBufferMemoryRequirements.size, 0, &indexBufferMap);
-		logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-		if (result != VK_SUCCESS)
-		{
-			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
-			throw std::runtime_error("");
+	std::vector<BufferHandle> meshBuffers;
+	if (!importedGeometry.IsNull())
+	{
+		const std::vector<VkMemoryPropertyFlags> meshBufferMemFlags(meshCount * 2, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		meshBuffers = bufferFactory.AllocateBuffers(static_cast<std::uint32_t>(meshCount * 2), meshBufferSizes.data(), meshBufferUsages.data(), nullptr, meshBufferMemFlags.data());
+		const VkBuffer geometryBuffer{ bufferFactory.GetBuffer(importedGeometry) };
+		const std::byte* geometryData{ static_cast<const std::byte*>(cpuModel.geometry->GetData()) };
+		for (std::size_t i{ 0 }; i < meshCount * 2; ++i)
+		{
+			if (meshBufferSizes[i] == 0) { continue; }
+			const VkDeviceSize srcOffset{ static_cast<VkDeviceSize>(static_cast<const std::byte*>(meshData[i]) - geometryData) };
+			_uploadBatch.CopyBuffer(geometryBuffer, bufferFactory.GetBuffer(meshBuffers[i]), meshBufferSizes[i], srcOffset);
+			_uploadBatch.ReleaseBuffer(bufferFactory.GetBuffer(meshBuffers[i]));
 		}
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "    Writing to map\n");
-		memcpy(indexBufferMap, cpuMesh.indices.data(), static_cast<std::size_t>(indexBufferSize));
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "    Buffer memory filled with vertex data\n");
-		vkUnmapMemory(device.GetDevice(), bufferFactory.GetMemory(gpuMesh.indexBuffer));
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "    Buffer memory unmapped\n");
-		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Transferring host-side vertex temp-staging-buffer to device-local memory\n");
-		gpuMesh.indexBuffer = bufferFactory.TransferToDeviceLocalBuffer(gpuMesh.indexBuffer, true);
-		gpuMesh.indexCount = cpuMesh.indices.size();
 
+		//Deferred frees run before completion callbacks, so the imported memory is released before the callback (and with it the arena) is destroyed
+		_uploadBatch.DeferFree(importedGeometry);
+		_uploadBatch.AddCompletionCallback([geometry{ cpuModel.geometry }]() {});
+	}
+	else if (meshCount > 0)
+	{
+		meshBuffers = bufferFactory.AllocateDeviceLocalBuffers(static_cast<std::uint32_t>(meshCount * 2), meshData.data(), meshBufferSizes.data(), meshBufferUsages.data(), _uploadBatch);
+	}
+
+	for (std::size_t i{ 0 }; i < meshCount; ++i)
+	{
+		const Mesh& cpuMesh{ cpuModel.meshes[i] };
+		GPUMesh gpuMesh{};
+		gpuMesh.vertexBuffer = meshBuffers[i * 2];
+		gpuMesh.indexBuffer = meshBuffers[i * 2 + 1];
+		gpuMesh.vertexAddress = pullVertices ? bufferFactory.GetDeviceAddress(gpuMesh.vertexBuffer) : 0;
+		gpuMesh.indexAddress = pullVertices ? bufferFactory.GetDeviceAddress(gpuMesh.indexBuffer) : 0;
+		gpuMesh.indexCount = cpuMesh.indices.size();
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "  Mesh " + std::to_string(i) + " allocated and populated (" + std::to_string(cpuMesh.vertices.size()) + " vertices - " + GetFormattedSizeString(meshBufferSizes[i * 2]) + ", " + std::to_string(cpuMesh.indices.size()) + " indices - " + GetFormattedSizeString(meshBufferSizes[i * 2 + 1]) + ")\n");
 
 		//Material index
 		gpuMesh.materialIndex = cpuMesh.materialIndex;
@@ -163,27 +239,54 @@ GPUModel ModelFactory::LoadModelImpl(const char* _filepath, std::unordered_map<M
 	}
 
 
-	//Load the material data
+	//Decode every texture the model uses up front, in parallel - AllocateImageArray() then picks the decoded images up from ImageLoader's cache
+	//(Image arrays are still created one texture type at a time below, since each one is recorded into the same upload batch)
+	//The references taken here keep the images cached until every material has been created
+	const bool packOrm{ materialLayout == MODEL_MATERIAL_LAYOUT::PACKED_ORM };
+	const char* fallbackTexturePath{ "NekiVK Resource Files/DebugTexture.png" };
+	std::vector<const char*> texturePaths;
 	for (const Material& cpuMaterial : cpuModel.materials)
 	{
-		//Make a descriptor set where each descriptor corresponds to a texture type
-		//The underlying image is an image array of all textures of the texture type
+		for (const TextureInfo& texInfo : cpuMaterial.textures)
+		{
+			if (texInfo.paths.empty() && !(packOrm && IsPackedOrmType(texInfo.type))) { texturePaths.push_back(fallbackTexturePath); }
+			for (const std::string& path : texInfo.paths) { texturePaths.push_back(path.c_str()); }
+		}
+	}
+	const std::vector<ImageData> decodedTextures{ ImageLoader::LoadMany(static_cast<std::uint32_t>(texturePaths.size()), texturePaths.data(), _flipImage) };
+
+	//Small textures are packed into shared atlases up front, so that materials using them can share image views (and descriptor sets)
+	const std::unordered_map<MODEL_TEXTURE_TYPE, TextureAtlas> atlases{ atlasMaxTextureSize == 0 ? std::unordered_map<MODEL_TEXTURE_TYPE, TextureAtlas>{} : BuildTextureAtlases(cpuModel, fallbackTexturePath, _flipImage, _uploadBatch) };
+
+	//Load the material data
+	std::unordered_map<std::string, VkImageView> packedOrmViews;
+	std::map<std::vector<VkImageView>, VkDescriptorSet> descriptorSets; //Keyed by the views bound at each binding
+	for (std::size_t materialIndex{ 0 }; materialIndex < cpuModel.materials.size(); ++materialIndex)
+	{
+		//Make a descriptor set where each descriptor corresponds to a texture type (or, for packed materials, occlusion/roughness/metallic together)
+		//The underlying image is an image array of all textures of the texture type (or an atlas shared with other materials)
 		//The image view format will be identical to that of the image
+		const Material& cpuMaterial{ cpuModel.materials[materialIndex] };
 		GPUMaterial gpuMaterial{};
-		const std::size_t numTextureTypes{ cpuMaterial.textures.size() }; //cpuMaterial.textures.size() = number of texture types, not number of total textures - textures[MODEL_TEXTURE_TYPE::DIFFUSE] stores all diffuse textures
-		std::vector<VkDescriptorImageInfo> imageInfos(numTextureTypes);
-		for (std::size_t i{ 0 }; i < numTextureTypes; ++i)
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		std::vector<std::uint32_t> imageBindings;
+		for (const TextureInfo& texInfo : cpuMaterial.textures) //cpuMaterial.textures.size() = number of texture types, not number of total textures - textures[MODEL_TEXTURE_TYPE::DIFFUSE] stores all diffuse textures
 		{
+			if (packOrm && IsPackedOrmType(texInfo.type)) { continue; }
 
 			//Create image and image view
-			TextureInfo texInfo{ cpuMaterial.textures[i] };
 			VkImageView imgArrayView{};
-			if (texInfo.paths.empty())
+			const std::unordered_map<MODEL_TEXTURE_TYPE, TextureAtlas>::const_iterator atlas{ atlases.find(texInfo.type) };
+			if (atlas != atlases.end() && atlas->second.regions.contains(materialIndex))
+			{
+				imgArrayView = atlas->second.view;
+				gpuMaterial.atlasRegions[static_cast<std::size_t>(texInfo.type)] = atlas->second.regions.at(materialIndex);
+			}
+			else if (texInfo.paths.empty())
 			{
 				//No textures of this type - use fallback default texture
 				ImageMetadata metadata{};
-				const char* path{ "NekiVK Resource Files/DebugTexture.png" };
-				VkImage imgArray{ imageFactory.AllocateImageArray(1, &path, VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, _flipImage, &metadata) };
+				ImageHandle imgArray{ imageFactory.AllocateImageArray(1, &fallbackTexturePath, VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES, _flipImage, &metadata, &_uploadBatch, generateMipmaps) };
 				imgArrayView = imageFactory.CreateImageView(imgArray, metadata.vkFormat, VK_IMAGE_ASPECT_COLOR_BIT, true, 1);
 			}
 			else
@@ -192,27 +295,51 @@ GPUModel ModelFactory::LoadModelImpl(const char* _filepath, std::unordered_map<M
 				ImageMetadata metadata{};
 				std::vector<const char*> filepathsCStr;
 				for (const std::string& s : texInfo.paths) { filepathsCStr.push_back(s.c_str()); }
-				VkImage imgArray{ imageFactory.AllocateImageArray(texInfo.paths.size(), filepathsCStr.data(), VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_UNDEFINED, texInfo.type, _flipImage, &metadata) };
+				ImageHandle imgArray{ imageFactory.AllocateImageArray(texInfo.paths.size(), filepathsCStr.data(), VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_UNDEFINED, texInfo.type, _flipImage, &metadata, &_uploadBatch, generateMipmaps) };
 				imgArrayView = imageFactory.CreateImageView(imgArray, metadata.vkFormat, VK_IMAGE_ASPECT_COLOR_BIT, true, texInfo.paths.size());
 			}
 
 			//Create image info
-			imageInfos[i].imageView = imgArrayView;
-			imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfos[i].sampler = _samplers[texInfo.type];
+			VkDescriptorImageInfo imageInfo{};
+			imageInfo.imageView = imgArrayView;
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.sampler = _samplers[texInfo.type];
+			imageInfos.push_back(imageInfo);
+			imageBindings.push_back(GetMaterialBinding(texInfo.type));
+		}
+
+		if (packOrm)
+		{
+			VkDescriptorImageInfo imageInfo{};
+			imageInfo.imageView = CreatePackedOrmView(cpuMaterial, _flipImage, _uploadBatch, packedOrmViews);
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.sampler = _samplers[MODEL_TEXTURE_TYPE::ROUGHNESS];
+			imageInfos.push_back(imageInfo);
+			imageBindings.push_back(PACKED_ORM_BINDING);
+		}
+
+		//Reuse the descriptor set of any earlier material bound to the same views (samplers are per texture type, so they always match)
+		std::vector<VkImageView> boundViews(imageInfos.size());
+		for (std::size_t i{ 0 }; i < imageInfos.size(); ++i) { boundViews[i] = imageInfos[i].imageView; }
+		if (const std::map<std::vector<VkImageView>, VkDescriptorSet>::iterator it{ descriptorSets.find(boundViews) }; it != descriptorSets.end())
+		{
+			gpuMaterial.descriptorSet = it->second;
+			gpuModel.materials.push_back(gpuMaterial);
+			continue;
 		}
 
 		//Create descriptor set
 		gpuMaterial.descriptorSet = descriptorPool.AllocateDescriptorSet(materialDescriptorSetLayout);
+		descriptorSets.emplace(boundViews, gpuMaterial.descriptorSet);
 
 		//Bind descriptors
-		std::vector<VkWriteDescriptorSet> descriptorWrites(numTextureTypes);
-		for (std::size_t i{ 0 }; i < numTextureTypes; ++i)
+		std::vector<VkWriteDescriptorSet> descriptorWrites(imageInfos.size());
+		for (std::size_t i{ 0 }; i < imageInfos.size(); ++i)
 		{
 			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrites[i].pNext = nullptr;
 			descriptorWrites[i].dstSet = gpuMaterial.descriptorSet;
-			descriptorWrites[i].dstBinding = i;
+			descriptorWrites[i].dstBinding = imageBindings[i];
 			descriptorWrites[i].dstArrayElement = 0;
 			descriptorWrites[i].descriptorCount = 1;
 			descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -220,13 +347,311 @@ GPUModel ModelFactory::LoadModelImpl(const char* _filepath, std::unordered_map<M
 			descriptorWrites[i].pTexelBufferView = nullptr;
 			descriptorWrites[i].pBufferInfo = nullptr;
 		}
-		vkUpdateDescriptorSets(device.GetDevice(), numTextureTypes, descriptorWrites.data(), 0, nullptr);
+		vkUpdateDescriptorSets(device.GetDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 
 		gpuModel.materials.push_back(gpuMaterial);
 	}
 
+	//Release the up-front references - the images stay cached (within ImageLoader's budget) for other models sharing them
+	for (const ImageData& decodedTexture : decodedTextures)
+	{
+		ImageLoader::Free(decodedTexture.pixels);
+	}
+
 	return gpuModel;
 }
 
 
+
+VkImageView ModelFactory::CreatePackedOrmView(const Material& _material, bool _flipImage, UploadBatch& _uploadBatch, std::unordered_map<std::string, VkImageView>& _packedViews)
+{
+	//Sources in R/G/B order - layer i of the packed image takes the i-th texture of each type (missing textures leave their channel at its default)
+	const std::vector<std::string>* sources[3]{ nullptr, nullptr, nullptr };
+	for (const TextureInfo& texInfo : _material.textures)
+	{
+		if (texInfo.type == MODEL_TEXTURE_TYPE::AMBIENT_OCCLUSION) { sources[0] = &texInfo.paths; }
+		else if (texInfo.type == MODEL_TEXTURE_TYPE::ROUGHNESS) { sources[1] = &texInfo.paths; }
+		else if (texInfo.type == MODEL_TEXTURE_TYPE::METALLIC) { sources[2] = &texInfo.paths; }
+	}
+	std::size_t layerCount{ 1 };
+	for (const std::vector<std::string>* source : sources)
+	{
+		if (source != nullptr) { layerCount = std::max(layerCount, source->size()); }
+	}
+	const auto GetSourcePath{ [&](std::size_t _channel, std::size_t _layer) -> const std::string*
+	{
+		return (sources[_channel] != nullptr && _layer < sources[_channel]->size()) ? &(*sources[_channel])[_layer] : nullptr;
+	} };
+
+	//Materials with identical sources share one packed image
+	std::string key;
+	for (std::size_t layer{ 0 }; layer < layerCount; ++layer)
+	{
+		for (std::size_t channel{ 0 }; channel < 3; ++channel)
+		{
+			const std::string* path{ GetSourcePath(channel, layer) };
+			key += (path == nullptr ? std::string{} : *path) + '\n';
+		}
+	}
+	if (const std::unordered_map<std::string, VkImageView>::iterator it{ _packedViews.find(key) }; it != _packedViews.end())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MODEL_FACTORY, "  Reusing packed occlusion/roughness/metallic texture\n");
+		return it->second;
+	}
+
+	//Load each distinct source once (they were all decoded up front, so these are cache hits)
+	std::unordered_map<std::string, ImageData> images;
+	bool prePacked{ true };
+	for (std::size_t layer{ 0 }; layer < layerCount; ++layer)
+	{
+		for (std::size_t channel{ 0 }; channel < 3; ++channel)
+		{
+			const std::string* path{ GetSourcePath(channel, layer) };
+			if (path == nullptr) { prePacked = false; continue; }
+			if (!images.contains(*path)) { images.emplace(*path, ImageLoader::Load(*path, _flipImage)); }
+			const std::string* occlusionPath{ GetSourcePath(0, layer) };
+			if (occlusionPath == nullptr || *path != *occlusionPath || images.at(*path).metadata.channels < 3) { prePacked = false; }
+		}
+	}
+
+	VkImageView view{};
+	if (prePacked)
+	{
+		//Every layer's occlusion, roughness, and metallic come from the same RGB(A) file - it's already packed, so upload it as-is
+		ImageMetadata metadata{};
+		std::vector<const char*> filepathsCStr;
+		for (const std::string& s : *sources[0]) { filepathsCStr.push_back(s.c_str()); }
+		ImageHandle imgArray{ imageFactory.AllocateImageArray(layerCount, filepathsCStr.data(), VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_UNDEFINED, MODEL_TEXTURE_TYPE::ROUGHNESS, _flipImage, &metadata, &_uploadBatch, generateMipmaps) };
+		view = imageFactory.CreateImageView(imgArray, metadata.vkFormat, VK_IMAGE_ASPECT_COLOR_BIT, true, layerCount);
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "  Occlusion/roughness/metallic texture is already packed - uploaded as-is\n");
+	}
+	else
+	{
+		//Pack on the CPU at the size of the largest source (smaller sources are point-sampled up to it)
+		std::uint32_t width{ 1 };
+		std::uint32_t height{ 1 };
+		for (const std::pair<const std::string, ImageData>& image : images)
+		{
+			if (image.second.metadata.blockCompressed)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MODEL_FACTORY, "  Block-compressed occlusion/roughness/metallic textures can only be used in MODEL_MATERIAL_LAYOUT::PACKED_ORM if they're already packed into one file (" + image.first + ")\n");
+				throw std::runtime_error("");
+			}
+			width = std::max(width, static_cast<std::uint32_t>(image.second.metadata.width));
+			height = std::max(height, static_cast<std::uint32_t>(image.second.metadata.height));
+		}
+
+		//Untextured channels default to unoccluded (R = 255), fully rough (G = 255), and non-metallic (B = 0)
+		constexpr unsigned char DEFAULT_VALUES[3]{ 255, 255, 0 };
+		std::vector<std::vector<unsigned char>> layers(layerCount, std::vector<unsigned char>(static_cast<std::size_t>(width) * height * 4));
+		for (std::size_t layer{ 0 }; layer < layerCount; ++layer)
+		{
+			unsigned char* dst{ layers[layer].data() };
+			for (std::size_t channel{ 0 }; channel < 3; ++channel)
+			{
+				const std::string* path{ GetSourcePath(channel, layer) };
+				const ImageData* src{ path == nullptr ? nullptr : &images.at(*path) };
+
+				//glTF stores occlusion in R, roughness in G, and metallic in B - greyscale sources hold their value in their only colour channel
+				const int srcChannels{ src == nullptr ? 0 : src->metadata.channels };
+				const std::size_t srcChannel{ srcChannels >= 3 ? channel : 0 };
+				for (std::uint32_t y{ 0 }; y < height; ++y)
+				{
+					for (std::uint32_t x{ 0 }; x < width; ++x)
+					{
+						unsigned char value{ DEFAULT_VALUES[channel] };
+						if (src != nullptr)
+						{
+							const std::size_t srcX{ static_cast<std::size_t>(x) * src->metadata.width / width };
+							const std::size_t srcY{ static_cast<std::size_t>(y) * src->metadata.height / height };
+							value = src->pixels[(srcY * src->metadata.width + srcX) * srcChannels + srcChannel];
+						}
+						dst[(static_cast<std::size_t>(y) * width + x) * 4 + channel] = value;
+					}
+				}
+			}
+			for (std::size_t texel{ 0 }; texel < static_cast<std::size_t>(width) * height; ++texel)
+			{
+				dst[texel * 4 + 3] = 255;
+			}
+		}
+
+		//The packed layers are copied into the staging ring during the call, so they can be freed straight after
+		std::vector<const unsigned char*> layerPixels;
+		for (const std::vector<unsigned char>& layer : layers) { layerPixels.push_back(layer.data()); }
+		ImageHandle imgArray{ imageFactory.AllocateImageArray(static_cast<std::uint32_t>(layerCount), layerPixels.data(), VkExtent2D(width, height), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, &_uploadBatch, generateMipmaps) };
+		view = imageFactory.CreateImageView(imgArray, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, true, layerCount);
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "  Occlusion/roughness/metallic textures packed from " + std::to_string(images.size()) + " distinct source(s) (" + std::to_string(width) + "x" + std::to_string(height) + ", " + std::to_string(layerCount) + " layer(s))\n");
+	}
+
+	for (const std::pair<const std::string, ImageData>& image : images)
+	{
+		ImageLoader::Free(image.second.pixels);
+	}
+	_packedViews.emplace(key, view);
+	return view;
+}
+
+
+
+std::unordered_map<MODEL_TEXTURE_TYPE, ModelFactory::TextureAtlas> ModelFactory::BuildTextureAtlases(const Model& _model, const char* _fallbackTexturePath, bool _flipImage, UploadBatch& _uploadBatch)
+{
+	//Atlas entries can't wrap, so materials whose meshes sample outside [0, 1] (e.g.: tiling textures) keep their own image arrays
+	constexpr float UV_EPSILON{ 1e-3f };
+	std::vector<bool> uvsInRange(_model.materials.size(), true);
+	for (const Mesh& mesh : _model.meshes)
+	{
+		if (mesh.materialIndex >= uvsInRange.size() || !uvsInRange[mesh.materialIndex]) { continue; }
+		for (const ModelVertex& vertex : mesh.vertices)
+		{
+			if (vertex.texCoord.x < -UV_EPSILON || vertex.texCoord.x > 1.0f + UV_EPSILON || vertex.texCoord.y < -UV_EPSILON || vertex.texCoord.y > 1.0f + UV_EPSILON)
+			{
+				uvsInRange[mesh.materialIndex] = false;
+				break;
+			}
+		}
+	}
+
+	std::unordered_map<MODEL_TEXTURE_TYPE, TextureAtlas> atlases;
+	for (std::uint32_t type{ 0 }; type < static_cast<std::uint32_t>(MODEL_TEXTURE_TYPE::NUM_MODEL_TEXTURE_TYPES); ++type)
+	{
+		const MODEL_TEXTURE_TYPE textureType{ static_cast<MODEL_TEXTURE_TYPE>(type) };
+		if (materialLayout == MODEL_MATERIAL_LAYOUT::PACKED_ORM && IsPackedOrmType(textureType)) { continue; }
+
+		//Gather the distinct atlasable textures of this type, and the materials using each (they were all decoded up front, so these loads are cache hits)
+		std::vector<ImageData> images;
+		std::vector<std::vector<std::size_t>> users;
+		std::unordered_map<std::string, std::size_t> pathIndices;
+		std::vector<ImageData> rejected;
+		for (std::size_t materialIndex{ 0 }; materialIndex < _model.materials.size(); ++materialIndex)
+		{
+			if (!uvsInRange[materialIndex]) { continue; }
+			for (const TextureInfo& texInfo : _model.materials[materialIndex].textures)
+			{
+				if (texInfo.type != textureType || texInfo.paths.size() > 1) { continue; }
+				const std::string path{ texInfo.paths.empty() ? std::string(_fallbackTexturePath) : texInfo.paths[0] };
+				if (const std::unordered_map<std::string, std::size_t>::iterator it{ pathIndices.find(path) }; it != pathIndices.end())
+				{
+					if (it->second != SIZE_MAX) { users[it->second].push_back(materialIndex); }
+					continue;
+				}
+
+				ImageData image{ ImageLoader::Load(path, _flipImage) };
+				if (image.metadata.blockCompressed || static_cast<std::uint32_t>(image.metadata.width) > atlasMaxTextureSize || static_cast<std::uint32_t>(image.metadata.height) > atlasMaxTextureSize)
+				{
+					pathIndices.emplace(path, SIZE_MAX);
+					rejected.push_back(image);
+					continue;
+				}
+				pathIndices.emplace(path, images.size());
+				images.push_back(image);
+				users.push_back({ materialIndex });
+			}
+		}
+		for (const ImageData& image : rejected) { ImageLoader::Free(image.pixels); }
+
+		//A single texture gains nothing from an atlas
+		if (images.size() < 2)
+		{
+			for (const ImageData& image : images) { ImageLoader::Free(image.pixels); }
+			continue;
+		}
+
+		//Pack tallest first into as many pages as it takes - each entry is padded by its gutter and rounded up to whole gutters, keeping every entry gutter-aligned
+		std::vector<std::size_t> order(images.size());
+		for (std::size_t i{ 0 }; i < order.size(); ++i) { order[i] = i; }
+		std::sort(order.begin(), order.end(), [&](std::size_t _a, std::size_t _b) { return images[_a].metadata.height > images[_b].metadata.height; });
+		const auto PaddedSize{ [](int _size) { return (static_cast<std::uint32_t>(_size) + 2 * ATLAS_GUTTER + ATLAS_GUTTER - 1) / ATLAS_GUTTER * ATLAS_GUTTER; } };
+		struct Placement
+		{
+			std::uint32_t page;
+			std::uint32_t x;
+			std::uint32_t y;
+		};
+		std::vector<Placement> placements(images.size());
+		std::vector<SkylinePacker> pages;
+		for (const std::size_t i : order)
+		{
+			const std::uint32_t paddedWidth{ PaddedSize(images[i].metadata.width) };
+			const std::uint32_t paddedHeight{ PaddedSize(images[i].metadata.height) };
+			std::uint32_t page{ 0 };
+			for (; page < pages.size(); ++page)
+			{
+				if (pages[page].Pack(paddedWidth, paddedHeight, placements[i].x, placements[i].y)) { break; }
+			}
+			if (page == pages.size())
+			{
+				pages.emplace_back(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+				(void)pages.back().Pack(paddedWidth, paddedHeight, placements[i].x, placements[i].y); //Always fits - atlasMaxTextureSize leaves room for the gutters
+			}
+			placements[i].page = page;
+		}
+
+		//Pages are trimmed to the largest area used on any of them (they're layers of one image array, so they share a size)
+		std::uint32_t width{ 0 };
+		std::uint32_t height{ 0 };
+		std::uint64_t usedArea{ 0 };
+		for (const SkylinePacker& page : pages)
+		{
+			width = std::max(width, page.GetUsedWidth());
+			height = std::max(height, page.GetUsedHeight());
+			usedArea += page.GetUsedArea();
+		}
+
+		//Compose the pages as RGBA8 - the gutters (and any rounding slack) repeat the nearest edge texel of their entry
+		std::vector<std::vector<unsigned char>> pagePixels(pages.size(), std::vector<unsigned char>(static_cast<std::size_t>(width) * height * 4, 0));
+		std::vector<unsigned char> rgba;
+		TextureAtlas atlas{};
+		for (std::size_t i{ 0 }; i < images.size(); ++i)
+		{
+			const ImageMetadata& metadata{ images[i].metadata };
+			const std::size_t imageWidth{ static_cast<std::size_t>(metadata.width) };
+			const std::size_t imageHeight{ static_cast<std::size_t>(metadata.height) };
+			rgba.resize(imageWidth * imageHeight * 4);
+			PixelKernels::ConvertChannels(images[i].pixels, imageWidth * imageHeight, metadata.channels, 4, rgba.data());
+
+			const Placement& placement{ placements[i] };
+			const std::uint32_t paddedWidth{ PaddedSize(metadata.width) };
+			const std::uint32_t paddedHeight{ PaddedSize(metadata.height) };
+			unsigned char* dst{ pagePixels[placement.page].data() };
+			for (std::uint32_t y{ 0 }; y < paddedHeight; ++y)
+			{
+				const std::size_t srcY{ static_cast<std::size_t>(std::clamp<std::int64_t>(static_cast<std::int64_t>(y) - ATLAS_GUTTER, 0, static_cast<std::int64_t>(imageHeight) - 1)) };
+				const unsigned char* srcRow{ rgba.data() + srcY * imageWidth * 4 };
+				unsigned char* dstRow{ dst + ((static_cast<std::size_t>(placement.y) + y) * width + placement.x) * 4 };
+				for (std::uint32_t x{ 0 }; x < ATLAS_GUTTER; ++x) { std::memcpy(dstRow + static_cast<std::size_t>(x) * 4, srcRow, 4); }
+				std::memcpy(dstRow + static_cast<std::size_t>(ATLAS_GUTTER) * 4, srcRow, imageWidth * 4);
+				for (std::size_t x{ ATLAS_GUTTER + imageWidth }; x < paddedWidth; ++x) { std::memcpy(dstRow + x * 4, srcRow + (imageWidth - 1) * 4, 4); }
+			}
+
+			TextureAtlasRegion region{};
+			region.uvScale = { static_cast<float>(imageWidth) / width, static_cast<float>(imageHeight) / height };
+			region.uvOffset = { static_cast<float>(placement.x + ATLAS_GUTTER) / width, static_cast<float>(placement.y + ATLAS_GUTTER) / height };
+			region.layer = placement.page;
+			for (const std::size_t materialIndex : users[i]) { atlas.regions.emplace(materialIndex, region); }
+			ImageLoader::Free(images[i].pixels);
+		}
+
+		//Colour maps are sRGB and everything else is linear, as in ImageFactory::AllocateImageArray()
+		//The pages are copied into the staging ring during the call, so they can be freed straight after
+		const VkFormat format{ textureType == MODEL_TEXTURE_TYPE::DIFFUSE ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM };
+		std::vector<const unsigned char*> layerPixels;
+		for (const std::vector<unsigned char>& page : pagePixels) { layerPixels.push_back(page.data()); }
+		ImageHandle imgArray{ imageFactory.AllocateImageArray(static_cast<std::uint32_t>(pages.size()), layerPixels.data(), VkExtent2D(width, height), format, VK_IMAGE_USAGE_SAMPLED_BIT, &_uploadBatch, generateMipmaps, ATLAS_MAX_MIP_LEVELS) };
+		atlas.view = imageFactory.CreateImageView(imgArray, format, VK_IMAGE_ASPECT_COLOR_BIT, true, pages.size());
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MODEL_FACTORY, "  Packed " + std::to_string(images.size()) + " texture(s) of type " + std::to_string(type) + " into " + std::to_string(pages.size()) + " atlas page(s) (" + std::to_string(width) + "x" + std::to_string(height) + ", " + std::to_string(usedArea * 100 / (static_cast<std::uint64_t>(width) * height * pages.size())) + "% occupied)\n");
+		atlases.emplace(textureType, std::move(atlas));
+	}
+
+	return atlases;
+}
+
+
+
+bool ModelFactory::IsPackedOrmType(MODEL_TEXTURE_TYPE _textureType)
+{
+	return _textureType == MODEL_TEXTURE_TYPE::AMBIENT_OCCLUSION || _textureType == MODEL_TEXTURE_TYPE::ROUGHNESS || _textureType == MODEL_TEXTURE_TYPE::METALLIC;
+}
+
+
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "NekiVK/Memory/StagingRing.h"
+#include "NekiVK/Memory/BufferFactory.h"
+#include "NekiVK/Utils/Strings/format.h"
+
+#include <stdexcept>
+
+
+namespace Neki
+{
+
+
+
+StagingRing::StagingRing(const VKLogger& _logger, BufferFactory& _bufferFactory, VkDeviceSize _size)
+						: logger(_logger), bufferFactory(_bufferFactory), size(_size)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Creating " + GetFormattedSizeString(size) + " Staging Ring\n");
+	//Prefer host-cached memory - images are decoded straight into the ring, and decoders (e.g. PNG's unfiltering) read back what they've written, which is very slow from write-combined memory
+	bufferHandle = bufferFactory.AllocateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+	buffer = bufferFactory.GetBuffer(bufferHandle);
+
+	//HOST_VISIBLE memory is persistently mapped, so the pointer stays valid for the ring's entire lifetime
+	mapped = static_cast<char*>(bufferFactory.GetMappedPointer(bufferHandle));
+	head = 0;
+	frontRegionID = 0;
+}
+
+
+
+StagingRing::~StagingRing()
+{
+	if (!regions.empty())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Staging ring destroyed with " + std::to_string(regions.size()) + " region(s) still in flight\n");
+	}
+	bufferFactory.FreeBuffer(bufferHandle);
+}
+
+
+
+StagingAllocation StagingRing::Allocate(VkDeviceSize _size, VkDeviceSize _alignment, UploadBatch& _uploadBatch)
+{
+	if (_size > GetMaxAllocationSize())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Staging allocation of " + GetFormattedSizeString(_size) + " exceeds the staging ring's maximum allocation size (" + GetFormattedSizeString(GetMaxAllocationSize()) + ")\n");
+		throw std::runtime_error("");
+	}
+
+	//Wait on the oldest in-flight batch until there's room (regions retire as their batches complete)
+	VkDeviceSize offset{ FindSpace(_size, _alignment) };
+	while (offset == UINT64_MAX)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Staging ring full - waiting on oldest upload batch\n");
+		regions.front().uploadBatch->Wait();
+		offset = FindSpace(_size, _alignment);
+	}
+
+	regions.push_back({ offset, offset + _size, &_uploadBatch, false });
+	head = offset + _size;
+	const std::uint64_t regionID{ frontRegionID + regions.size() - 1 };
+	_uploadBatch.AddCompletionCallback([this, regionID]() { Retire(regionID); });
+
+	StagingAllocation allocation{};
+	allocation.buffer = buffer;
+	allocation.offset = offset;
+	allocation.size = _size;
+	allocation.mapped = mapped + offset;
+	return allocation;
+}
+
+
+
+VkDeviceSize StagingRing::GetMaxAllocationSize() const
+{
+	return size / 4;
+}
+
+
+
+VkDeviceSize StagingRing::GetSize() const
+{
+	return size;
+}
+
+
+
+VkDeviceSize StagingRing::FindSpace(VkDeviceSize _size, VkDeviceSize _alignment) const
+{
+	if (regions.empty())
+	{
+		return _size <= size ? 0 : UINT64_MAX;
+	}
+
+	//Alignment isn't necessarily a power of two (e.g.: buffer-image copies of 3-byte texels)
+	if (_alignment == 0) { _alignment = 1; }
+	const VkDeviceSize alignedHead{ ((head + _alignment - 1) / _alignment) * _alignment };
+	const VkDeviceSize tail{ regions.front().begin };
+
+	//Not wrapped - free space is [head, size) and [0, tail)
+	if (head > tail)
+	{
+		if (alignedHead + _size <= size) { return alignedHead; }
+		if (_size <= tail) { return 0; }
+		return UINT64_MAX;
+	}
+
+	//Wrapped - free space is [head, tail)
+	if (alignedHead + _size <= tail) { return alignedHead; }
+	return UINT64_MAX;
+}
+
+
+
+void StagingRing::Retire(std::uint64_t _regionID)
+{
+	regions[_regionID - frontRegionID].retired = true;
+
+	//Batches usually complete in submission order, but not always - only reclaim from the front
+	while (!regions.empty() && regions.front().retired)
+	{
+		regions.pop_front();
+		++frontRegionID;
+	}
+	if (regions.empty())
+	{
+		head = 0;
+	}
+}
+
+
+
+}
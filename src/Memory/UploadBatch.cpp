@@ -0,0 +1,448 @@
+#include "NekiVK/Memory/UploadBatch.h"
+#include "NekiVK/Memory/BufferFactory.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Neki
+{
+
+
+
+UploadBatch::UploadBatch(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VulkanCommandPool& _commandPool, VulkanCommandPool* _transferCommandPool, BufferFactory& _bufferFactory)
+						: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), commandPool(_commandPool), transferCommandPool(_transferCommandPool), bufferFactory(_bufferFactory)
+{
+	state = UPLOAD_BATCH_STATE::IDLE;
+	releaseRecorded = false;
+	releaseSemaphore = VK_NULL_HANDLE;
+	transferSemaphore = VK_NULL_HANDLE;
+	completionSemaphore = VK_NULL_HANDLE;
+	signalCompletion = false;
+	if (transferCommandPool != nullptr)
+	{
+		commandBuffer = transferCommandPool->AllocateCommandBuffer();
+		graphicsCommandBuffer = commandPool.AllocateCommandBuffer();
+		releaseCommandBuffer = commandPool.AllocateCommandBuffer();
+	}
+	else
+	{
+		commandBuffer = commandPool.AllocateCommandBuffer();
+		graphicsCommandBuffer = commandBuffer;
+		releaseCommandBuffer = VK_NULL_HANDLE;
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.pNext = nullptr;
+	fenceInfo.flags = 0;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Creating upload batch fence", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	const VkResult result{ vkCreateFence(device.GetDevice(), &fenceInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &fence) };
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		fence = VK_NULL_HANDLE;
+	}
+
+	//The batch's submissions are chained with semaphores so that the graphics queue only takes ownership of uploaded resources once the transfer queue is done with them
+	if (fence != VK_NULL_HANDLE && transferCommandPool != nullptr)
+	{
+		releaseSemaphore = CreateBatchSemaphore("release");
+		transferSemaphore = CreateBatchSemaphore("transfer");
+	}
+
+	if (fence == VK_NULL_HANDLE || (transferCommandPool != nullptr && (releaseSemaphore == VK_NULL_HANDLE || transferSemaphore == VK_NULL_HANDLE)))
+	{
+		if (releaseSemaphore != VK_NULL_HANDLE) { vkDestroySemaphore(device.GetDevice(), releaseSemaphore, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator)); }
+		if (transferSemaphore != VK_NULL_HANDLE) { vkDestroySemaphore(device.GetDevice(), transferSemaphore, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator)); }
+		if (fence != VK_NULL_HANDLE) { vkDestroyFence(device.GetDevice(), fence, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator)); }
+		if (transferCommandPool != nullptr)
+		{
+			transferCommandPool->FreeCommandBuffer(commandBuffer);
+			commandPool.FreeCommandBuffer(graphicsCommandBuffer);
+			commandPool.FreeCommandBuffer(releaseCommandBuffer);
+		}
+		else
+		{
+			commandPool.FreeCommandBuffer(commandBuffer);
+		}
+		throw std::runtime_error("");
+	}
+}
+
+
+
+UploadBatch::~UploadBatch()
+{
+	Wait();
+	if (transferCommandPool != nullptr)
+	{
+		transferCommandPool->FreeCommandBuffer(commandBuffer);
+		commandPool.FreeCommandBuffer(graphicsCommandBuffer);
+		commandPool.FreeCommandBuffer(releaseCommandBuffer);
+		vkDestroySemaphore(device.GetDevice(), releaseSemaphore, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		vkDestroySemaphore(device.GetDevice(), transferSemaphore, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	}
+	else
+	{
+		commandPool.FreeCommandBuffer(commandBuffer);
+	}
+	if (completionSemaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device.GetDevice(), completionSemaphore, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	}
+	vkDestroyFence(device.GetDevice(), fence, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+}
+
+
+
+VkCommandBuffer UploadBatch::GetCommandBuffer()
+{
+	if (state == UPLOAD_BATCH_STATE::SUBMITTED)
+	{
+		Wait();
+	}
+	if (state == UPLOAD_BATCH_STATE::IDLE)
+	{
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.pNext = nullptr;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		if (graphicsCommandBuffer != commandBuffer)
+		{
+			vkBeginCommandBuffer(graphicsCommandBuffer, &beginInfo);
+		}
+		state = UPLOAD_BATCH_STATE::RECORDING;
+	}
+	return commandBuffer;
+}
+
+
+
+VkCommandBuffer UploadBatch::GetGraphicsCommandBuffer()
+{
+	static_cast<void>(GetCommandBuffer());
+	return graphicsCommandBuffer;
+}
+
+
+
+void UploadBatch::CopyBuffer(VkBuffer _srcBuffer, VkBuffer _dstBuffer, VkDeviceSize _size, VkDeviceSize _srcOffset, VkDeviceSize _dstOffset)
+{
+	VkBufferCopy region{};
+	region.srcOffset = _srcOffset;
+	region.dstOffset = _dstOffset;
+	region.size = _size;
+	vkCmdCopyBuffer(GetCommandBuffer(), _srcBuffer, _dstBuffer, 1, &region);
+}
+
+
+
+void UploadBatch::CopyBufferToImage(VkBuffer _srcBuffer, VkImage _dstImage, std::uint32_t _regionCount, const VkBufferImageCopy* _regions)
+{
+	vkCmdCopyBufferToImage(GetCommandBuffer(), _srcBuffer, _dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _regionCount, _regions);
+}
+
+
+
+void UploadBatch::AcquireBuffer(VkBuffer _buffer)
+{
+	static_cast<void>(GetCommandBuffer());
+	//Buffers already passed to ReleaseBuffer() this submission are owned by the transfer queue until the submission (e.g.: a buffer that a copy has just been recorded into)
+	if (transferCommandPool == nullptr || std::find(acquiredBuffers.begin(), acquiredBuffers.end(), _buffer) != acquiredBuffers.end() || std::find(releasedBuffers.begin(), releasedBuffers.end(), _buffer) != releasedBuffers.end())
+	{
+		return;
+	}
+	acquiredBuffers.push_back(_buffer);
+
+	//The release half runs on the graphics queue in a submission of its own, ahead of the transfer commands
+	if (!releaseRecorded)
+	{
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.pNext = nullptr;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(releaseCommandBuffer, &beginInfo);
+		releaseRecorded = true;
+	}
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+	barrier.dstQueueFamilyIndex = static_cast<std::uint32_t>(device.GetTransferQueueFamilyIndex());
+	barrier.buffer = _buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(releaseCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	//The acquire half is recorded straight away so that it comes before any transfer commands using the buffer
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+
+
+void UploadBatch::ReleaseBuffer(VkBuffer _buffer)
+{
+	static_cast<void>(GetCommandBuffer());
+	if (transferCommandPool == nullptr || std::find(releasedBuffers.begin(), releasedBuffers.end(), _buffer) != releasedBuffers.end())
+	{
+		return;
+	}
+	releasedBuffers.push_back(_buffer);
+
+	//The release half is recorded at submission (after any further copies into the buffer), the acquire half goes in straight away so that later graphics commands can use the buffer
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = static_cast<std::uint32_t>(device.GetTransferQueueFamilyIndex());
+	barrier.dstQueueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+	barrier.buffer = _buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+
+
+void UploadBatch::ReleaseImage(VkImage _image, const VkImageSubresourceRange& _range, VkImageLayout _newLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask)
+{
+	static_cast<void>(GetCommandBuffer());
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = _dstAccessMask;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = _newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = _image;
+	barrier.subresourceRange = _range;
+	if (transferCommandPool == nullptr)
+	{
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, _dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	//The layout transition happens once, between the release and the acquire - both halves have to specify it
+	barrier.srcQueueFamilyIndex = static_cast<std::uint32_t>(device.GetTransferQueueFamilyIndex());
+	barrier.dstQueueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+	barrier.dstAccessMask = 0;
+	imageReleases.push_back(barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = _dstAccessMask;
+	vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+
+
+void UploadBatch::DeferFree(BufferHandle _buffer)
+{
+	deferredFrees.push_back(_buffer);
+}
+
+
+
+void UploadBatch::AddCompletionCallback(std::function<void()> _callback)
+{
+	completionCallbacks.push_back(std::move(_callback));
+}
+
+
+
+VkSemaphore UploadBatch::GetCompletionSemaphore()
+{
+	static_cast<void>(GetCommandBuffer());
+	if (completionSemaphore == VK_NULL_HANDLE)
+	{
+		completionSemaphore = CreateBatchSemaphore("completion");
+		if (completionSemaphore == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("");
+		}
+	}
+	signalCompletion = true;
+	return completionSemaphore;
+}
+
+
+
+void UploadBatch::Submit()
+{
+	if (state == UPLOAD_BATCH_STATE::IDLE)
+	{
+		//Nothing was recorded - anything deferred can be cleaned up straight away
+		Complete();
+		return;
+	}
+	if (state == UPLOAD_BATCH_STATE::SUBMITTED)
+	{
+		return;
+	}
+
+	RecordReleases();
+	vkEndCommandBuffer(commandBuffer);
+	vkResetFences(device.GetDevice(), 1, &fence);
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Submitting upload batch", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	VkResult result{ VK_SUCCESS };
+	//The completion semaphore goes on the last submission alongside the fence
+	const VkSemaphore completion{ signalCompletion ? completionSemaphore : VK_NULL_HANDLE };
+	signalCompletion = false;
+	if (transferCommandPool == nullptr)
+	{
+		result = SubmitCommandBuffer(device.GetGraphicsQueue(), commandBuffer, VK_NULL_HANDLE, completion, fence);
+	}
+	else
+	{
+		//Graphics-side releases -> transfer commands -> graphics-side acquires, with the fence on the last so that it covers all three
+		vkEndCommandBuffer(graphicsCommandBuffer);
+		if (releaseRecorded)
+		{
+			vkEndCommandBuffer(releaseCommandBuffer);
+			result = SubmitCommandBuffer(device.GetGraphicsQueue(), releaseCommandBuffer, VK_NULL_HANDLE, releaseSemaphore, VK_NULL_HANDLE);
+		}
+		if (result == VK_SUCCESS)
+		{
+			result = SubmitCommandBuffer(device.GetTransferQueue(), commandBuffer, releaseRecorded ? releaseSemaphore : VK_NULL_HANDLE, transferSemaphore, VK_NULL_HANDLE);
+		}
+		if (result == VK_SUCCESS)
+		{
+			result = SubmitCommandBuffer(device.GetGraphicsQueue(), graphicsCommandBuffer, transferSemaphore, completion, fence);
+		}
+		releaseRecorded = false;
+		acquiredBuffers.clear();
+		releasedBuffers.clear();
+		imageReleases.clear();
+	}
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		throw std::runtime_error("");
+	}
+	state = UPLOAD_BATCH_STATE::SUBMITTED;
+}
+
+
+
+bool UploadBatch::IsComplete()
+{
+	if (state == UPLOAD_BATCH_STATE::SUBMITTED && vkGetFenceStatus(device.GetDevice(), fence) == VK_SUCCESS)
+	{
+		Complete();
+	}
+	return state == UPLOAD_BATCH_STATE::IDLE;
+}
+
+
+
+void UploadBatch::Wait()
+{
+	Submit();
+	if (state == UPLOAD_BATCH_STATE::SUBMITTED)
+	{
+		vkWaitForFences(device.GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+		Complete();
+	}
+}
+
+
+
+void UploadBatch::Complete()
+{
+	state = UPLOAD_BATCH_STATE::IDLE;
+
+	for (BufferHandle& buffer : deferredFrees)
+	{
+		bufferFactory.FreeBuffer(buffer);
+	}
+	deferredFrees.clear();
+
+	//Callbacks may add more callbacks (e.g.: by recording into a new batch), so swap the list out first
+	std::vector<std::function<void()>> callbacks;
+	callbacks.swap(completionCallbacks);
+	for (std::function<void()>& callback : callbacks)
+	{
+		callback();
+	}
+}
+
+
+
+void UploadBatch::RecordReleases()
+{
+	if (releasedBuffers.empty() && imageReleases.empty())
+	{
+		return;
+	}
+
+	std::vector<VkBufferMemoryBarrier> bufferReleases(releasedBuffers.size());
+	for (std::size_t i{ 0 }; i < releasedBuffers.size(); ++i)
+	{
+		bufferReleases[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferReleases[i].pNext = nullptr;
+		bufferReleases[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferReleases[i].dstAccessMask = 0;
+		bufferReleases[i].srcQueueFamilyIndex = static_cast<std::uint32_t>(device.GetTransferQueueFamilyIndex());
+		bufferReleases[i].dstQueueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+		bufferReleases[i].buffer = releasedBuffers[i];
+		bufferReleases[i].offset = 0;
+		bufferReleases[i].size = VK_WHOLE_SIZE;
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+	                     static_cast<std::uint32_t>(bufferReleases.size()), bufferReleases.data(), static_cast<std::uint32_t>(imageReleases.size()), imageReleases.data());
+}
+
+
+
+VkResult UploadBatch::SubmitCommandBuffer(VkQueue _queue, VkCommandBuffer _commandBuffer, VkSemaphore _waitSemaphore, VkSemaphore _signalSemaphore, VkFence _fence) const
+{
+	constexpr VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = _waitSemaphore == VK_NULL_HANDLE ? 0 : 1;
+	submitInfo.pWaitSemaphores = &_waitSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &_commandBuffer;
+	submitInfo.signalSemaphoreCount = _signalSemaphore == VK_NULL_HANDLE ? 0 : 1;
+	submitInfo.pSignalSemaphores = &_signalSemaphore;
+	return vkQueueSubmit(_queue, 1, &submitInfo, _fence);
+}
+
+
+
+VkSemaphore UploadBatch::CreateBatchSemaphore(const char* _name)
+{
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = nullptr;
+	semaphoreInfo.flags = 0;
+	VkSemaphore semaphore{ VK_NULL_HANDLE };
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Creating upload batch " + std::string(_name) + " semaphore", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	const VkResult result{ vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &semaphore) };
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		return VK_NULL_HANDLE;
+	}
+	return semaphore;
+}
+
+
+
+}
\ No newline at end of file
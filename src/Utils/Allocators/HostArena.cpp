@@ -0,0 +1,69 @@
+#include "NekiVK/Utils/Allocators/HostArena.h"
+
+
+namespace Neki
+{
+
+
+
+HostArena::HostArena(std::size_t _size, std::size_t _alignment) : alignment(_alignment)
+{
+	usedSize = 0;
+	capacity = ((_size + alignment - 1) / alignment) * alignment;
+	data = capacity == 0 ? nullptr : static_cast<std::byte*>(::operator new(capacity, std::align_val_t{ alignment }));
+}
+
+
+
+HostArena::~HostArena()
+{
+	if (data != nullptr)
+	{
+		::operator delete(data, std::align_val_t{ alignment });
+	}
+}
+
+
+
+void* HostArena::Allocate(std::size_t _size, std::size_t _alignment)
+{
+	const std::size_t offset{ (usedSize + _alignment - 1) & ~(_alignment - 1) };
+	if (offset + _size > capacity)
+	{
+		return nullptr;
+	}
+	usedSize = offset + _size;
+	return data + offset;
+}
+
+
+
+void* HostArena::GetData() const
+{
+	return data;
+}
+
+
+
+std::size_t HostArena::GetUsedSize() const
+{
+	return usedSize;
+}
+
+
+
+std::size_t HostArena::GetCapacity() const
+{
+	return capacity;
+}
+
+
+
+std::size_t HostArena::GetAlignment() const
+{
+	return alignment;
+}
+
+
+
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "NekiVK/Utils/Allocators/SkylinePacker.h"
+
+#include <algorithm>
+
+namespace Neki
+{
+
+
+
+SkylinePacker::SkylinePacker(std::uint32_t _width, std::uint32_t _height) : width(_width), height(_height)
+{
+	Reset();
+}
+
+
+
+bool SkylinePacker::Pack(std::uint32_t _width, std::uint32_t _height, std::uint32_t& _out_x, std::uint32_t& _out_y)
+{
+	if (_width == 0 || _height == 0 || _width > width || _height > height) { return false; }
+
+	//Pick the position that leaves the rectangle's top edge lowest, breaking ties with the narrowest segment (so wide gaps are kept for wide rectangles)
+	std::size_t bestIndex{ skyline.size() };
+	std::uint32_t bestTop{ UINT32_MAX };
+	std::uint32_t bestSegmentWidth{ UINT32_MAX };
+	std::uint32_t bestY{ 0 };
+	for (std::size_t i{ 0 }; i < skyline.size(); ++i)
+	{
+		std::uint32_t y{};
+		if (!Fits(i, _width, _height, y)) { continue; }
+		if (y + _height < bestTop || (y + _height == bestTop && skyline[i].width < bestSegmentWidth))
+		{
+			bestIndex = i;
+			bestTop = y + _height;
+			bestSegmentWidth = skyline[i].width;
+			bestY = y;
+		}
+	}
+	if (bestIndex == skyline.size()) { return false; }
+
+	//Raise the skyline over the rectangle, trimming (or removing) the segments it now covers
+	const SkylineSegment placed{ skyline[bestIndex].x, bestY + _height, _width };
+	skyline.insert(skyline.begin() + bestIndex, placed);
+	for (std::size_t i{ bestIndex + 1 }; i < skyline.size();)
+	{
+		const std::uint32_t placedRight{ placed.x + placed.width };
+		if (skyline[i].x >= placedRight) { break; }
+		const std::uint32_t overlap{ placedRight - skyline[i].x };
+		if (overlap < skyline[i].width)
+		{
+			skyline[i].x += overlap;
+			skyline[i].width -= overlap;
+			break;
+		}
+		skyline.erase(skyline.begin() + i);
+	}
+
+	//Merge neighbouring segments at the same height
+	for (std::size_t i{ 0 }; i + 1 < skyline.size();)
+	{
+		if (skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	usedWidth = std::max(usedWidth, placed.x + _width);
+	usedHeight = std::max(usedHeight, placed.y);
+	usedArea += static_cast<std::uint64_t>(_width) * _height;
+	_out_x = placed.x;
+	_out_y = bestY;
+	return true;
+}
+
+
+
+void SkylinePacker::Reset()
+{
+	usedWidth = 0;
+	usedHeight = 0;
+	usedArea = 0;
+	skyline.clear();
+	skyline.push_back({ 0, 0, width });
+}
+
+
+
+std::uint32_t SkylinePacker::GetWidth() const
+{
+	return width;
+}
+
+
+
+std::uint32_t SkylinePacker::GetHeight() const
+{
+	return height;
+}
+
+
+
+std::uint32_t SkylinePacker::GetUsedWidth() const
+{
+	return usedWidth;
+}
+
+
+
+std::uint32_t SkylinePacker::GetUsedHeight() const
+{
+	return usedHeight;
+}
+
+
+
+std::uint64_t SkylinePacker::GetUsedArea() const
+{
+	return usedArea;
+}
+
+
+
+bool SkylinePacker::Fits(std::size_t _index, std::uint32_t _width, std::uint32_t _height, std::uint32_t& _out_y) const
+{
+	if (skyline[_index].x + _width > width) { return false; }
+
+	//The rectangle rests on the highest segment beneath it
+	std::uint32_t y{ 0 };
+	std::uint32_t remaining{ _width };
+	for (std::size_t i{ _index }; remaining > 0; ++i)
+	{
+		y = std::max(y, skyline[i].y);
+		if (y + _height > height) { return false; }
+		remaining -= std::min(remaining, skyline[i].width);
+	}
+	_out_y = y;
+	return true;
+}
+
+
+
+}
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "NekiVK/Utils/Allocators/TLSFAllocator.h"
+
+#include <bit>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+TLSFAllocator::TLSFAllocator(std::uint64_t _size) : size(_size)
+{
+	Reset();
+}
+
+
+
+bool TLSFAllocator::Allocate(std::uint64_t _size, std::uint64_t _alignment, TLSFAllocation& _out_allocation)
+{
+	if (_size == 0) { _size = 1; }
+	if (_alignment == 0) { _alignment = 1; }
+
+	//Search for a block that can hold the request even in the worst-case alignment scenario
+	const std::uint32_t nodeIndex{ FindFreeNode(_size + _alignment - 1) };
+	if (nodeIndex == INVALID_NODE)
+	{
+		return false;
+	}
+	RemoveFreeNode(nodeIndex);
+
+	//Split off any leading alignment padding into its own free block
+	const std::uint64_t alignedOffset{ (nodes[nodeIndex].offset + _alignment - 1) & ~(_alignment - 1) };
+	const std::uint64_t padding{ alignedOffset - nodes[nodeIndex].offset };
+	if (padding > 0)
+	{
+		const std::uint32_t paddingNode{ CreateNode(nodes[nodeIndex].offset, padding) };
+		nodes[paddingNode].prevPhysical = nodes[nodeIndex].prevPhysical;
+		nodes[paddingNode].nextPhysical = nodeIndex;
+		if (nodes[nodeIndex].prevPhysical != INVALID_NODE) { nodes[nodes[nodeIndex].prevPhysical].nextPhysical = paddingNode; }
+		nodes[nodeIndex].prevPhysical = paddingNode;
+		nodes[nodeIndex].offset = alignedOffset;
+		nodes[nodeIndex].size -= padding;
+		InsertFreeNode(paddingNode);
+	}
+
+	//Split off the unused tail into its own free block
+	if (nodes[nodeIndex].size > _size)
+	{
+		const std::uint32_t tailNode{ CreateNode(nodes[nodeIndex].offset + _size, nodes[nodeIndex].size - _size) };
+		nodes[tailNode].prevPhysical = nodeIndex;
+		nodes[tailNode].nextPhysical = nodes[nodeIndex].nextPhysical;
+		if (nodes[nodeIndex].nextPhysical != INVALID_NODE) { nodes[nodes[nodeIndex].nextPhysical].prevPhysical = tailNode; }
+		nodes[nodeIndex].nextPhysical = tailNode;
+		nodes[nodeIndex].size = _size;
+		InsertFreeNode(tailNode);
+	}
+
+	nodes[nodeIndex].free = false;
+	usedSize += nodes[nodeIndex].size;
+	++allocationCount;
+
+	_out_allocation.offset = nodes[nodeIndex].offset;
+	_out_allocation.node = nodeIndex;
+	return true;
+}
+
+
+
+void TLSFAllocator::Free(std::uint32_t _node)
+{
+	if (_node >= nodes.size() || nodes[_node].free)
+	{
+		return;
+	}
+
+	usedSize -= nodes[_node].size;
+	--allocationCount;
+	nodes[_node].free = true;
+
+	//Coalesce with the previous physical block
+	const std::uint32_t prev{ nodes[_node].prevPhysical };
+	if (prev != INVALID_NODE && nodes[prev].free)
+	{
+		RemoveFreeNode(prev);
+		nodes[_node].offset = nodes[prev].offset;
+		nodes[_node].size += nodes[prev].size;
+		nodes[_node].prevPhysical = nodes[prev].prevPhysical;
+		if (nodes[_node].prevPhysical != INVALID_NODE) { nodes[nodes[_node].prevPhysical].nextPhysical = _node; }
+		ReleaseNode(prev);
+	}
+
+	//Coalesce with the next physical block
+	const std::uint32_t next{ nodes[_node].nextPhysical };
+	if (next != INVALID_NODE && nodes[next].free)
+	{
+		RemoveFreeNode(next);
+		nodes[_node].size += nodes[next].size;
+		nodes[_node].nextPhysical = nodes[next].nextPhysical;
+		if (nodes[_node].nextPhysical != INVALID_NODE) { nodes[nodes[_node].nextPhysical].prevPhysical = _node; }
+		ReleaseNode(next);
+	}
+
+	InsertFreeNode(_node);
+}
+
+
+
+void TLSFAllocator::Reset()
+{
+	usedSize = 0;
+	allocationCount = 0;
+	flBitmap = 0;
+	std::fill(std::begin(slBitmaps), std::end(slBitmaps), 0u);
+	for (std::uint32_t fl{ 0 }; fl < FL_COUNT; ++fl)
+	{
+		std::fill(std::begin(freeLists[fl]), std::end(freeLists[fl]), INVALID_NODE);
+	}
+	nodes.clear();
+	unusedNodes.clear();
+
+	//The whole range starts off as a single free block
+	if (size > 0)
+	{
+		InsertFreeNode(CreateNode(0, size));
+	}
+}
+
+
+
+std::uint64_t TLSFAllocator::GetSize() const
+{
+	return size;
+}
+
+
+
+std::uint64_t TLSFAllocator::GetUsedSize() const
+{
+	return usedSize;
+}
+
+
+
+std::uint64_t TLSFAllocator::GetLargestFreeRegion() const
+{
+	if (flBitmap == 0)
+	{
+		return 0;
+	}
+
+	//The largest block lives somewhere in the highest non-empty list, but that list isn't sorted - walk it
+	const std::uint32_t fl{ static_cast<std::uint32_t>(63 - std::countl_zero(flBitmap)) };
+	const std::uint32_t sl{ static_cast<std::uint32_t>(31 - std::countl_zero(slBitmaps[fl])) };
+	std::uint64_t largest{ 0 };
+	for (std::uint32_t node{ freeLists[fl][sl] }; node != INVALID_NODE; node = nodes[node].nextFree)
+	{
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+
+
+std::uint32_t TLSFAllocator::GetAllocationCount() const
+{
+	return allocationCount;
+}
+
+
+
+bool TLSFAllocator::IsEmpty() const
+{
+	return allocationCount == 0;
+}
+
+
+
+void TLSFAllocator::MappingInsert(std::uint64_t _size, std::uint32_t& _out_fl, std::uint32_t& _out_sl)
+{
+	//Small sizes are all grouped into the first first-level list, subdivided linearly
+	if (_size < SL_COUNT)
+	{
+		_out_fl = 0;
+		_out_sl = static_cast<std::uint32_t>(_size);
+		return;
+	}
+
+	const std::uint32_t msb{ static_cast<std::uint32_t>(63 - std::countl_zero(_size)) };
+	_out_fl = msb - SL_LOG2 + 1;
+	_out_sl = static_cast<std::uint32_t>(_size >> (msb - SL_LOG2)) - SL_COUNT;
+}
+
+
+
+void TLSFAllocator::MappingSearch(std::uint64_t _size, std::uint32_t& _out_fl, std::uint32_t& _out_sl)
+{
+	//Round the size up to the next second-level boundary so that any block in the resulting list is large enough
+	if (_size >= SL_COUNT)
+	{
+		const std::uint32_t msb{ static_cast<std::uint32_t>(63 - std::countl_zero(_size)) };
+		_size += (1ull << (msb - SL_LOG2)) - 1;
+	}
+	MappingInsert(_size, _out_fl, _out_sl);
+}
+
+
+
+std::uint32_t TLSFAllocator::FindFreeNode(std::uint64_t _size) const
+{
+	std::uint32_t fl;
+	std::uint32_t sl;
+	MappingSearch(_size, fl, sl);
+	if (fl >= FL_COUNT)
+	{
+		return INVALID_NODE;
+	}
+
+	//First check for a suitable list in the same first-level class
+	std::uint32_t slMap{ sl < SL_COUNT ? slBitmaps[fl] & (~0u << sl) : 0u };
+	if (slMap == 0)
+	{
+		//None - move on to the next non-empty first-level class
+		const std::uint64_t flMap{ fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0ull };
+		if (flMap == 0)
+		{
+			return INVALID_NODE;
+		}
+		fl = static_cast<std::uint32_t>(std::countr_zero(flMap));
+		slMap = slBitmaps[fl];
+	}
+	sl = static_cast<std::uint32_t>(std::countr_zero(slMap));
+
+	return freeLists[fl][sl];
+}
+
+
+
+std::uint32_t TLSFAllocator::CreateNode(std::uint64_t _offset, std::uint64_t _size)
+{
+	std::uint32_t index;
+	if (!unusedNodes.empty())
+	{
+		index = unusedNodes.back();
+		unusedNodes.pop_back();
+	}
+	else
+	{
+		index = static_cast<std::uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	nodes[index].offset = _offset;
+	nodes[index].size = _size;
+	nodes[index].prevPhysical = INVALID_NODE;
+	nodes[index].nextPhysical = INVALID_NODE;
+	nodes[index].prevFree = INVALID_NODE;
+	nodes[index].nextFree = INVALID_NODE;
+	nodes[index].free = true;
+	return index;
+}
+
+
+
+void TLSFAllocator::ReleaseNode(std::uint32_t _node)
+{
+	unusedNodes.push_back(_node);
+}
+
+
+
+void TLSFAllocator::InsertFreeNode(std::uint32_t _node)
+{
+	std::uint32_t fl;
+	std::uint32_t sl;
+	MappingInsert(nodes[_node].size, fl, sl);
+
+	//Push to the front of the list
+	nodes[_node].free = true;
+	nodes[_node].prevFree = INVALID_NODE;
+	nodes[_node].nextFree = freeLists[fl][sl];
+	if (freeLists[fl][sl] != INVALID_NODE) { nodes[freeLists[fl][sl]].prevFree = _node; }
+	freeLists[fl][sl] = _node;
+
+	flBitmap |= (1ull << fl);
+	slBitmaps[fl] |= (1u << sl);
+}
+
+
+
+void TLSFAllocator::RemoveFreeNode(std::uint32_t _node)
+{
+	std::uint32_t fl;
+	std::uint32_t sl;
+	MappingInsert(nodes[_node].size, fl, sl);
+
+	if (nodes[_node].prevFree != INVALID_NODE) { nodes[nodes[_node].prevFree].nextFree = nodes[_node].nextFree; }
+	if (nodes[_node].nextFree != INVALID_NODE) { nodes[nodes[_node].nextFree].prevFree = nodes[_node].prevFree; }
+	if (freeLists[fl][sl] == _node)
+	{
+		freeLists[fl][sl] = nodes[_node].nextFree;
+		if (freeLists[fl][sl] == INVALID_NODE)
+		{
+			slBitmaps[fl] &= ~(1u << sl);
+			if (slBitmaps[fl] == 0) { flBitmap &= ~(1ull << fl); }
+		}
+	}
+	nodes[_node].prevFree = INVALID_NODE;
+	nodes[_node].nextFree = INVALID_NODE;
+}
+
+
+
+}
@@ -0,0 +1,157 @@
+#include "NekiVK/Utils/Files/FileView.h"
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Neki
+{
+
+
+
+std::unordered_map<std::string, std::weak_ptr<const FileView>> FileView::openViews;
+std::mutex FileView::openViewsMutex;
+
+
+
+FileView::FileView(const std::string& _filepath) : filepath(_filepath)
+{
+	data = nullptr;
+	size = 0;
+	#if defined(_WIN32)
+		fileHandle = INVALID_HANDLE_VALUE;
+		mappingHandle = nullptr;
+	#endif
+}
+
+
+
+FileView::~FileView()
+{
+	#if defined(_WIN32)
+		if (data != nullptr) { UnmapViewOfFile(data); }
+		if (mappingHandle != nullptr) { CloseHandle(mappingHandle); }
+		if (fileHandle != INVALID_HANDLE_VALUE) { CloseHandle(fileHandle); }
+	#else
+		if (data != nullptr) { munmap(const_cast<unsigned char*>(data), size); }
+	#endif
+}
+
+
+
+std::shared_ptr<const FileView> FileView::Open(const std::string& _filepath, FILE_ACCESS_PATTERN _accessPattern)
+{
+	//The lock is held while mapping, so that two consumers opening the same file at once don't both map it
+	std::lock_guard<std::mutex> lock(openViewsMutex);
+	std::weak_ptr<const FileView>& entry{ openViews[_filepath] };
+	if (std::shared_ptr<const FileView> view{ entry.lock() }) { return view; }
+
+	std::shared_ptr<FileView> view{ new FileView(_filepath) };
+	if (!view->Map(_accessPattern))
+	{
+		openViews.erase(_filepath);
+		return nullptr;
+	}
+	entry = view;
+
+	//Drop entries whose views have all been released, so the map doesn't grow with every file ever opened
+	for (std::unordered_map<std::string, std::weak_ptr<const FileView>>::iterator it{ openViews.begin() }; it != openViews.end();)
+	{
+		it = it->second.expired() ? openViews.erase(it) : std::next(it);
+	}
+
+	return view;
+}
+
+
+
+const unsigned char* FileView::GetData() const
+{
+	return data;
+}
+
+
+
+std::size_t FileView::GetSize() const
+{
+	return size;
+}
+
+
+
+std::span<const unsigned char> FileView::GetBytes() const
+{
+	return { data, size };
+}
+
+
+
+const std::string& FileView::GetFilepath() const
+{
+	return filepath;
+}
+
+
+
+bool FileView::Map(FILE_ACCESS_PATTERN _accessPattern)
+{
+	#if defined(_WIN32)
+		fileHandle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, _accessPattern == FILE_ACCESS_PATTERN::SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) { return false; }
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(fileHandle, &fileSize)) { return false; }
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+		if (size == 0) { return true; } //Empty files can't be mapped
+
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr) { return false; }
+		data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		return data != nullptr;
+	#else
+		const int fd{ open(filepath.c_str(), O_RDONLY | O_CLOEXEC) };
+		if (fd < 0) { return false; }
+		struct stat fileStat{};
+		if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+		{
+			close(fd);
+			return false;
+		}
+		size = static_cast<std::size_t>(fileStat.st_size);
+		if (size == 0) //Empty files can't be mapped
+		{
+			close(fd);
+			return true;
+		}
+
+		//The mapping keeps its own reference to the file, so the descriptor isn't needed past here
+		void* mapping{ mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) };
+		close(fd);
+		if (mapping == MAP_FAILED)
+		{
+			size = 0;
+			return false;
+		}
+		data = static_cast<const unsigned char*>(mapping);
+
+		//Hints only - failures are harmless
+		if (_accessPattern == FILE_ACCESS_PATTERN::SEQUENTIAL)
+		{
+			madvise(mapping, size, MADV_SEQUENTIAL);
+			madvise(mapping, size, MADV_WILLNEED);
+		}
+		else
+		{
+			madvise(mapping, size, MADV_RANDOM);
+		}
+		return true;
+	#endif
+}
+
+
+
+}
\ No newline at end of file
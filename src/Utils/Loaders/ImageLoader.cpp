@@ -1,48 +1,640 @@
 #include "NekiVK/Utils/Loaders/ImageLoader.h"
+#include "NekiVK/Utils/Pixels/PixelKernels.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <stb_image.h>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
 
-std::unordered_map<std::string, ImageData> ImageLoader::imageCache;
+std::unordered_map<ImageLoader::CacheKey, ImageLoader::CacheEntry, ImageLoader::CacheKeyHash> ImageLoader::imageCache;
+std::unordered_map<const unsigned char*, ImageLoader::CacheKey> ImageLoader::pixelKeys;
+std::list<ImageLoader::CacheKey> ImageLoader::unreferencedEntries;
+ImageCacheStatistics ImageLoader::cacheStatistics{ 0, 0, 0, 0, 0, ImageLoader::DEFAULT_CACHE_BUDGET };
+std::mutex ImageLoader::cacheMutex;
+thread_local ImageLoader::DecodeTarget ImageLoader::decodeTarget{ nullptr, 0, false };
 
 
 
-ImageData ImageLoader::Load(const std::string& _filepath, bool _flipImage)
+ImageData ImageLoader::Load(const std::string& _filepath, bool _flipImage, int _desiredChannels)
 {
 	//Return from cache if it exists
-	if (std::unordered_map<std::string, ImageData>::iterator it{ imageCache.find(_filepath) }; it != imageCache.end())
+	const CacheKey key{ _filepath, _flipImage, _desiredChannels };
 	{
-		return it->second;
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (std::unordered_map<CacheKey, CacheEntry, CacheKeyHash>::iterator it{ imageCache.find(key) }; it != imageCache.end())
+		{
+			++cacheStatistics.hits;
+			return AcquireEntry(it->second);
+		}
+		++cacheStatistics.misses;
 	}
 
-	//Load image data
-	stbi_set_flip_vertically_on_load(_flipImage);
+	//Map the whole file so that its magic bytes can pick the decoder - every decoder reads straight from the mapping
+	const std::shared_ptr<const Neki::FileView> view{ OpenFile(_filepath) };
+	const std::span<const unsigned char> file{ view->GetBytes() };
 	ImageData imageData{};
-	imageData.pixels = stbi_load(_filepath.c_str(), &imageData.metadata.width, &imageData.metadata.height, &imageData.metadata.channels, 4); //Todo: don't force 4 channels (my gpu doesn't support 3 though)
-	imageData.metadata.channels = 4;
-	if (!imageData.pixels) { throw std::runtime_error("Failed to load texture image: " + _filepath); }
+	if (IsKTX2(file.data(), file.size()))
+	{
+		imageData = LoadKTX2(_filepath, file);
+	}
+	else if (IsDDS(file.data(), file.size()))
+	{
+		imageData = LoadDDS(_filepath, file);
+	}
+	else
+	{
+		//Load image data (stb's own flip is turned off for this thread - flipping is done with the vectorised row swap instead)
+		stbi_set_flip_vertically_on_load_thread(false);
+		imageData.pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &imageData.metadata.width, &imageData.metadata.height, &imageData.metadata.channels, _desiredChannels);
+		if (_desiredChannels != 0) { imageData.metadata.channels = _desiredChannels; }
+		imageData.metadata.vkFormat = VK_FORMAT_UNDEFINED;
+		imageData.metadata.blockCompressed = false;
+		if (!imageData.pixels) { throw std::runtime_error("Failed to load texture image: " + _filepath); }
+		if (_flipImage) { Neki::PixelKernels::FlipVertically(imageData.pixels, static_cast<std::size_t>(imageData.metadata.width) * imageData.metadata.channels, imageData.metadata.height); }
+	}
+
+	//Add to cache - if another thread loaded the same image in the meantime, keep its copy
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const auto [it, inserted]{ imageCache.try_emplace(key) };
+	if (!inserted)
+	{
+		stbi_image_free(imageData.pixels);
+		return AcquireEntry(it->second);
+	}
+
+	CacheEntry& entry{ it->second };
+	entry.imageData = imageData;
+	entry.size = static_cast<std::size_t>(imageData.metadata.width) * imageData.metadata.height * imageData.metadata.channels;
+	if (imageData.metadata.blockCompressed)
+	{
+		entry.size = 0;
+		for (const ImageMipLevel& mipLevel : imageData.mipLevels) { entry.size += mipLevel.size; }
+	}
+	entry.referenceCount = 1;
+	pixelKeys.emplace(imageData.pixels, key);
+	cacheStatistics.cachedBytes += entry.size;
+	EvictToBudget();
+
+	return imageData;
+}
+
+
+
+std::vector<ImageData> ImageLoader::LoadMany(std::uint32_t _count, const char** _filepaths, bool _flipImage, int _desiredChannels)
+{
+	//Repeated paths are only decoded once - the repeats are picked up from the cache afterwards
+	std::vector<std::uint32_t> uniqueIndices;
+	std::unordered_set<std::string_view> seenPaths;
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		if (seenPaths.insert(_filepaths[i]).second) { uniqueIndices.push_back(i); }
+	}
+
+	//Each worker claims the next undecoded image until there are none left (the calling thread works too)
+	std::vector<ImageData> imageData(_count);
+	std::vector<std::exception_ptr> errors(uniqueIndices.size());
+	std::atomic<std::size_t> nextIndex{ 0 };
+	const auto Work{ [&]()
+	{
+		for (std::size_t i{ nextIndex++ }; i < uniqueIndices.size(); i = nextIndex++)
+		{
+			try { imageData[uniqueIndices[i]] = Load(_filepaths[uniqueIndices[i]], _flipImage, _desiredChannels); }
+			catch (...) { errors[i] = std::current_exception(); }
+		}
+	} };
+	{
+		const std::size_t workerCount{ std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), uniqueIndices.size()) };
+		std::vector<std::jthread> workers;
+		for (std::size_t i{ 1 }; i < workerCount; ++i)
+		{
+			workers.emplace_back(Work);
+		}
+		Work();
+	} //Workers join here
 
-	//Add to cache
-	imageCache[_filepath] = imageData;
+	for (const std::exception_ptr& error : errors)
+	{
+		if (error) { std::rethrow_exception(error); }
+	}
 
+	for (std::uint32_t i{ 0 }; i < _count; ++i)
+	{
+		if (!imageData[i].pixels) { imageData[i] = Load(_filepaths[i], _flipImage, _desiredChannels); }
+	}
 	return imageData;
 }
 
 
 
+ImageMetadata ImageLoader::GetInfo(const std::string& _filepath, bool _flipImage)
+{
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (const std::unordered_map<CacheKey, CacheEntry, CacheKeyHash>::iterator it{ imageCache.find(CacheKey{ _filepath, _flipImage, 0 }) }; it != imageCache.end())
+		{
+			return it->second.imageData.metadata;
+		}
+	}
+
+	//Mapping the file asks the OS to prefetch it, which also warms the page cache for the decode that usually follows
+	//Block-compressed files (and anything stb_image can't identify from its header alone) are loaded in full instead - the caller's own Load() is then a cache hit
+	{
+		const std::shared_ptr<const Neki::FileView> view{ OpenFile(_filepath) };
+		ImageMetadata metadata{};
+		if (!IsKTX2(view->GetData(), view->GetSize()) && !IsDDS(view->GetData(), view->GetSize()) && stbi_info_from_memory(view->GetData(), static_cast<int>(view->GetSize()), &metadata.width, &metadata.height, &metadata.channels))
+		{
+			metadata.vkFormat = VK_FORMAT_UNDEFINED;
+			metadata.blockCompressed = false;
+			return metadata;
+		}
+	}
+
+	const ImageData imageData{ Load(_filepath, _flipImage) };
+	Free(imageData.pixels);
+	return imageData.metadata;
+}
+
+
+
+ImageMetadata ImageLoader::LoadInto(const std::string& _filepath, bool _flipImage, int _channels, unsigned char* _dst, std::size_t _rowPitch)
+{
+	//Copy from the cache if the image has already been decoded (with the requested channel count, or with its own)
+	ImageData cached{};
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for (const int channels : { _channels, 0 })
+		{
+			if (const std::unordered_map<CacheKey, CacheEntry, CacheKeyHash>::iterator it{ imageCache.find(CacheKey{ _filepath, _flipImage, channels }) }; it != imageCache.end() && !it->second.imageData.metadata.blockCompressed)
+			{
+				++cacheStatistics.hits;
+				cached = AcquireEntry(it->second);
+				break;
+			}
+		}
+		if (!cached.pixels) { ++cacheStatistics.misses; }
+	}
+	if (cached.pixels)
+	{
+		const ImageMetadata& cachedMetadata{ cached.metadata };
+		const std::size_t cachedRowSize{ static_cast<std::size_t>(cachedMetadata.width) * cachedMetadata.channels };
+		for (int y{ 0 }; y < cachedMetadata.height; ++y)
+		{
+			Neki::PixelKernels::ConvertChannels(cached.pixels + y * cachedRowSize, cachedMetadata.width, cachedMetadata.channels, _channels, _dst + y * _rowPitch);
+		}
+		ImageMetadata metadata{ cachedMetadata };
+		metadata.channels = _channels;
+		Free(cached.pixels);
+		return metadata;
+	}
+
+	const std::shared_ptr<const Neki::FileView> view{ OpenFile(_filepath) };
+	const std::span<const unsigned char> file{ view->GetBytes() };
+	if (IsKTX2(file.data(), file.size()) || IsDDS(file.data(), file.size())) { throw std::runtime_error("Block-compressed images have no 8-bit texels to decode - use ImageLoader::Load(): " + _filepath); }
+
+	//stb_image has no way to be given an output buffer - it allocates its output itself, at exactly width * height * _channels bytes
+	//So the allocator hands _dst out for the first allocation of that size (the tightly packed image always fits in _dst, whatever _rowPitch is)
+	//Whether the output actually landed there is checked by comparing stb_image's returned pointer against _dst - if something else of that size claimed _dst first, the output is copied across below, so the result is correct either way
+	ImageMetadata metadata{};
+	if (stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &metadata.width, &metadata.height, &metadata.channels) && _rowPitch >= static_cast<std::size_t>(metadata.width) * _channels)
+	{
+		decodeTarget = { _dst, static_cast<std::size_t>(metadata.width) * _channels * metadata.height, false };
+	}
+	stbi_set_flip_vertically_on_load_thread(false);
+	unsigned char* pixels{ stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &metadata.width, &metadata.height, &metadata.channels, _channels) };
+	decodeTarget = { nullptr, 0, false };
+	if (!pixels) { throw std::runtime_error("Failed to load texture image: " + _filepath); }
+	metadata.channels = _channels;
+	metadata.vkFormat = VK_FORMAT_UNDEFINED;
+	metadata.blockCompressed = false;
+
+	const std::size_t rowSize{ static_cast<std::size_t>(metadata.width) * _channels };
+	if (pixels == _dst)
+	{
+		if (_flipImage) { Neki::PixelKernels::FlipVertically(_dst, rowSize, metadata.height); }
+
+		//Spread the tightly packed rows out to _rowPitch in place - last row first, so that no row is overwritten before it's been moved
+		if (_rowPitch != rowSize)
+		{
+			for (int y{ metadata.height - 1 }; y > 0; --y)
+			{
+				std::memmove(_dst + y * _rowPitch, _dst + y * rowSize, rowSize);
+			}
+		}
+	}
+	else
+	{
+		for (int y{ 0 }; y < metadata.height; ++y)
+		{
+			const int srcRow{ _flipImage ? metadata.height - 1 - y : y };
+			std::memcpy(_dst + y * _rowPitch, pixels + srcRow * rowSize, rowSize);
+		}
+		stbi_image_free(pixels);
+	}
+	return metadata;
+}
+
+
+
 void ImageLoader::Free(void* _pixels)
 {
-	//Remove from cache
-	for (std::pair<std::string, ImageData> imgCacheEntry : imageCache)
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const std::unordered_map<const unsigned char*, CacheKey>::iterator keyIt{ pixelKeys.find(static_cast<const unsigned char*>(_pixels)) };
+	if (keyIt == pixelKeys.end())
+	{
+		//Not from Load() - block-compressed data is allocated with std::malloc, which stbi_image_free() releases with std::free
+		stbi_image_free(_pixels);
+		return;
+	}
+
+	//Once nothing references the image, it becomes the most recently released candidate for eviction
+	CacheEntry& entry{ imageCache.at(keyIt->second) };
+	if (--entry.referenceCount == 0)
+	{
+		unreferencedEntries.push_front(keyIt->second);
+		entry.lruPosition = unreferencedEntries.begin();
+		EvictToBudget();
+	}
+}
+
+
+
+void ImageLoader::SetCacheBudget(std::size_t _bytes)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	cacheStatistics.budget = _bytes;
+	EvictToBudget();
+}
+
+
+
+ImageCacheStatistics ImageLoader::GetCacheStatistics()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	ImageCacheStatistics statistics{ cacheStatistics };
+	statistics.cachedImages = imageCache.size();
+	return statistics;
+}
+
+
+
+void ImageLoader::Downsample(const unsigned char* _src, int _width, int _height, int _channels, bool _srgb, unsigned char* _dst)
+{
+	//sRGB -> linear for every 8-bit value, built once
+	static const std::array<float, 256> srgbToLinear{ []()
+	{
+		std::array<float, 256> table{};
+		for (std::size_t i{ 0 }; i < table.size(); ++i)
+		{
+			const float c{ static_cast<float>(i) / 255.0f };
+			table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return table;
+	}() };
+
+	const int dstWidth{ std::max(_width / 2, 1) };
+	const int dstHeight{ std::max(_height / 2, 1) };
+	for (int y{ 0 }; y < dstHeight; ++y)
+	{
+		//Odd dimensions clamp to the last row/column rather than reading past the edge
+		const int y0{ std::min(y * 2, _height - 1) };
+		const int y1{ std::min(y * 2 + 1, _height - 1) };
+		for (int x{ 0 }; x < dstWidth; ++x)
+		{
+			const int x0{ std::min(x * 2, _width - 1) };
+			const int x1{ std::min(x * 2 + 1, _width - 1) };
+			const unsigned char* texels[4]{ _src + (static_cast<std::size_t>(y0) * _width + x0) * _channels, _src + (static_cast<std::size_t>(y0) * _width + x1) * _channels,
+			                                _src + (static_cast<std::size_t>(y1) * _width + x0) * _channels, _src + (static_cast<std::size_t>(y1) * _width + x1) * _channels };
+			unsigned char* out{ _dst + (static_cast<std::size_t>(y) * dstWidth + x) * _channels };
+			for (int c{ 0 }; c < _channels; ++c)
+			{
+				if (_srgb && c < 3)
+				{
+					const float linear{ (srgbToLinear[texels[0][c]] + srgbToLinear[texels[1][c]] + srgbToLinear[texels[2][c]] + srgbToLinear[texels[3][c]]) * 0.25f };
+					const float encoded{ linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f };
+					out[c] = static_cast<unsigned char>(std::clamp(encoded * 255.0f + 0.5f, 0.0f, 255.0f));
+				}
+				else
+				{
+					out[c] = static_cast<unsigned char>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+
+
+std::uint32_t ImageLoader::GetBlockSize(VkFormat _format)
+{
+	switch (_format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+
+
+void* ImageLoader::DecodeMalloc(std::size_t _size)
+{
+	if (decodeTarget.pointer != nullptr && !decodeTarget.inUse && _size == decodeTarget.size)
+	{
+		decodeTarget.inUse = true;
+		return decodeTarget.pointer;
+	}
+	return std::malloc(_size);
+}
+
+
+
+void* ImageLoader::DecodeRealloc(void* _pointer, std::size_t _size)
+{
+	//The destination can't grow - move its contents to the heap instead
+	if (_pointer != nullptr && _pointer == decodeTarget.pointer)
+	{
+		void* moved{ std::malloc(_size) };
+		if (moved != nullptr) { std::memcpy(moved, _pointer, std::min(_size, decodeTarget.size)); }
+		decodeTarget.inUse = false;
+		return moved;
+	}
+	return std::realloc(_pointer, _size);
+}
+
+
+
+void ImageLoader::DecodeFree(void* _pointer)
+{
+	if (_pointer != nullptr && _pointer == decodeTarget.pointer)
+	{
+		decodeTarget.inUse = false;
+		return;
+	}
+	std::free(_pointer);
+}
+
+
+
+std::shared_ptr<const Neki::FileView> ImageLoader::OpenFile(const std::string& _filepath)
+{
+	std::shared_ptr<const Neki::FileView> view{ Neki::FileView::Open(_filepath) };
+	if (!view) { throw std::runtime_error("Failed to load texture image: " + _filepath); }
+	return view;
+}
+
+
+
+bool ImageLoader::IsKTX2(const unsigned char* _data, std::size_t _size)
+{
+	static constexpr unsigned char KTX2_IDENTIFIER[12]{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	return _size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(_data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+
+
+bool ImageLoader::IsDDS(const unsigned char* _data, std::size_t _size)
+{
+	return _size >= 4 && std::memcmp(_data, "DDS ", 4) == 0;
+}
+
+
+
+ImageData ImageLoader::LoadKTX2(const std::string& _filepath, std::span<const unsigned char> _file)
+{
+	//80-byte header followed by the level index (byte offset, byte length, and uncompressed byte length for each level, level 0 first)
+	constexpr std::size_t HEADER_SIZE{ 80 };
+	constexpr std::size_t LEVEL_INDEX_ENTRY_SIZE{ 24 };
+	if (_file.size() < HEADER_SIZE) { throw std::runtime_error("Truncated KTX2 file: " + _filepath); }
+
+	const VkFormat format{ static_cast<VkFormat>(ReadU32(_file, 12)) };
+	const std::uint32_t width{ ReadU32(_file, 20) };
+	const std::uint32_t height{ ReadU32(_file, 24) };
+	const std::uint32_t depth{ ReadU32(_file, 28) };
+	const std::uint32_t layerCount{ ReadU32(_file, 32) };
+	const std::uint32_t faceCount{ ReadU32(_file, 36) };
+	const std::uint32_t levelCount{ std::max(ReadU32(_file, 40), 1u) }; //0 asks the loader to generate the mip chain - only level 0 is stored
+	const std::uint32_t supercompressionScheme{ ReadU32(_file, 44) };
+
+	if (GetBlockSize(format) == 0) { throw std::runtime_error("Unsupported KTX2 format (" + std::to_string(format) + ") - only BC1, BC3, BC4, BC5, and BC7 are supported: " + _filepath); }
+	if (supercompressionScheme != 0) { throw std::runtime_error("Supercompressed KTX2 files are not supported: " + _filepath); }
+	if (depth > 1 || layerCount > 1 || faceCount != 1) { throw std::runtime_error("Only single-layer 2D KTX2 textures are supported: " + _filepath); }
+	if (levelCount > GetMaxLevelCount(width, height)) { throw std::runtime_error("Unsupported KTX2 mip level count (" + std::to_string(levelCount) + "): " + _filepath); }
+	if (_file.size() < HEADER_SIZE + static_cast<std::size_t>(levelCount) * LEVEL_INDEX_ENTRY_SIZE) { throw std::runtime_error("Truncated KTX2 file: " + _filepath); }
+
+	std::vector<std::size_t> levelOffsets(levelCount);
+	std::vector<std::size_t> levelSizes(levelCount);
+	for (std::uint32_t i{ 0 }; i < levelCount; ++i)
+	{
+		levelOffsets[i] = static_cast<std::size_t>(ReadU64(_file, HEADER_SIZE + i * LEVEL_INDEX_ENTRY_SIZE));
+		levelSizes[i] = static_cast<std::size_t>(ReadU64(_file, HEADER_SIZE + i * LEVEL_INDEX_ENTRY_SIZE + 8));
+	}
+
+	return CreateCompressedImageData(_filepath, _file, format, width, height, levelOffsets, levelSizes);
+}
+
+
+
+ImageData ImageLoader::LoadDDS(const std::string& _filepath, std::span<const unsigned char> _file)
+{
+	//"DDS " magic, then a 124-byte header - followed by a 20-byte DX10 header if the pixel format's FourCC is "DX10"
+	constexpr std::size_t HEADER_END{ 128 };
+	constexpr std::size_t DX10_HEADER_END{ 148 };
+	constexpr std::uint32_t DDSD_MIPMAPCOUNT{ 0x20000 };
+	constexpr std::uint32_t DDSCAPS2_CUBEMAP{ 0x200 };
+	constexpr std::uint32_t DDSCAPS2_VOLUME{ 0x200000 };
+	constexpr std::uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D{ 3 };
+	constexpr std::uint32_t D3D10_RESOURCE_MISC_TEXTURECUBE{ 0x4 };
+	constexpr auto FourCC{ [](const char* _code){ return static_cast<std::uint32_t>(_code[0]) | (static_cast<std::uint32_t>(_code[1]) << 8) | (static_cast<std::uint32_t>(_code[2]) << 16) | (static_cast<std::uint32_t>(_code[3]) << 24); } };
+	if (_file.size() < HEADER_END) { throw std::runtime_error("Truncated DDS file: " + _filepath); }
+
+	const std::uint32_t flags{ ReadU32(_file, 8) };
+	const std::uint32_t height{ ReadU32(_file, 12) };
+	const std::uint32_t width{ ReadU32(_file, 16) };
+	const std::uint32_t levelCount{ (flags & DDSD_MIPMAPCOUNT) ? std::max(ReadU32(_file, 28), 1u) : 1u };
+	const std::uint32_t fourCC{ ReadU32(_file, 84) };
+	const std::uint32_t caps2{ ReadU32(_file, 112) };
+	if (levelCount > GetMaxLevelCount(width, height)) { throw std::runtime_error("Unsupported DDS mip level count (" + std::to_string(levelCount) + "): " + _filepath); }
+	if (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) { throw std::runtime_error("Only single-layer 2D DDS textures are supported: " + _filepath); }
+
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	std::size_t dataOffset{ HEADER_END };
+	if (fourCC == FourCC("DX10"))
 	{
-		if (imgCacheEntry.second.pixels == _pixels)
+		if (_file.size() < DX10_HEADER_END) { throw std::runtime_error("Truncated DDS file: " + _filepath); }
+		if (ReadU32(_file, 132) != D3D10_RESOURCE_DIMENSION_TEXTURE2D || (ReadU32(_file, 136) & D3D10_RESOURCE_MISC_TEXTURECUBE) || ReadU32(_file, 140) > 1)
 		{
-			imageCache.erase(imgCacheEntry.first);
-			break;
+			throw std::runtime_error("Only single-layer 2D DDS textures are supported: " + _filepath);
 		}
+
+		//DXGI_FORMAT values
+		switch (ReadU32(_file, 128))
+		{
+		case 71: format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+		case 72: format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+		case 77: format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+		case 78: format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+		case 80: format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+		case 81: format = VK_FORMAT_BC4_SNORM_BLOCK; break;
+		case 83: format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+		case 84: format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+		case 98: format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+		case 99: format = VK_FORMAT_BC7_SRGB_BLOCK; break;
+		default: break;
+		}
+		dataOffset = DX10_HEADER_END;
+	}
+	else if (fourCC == FourCC("DXT1")) { format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; }
+	else if (fourCC == FourCC("DXT5")) { format = VK_FORMAT_BC3_UNORM_BLOCK; }
+	else if (fourCC == FourCC("ATI1") || fourCC == FourCC("BC4U")) { format = VK_FORMAT_BC4_UNORM_BLOCK; }
+	else if (fourCC == FourCC("BC4S")) { format = VK_FORMAT_BC4_SNORM_BLOCK; }
+	else if (fourCC == FourCC("ATI2") || fourCC == FourCC("BC5U")) { format = VK_FORMAT_BC5_UNORM_BLOCK; }
+	else if (fourCC == FourCC("BC5S")) { format = VK_FORMAT_BC5_SNORM_BLOCK; }
+	if (format == VK_FORMAT_UNDEFINED) { throw std::runtime_error("Unsupported DDS format - only BC1, BC3, BC4, BC5, and BC7 are supported: " + _filepath); }
+
+	//Mip levels are stored contiguously, largest first
+	const std::size_t blockSize{ GetBlockSize(format) };
+	std::vector<std::size_t> levelOffsets(levelCount);
+	std::vector<std::size_t> levelSizes(levelCount);
+	for (std::uint32_t i{ 0 }; i < levelCount; ++i)
+	{
+		const std::size_t blocksWide{ (std::max(width >> i, 1u) + 3) / 4 };
+		const std::size_t blocksHigh{ (std::max(height >> i, 1u) + 3) / 4 };
+		levelOffsets[i] = dataOffset;
+		levelSizes[i] = blocksWide * blocksHigh * blockSize;
+		dataOffset += levelSizes[i];
+	}
+
+	return CreateCompressedImageData(_filepath, _file, format, width, height, levelOffsets, levelSizes);
+}
+
+
+
+ImageData ImageLoader::CreateCompressedImageData(const std::string& _filepath, std::span<const unsigned char> _file, VkFormat _format, std::uint32_t _width, std::uint32_t _height, const std::vector<std::size_t>& _levelOffsets, const std::vector<std::size_t>& _levelSizes)
+{
+	if (_width == 0 || _height == 0) { throw std::runtime_error("Texture image has no size: " + _filepath); }
+	if (_levelOffsets.size() > GetMaxLevelCount(_width, _height)) { throw std::runtime_error("Unsupported texture image mip level count (" + std::to_string(_levelOffsets.size()) + "): " + _filepath); }
+
+	ImageData imageData{};
+	imageData.mipLevels.resize(_levelOffsets.size());
+	std::size_t totalSize{ 0 };
+	for (std::size_t i{ 0 }; i < _levelOffsets.size(); ++i)
+	{
+		const std::uint32_t levelWidth{ std::max(_width >> i, 1u) };
+		const std::uint32_t levelHeight{ std::max(_height >> i, 1u) };
+		const std::size_t expectedSize{ static_cast<std::size_t>((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * GetBlockSize(_format) };
+		if (_levelOffsets[i] > _file.size() || _levelSizes[i] > _file.size() - _levelOffsets[i] || _levelSizes[i] < expectedSize) { throw std::runtime_error("Truncated texture image: " + _filepath); }
+		imageData.mipLevels[i].offset = totalSize;
+		imageData.mipLevels[i].size = _levelSizes[i];
+		imageData.mipLevels[i].width = static_cast<int>(levelWidth);
+		imageData.mipLevels[i].height = static_cast<int>(levelHeight);
+		totalSize += _levelSizes[i];
 	}
 
-	stbi_image_free(_pixels);
+	//Allocated with std::malloc so that Free() can treat it the same as stb_image's allocations
+	imageData.pixels = static_cast<unsigned char*>(std::malloc(std::max<std::size_t>(totalSize, 1)));
+	if (!imageData.pixels) { throw std::runtime_error("Failed to allocate memory for texture image: " + _filepath); }
+	for (std::size_t i{ 0 }; i < _levelOffsets.size(); ++i)
+	{
+		std::memcpy(imageData.pixels + imageData.mipLevels[i].offset, _file.data() + _levelOffsets[i], _levelSizes[i]);
+	}
+
+	imageData.metadata.width = static_cast<int>(_width);
+	imageData.metadata.height = static_cast<int>(_height);
+	imageData.metadata.vkFormat = _format;
+	imageData.metadata.blockCompressed = true;
+	switch (_format)
+	{
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		imageData.metadata.channels = 1; break;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+		imageData.metadata.channels = 2; break;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		imageData.metadata.channels = 3; break;
+	default:
+		imageData.metadata.channels = 4; break;
+	}
+
+	return imageData;
+}
+
+
+
+std::uint32_t ImageLoader::GetMaxLevelCount(std::uint32_t _width, std::uint32_t _height)
+{
+	//Also keeps the level index below 32 wherever a dimension is shifted by it
+	return static_cast<std::uint32_t>(std::bit_width(std::max({ _width, _height, 1u })));
+}
+
+
+
+std::uint32_t ImageLoader::ReadU32(std::span<const unsigned char> _file, std::size_t _offset)
+{
+	return static_cast<std::uint32_t>(_file[_offset]) | (static_cast<std::uint32_t>(_file[_offset + 1]) << 8) | (static_cast<std::uint32_t>(_file[_offset + 2]) << 16) | (static_cast<std::uint32_t>(_file[_offset + 3]) << 24);
+}
+
+
+
+std::uint64_t ImageLoader::ReadU64(std::span<const unsigned char> _file, std::size_t _offset)
+{
+	return static_cast<std::uint64_t>(ReadU32(_file, _offset)) | (static_cast<std::uint64_t>(ReadU32(_file, _offset + 4)) << 32);
+}
+
+
+
+ImageData ImageLoader::AcquireEntry(CacheEntry& _entry)
+{
+	if (_entry.referenceCount++ == 0)
+	{
+		unreferencedEntries.erase(_entry.lruPosition);
+	}
+	return _entry.imageData;
+}
+
+
+
+void ImageLoader::EvictToBudget()
+{
+	while (cacheStatistics.cachedBytes > cacheStatistics.budget && !unreferencedEntries.empty())
+	{
+		const std::unordered_map<CacheKey, CacheEntry, CacheKeyHash>::iterator it{ imageCache.find(unreferencedEntries.back()) };
+		cacheStatistics.cachedBytes -= it->second.size;
+		++cacheStatistics.evictions;
+		pixelKeys.erase(it->second.imageData.pixels);
+		stbi_image_free(it->second.imageData.pixels);
+		imageCache.erase(it);
+		unreferencedEntries.pop_back();
+	}
+}
+
+
+
+std::size_t ImageLoader::CacheKeyHash::operator()(const CacheKey& _key) const
+{
+	return std::hash<std::string>{}(_key.filepath) ^ (static_cast<std::size_t>(_key.channels) << 1) ^ static_cast<std::size_t>(_key.flipImage);
 }
\ No newline at end of file
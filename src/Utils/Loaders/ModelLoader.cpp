@@ -1,6 +1,12 @@
 #include "NekiVK/Utils/Loaders/ModelLoader.h"
+#include "NekiVK/Utils/Files/FileView.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <stdexcept>
 
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -20,9 +26,90 @@ TextureInfo LoadMaterialTextures(aiMaterial* _material, aiTextureType _assimpTyp
 
 
 
+//Assimp's IO interfaces are also internal-only (Assimp is a private dependency), so these live here rather than in ModelLoader.h
+//
+//Serves the files Assimp opens (the model itself, plus anything it references - .bin buffers, .mtl libraries, etc.) from shared memory-mapped FileViews instead of buffered FILE* reads
+class MappedIOStream final : public Assimp::IOStream
+{
+public:
+	explicit MappedIOStream(std::shared_ptr<const FileView> _view) : view(std::move(_view)), position(0) {}
+
+	std::size_t Read(void* _buffer, std::size_t _size, std::size_t _count) override
+	{
+		if (_size == 0) { return 0; }
+		const std::size_t count{ std::min(_count, (view->GetSize() - position) / _size) };
+		if (count != 0) { std::memcpy(_buffer, view->GetData() + position, count * _size); }
+		position += count * _size;
+		return count;
+	}
+
+	std::size_t Write(const void*, std::size_t, std::size_t) override { return 0; } //Read-only
+
+	aiReturn Seek(std::size_t _offset, aiOrigin _origin) override
+	{
+		std::size_t base{};
+		switch (_origin)
+		{
+		case aiOrigin_SET: base = 0; break;
+		case aiOrigin_CUR: base = position; break;
+		case aiOrigin_END: base = view->GetSize(); break;
+		default: return aiReturn_FAILURE;
+		}
+		//Offsets from the end are passed as the two's complement of their magnitude, so wrapping arithmetic handles them
+		const std::size_t target{ base + _offset };
+		if (target > view->GetSize()) { return aiReturn_FAILURE; }
+		position = target;
+		return aiReturn_SUCCESS;
+	}
+
+	std::size_t Tell() const override { return position; }
+	std::size_t FileSize() const override { return view->GetSize(); }
+	void Flush() override {}
+
+
+private:
+	std::shared_ptr<const FileView> view;
+	std::size_t position;
+};
+
+
+class MappedIOSystem final : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char* _filepath) const override
+	{
+		std::error_code error;
+		return std::filesystem::is_regular_file(_filepath, error);
+	}
+
+	char getOsSeparator() const override
+	{
+		#if defined(_WIN32)
+			return '\\';
+		#else
+			return '/';
+		#endif
+	}
+
+	Assimp::IOStream* Open(const char* _filepath, const char* _mode) override
+	{
+		if (std::strchr(_mode, 'w') != nullptr || std::strchr(_mode, 'a') != nullptr) { return nullptr; } //Read-only
+		std::shared_ptr<const FileView> view{ FileView::Open(_filepath) };
+		return view ? new MappedIOStream(std::move(view)) : nullptr;
+	}
+
+	void Close(Assimp::IOStream* _file) override
+	{
+		delete _file;
+	}
+};
+
+
+
 Model ModelLoader::Load(const std::string& _filepath)
 {
 	Assimp::Importer importer;
+	importer.SetIOHandler(new MappedIOSystem()); //The importer takes ownership
 	const aiScene* scene = importer.ReadFile(_filepath,
 	                                         aiProcess_Triangulate |		//Ensure model is composed of triangles
 	                                         aiProcess_GenSmoothNormals |	//Generate smooth normals if they don't exist
@@ -38,6 +125,12 @@ Model ModelLoader::Load(const std::string& _filepath)
 
 	Model model;
 	model.directory = _filepath.substr(0, _filepath.find_last_of('/'));
+
+	//Every mesh's geometry is placed in one page-aligned arena, which BufferFactory can import as VkDeviceMemory to copy from without staging it first
+	std::size_t vertexCount{ 0 };
+	std::size_t indexCount{ 0 };
+	CountGeometry(scene->mRootNode, scene, vertexCount, indexCount);
+	model.geometry = std::make_shared<HostArena>(sizeof(ModelVertex) * vertexCount + sizeof(std::uint32_t) * indexCount);
 	ProcessNode(scene->mRootNode, scene, model);
 
 	//Load scene materials
@@ -126,13 +219,34 @@ Model ModelLoader::Load(const std::string& _filepath)
 
 
 
+void ModelLoader::CountGeometry(const aiNode* _node, const aiScene* _scene, std::size_t& _out_vertexCount, std::size_t& _out_indexCount)
+{
+	//Meshes are counted once per node that references them, matching ProcessNode()
+	for (std::size_t i{ 0 }; i < _node->mNumMeshes; ++i)
+	{
+		const aiMesh* mesh{ _scene->mMeshes[_node->mMeshes[i]] };
+		_out_vertexCount += mesh->mNumVertices;
+		for (std::size_t j{ 0 }; j < mesh->mNumFaces; ++j)
+		{
+			_out_indexCount += mesh->mFaces[j].mNumIndices;
+		}
+	}
+
+	for (std::size_t i{ 0 }; i < _node->mNumChildren; ++i)
+	{
+		CountGeometry(_node->mChildren[i], _scene, _out_vertexCount, _out_indexCount);
+	}
+}
+
+
+
 void ModelLoader::ProcessNode(aiNode* _node, const aiScene* _scene, Model& _outModel)
 {
 	//Process all the node's meshes (if any)
 	for (std::size_t i{ 0 }; i < _node->mNumMeshes; ++i)
 	{
 		aiMesh* mesh{ _scene->mMeshes[_node->mMeshes[i]] };
-		_outModel.meshes.push_back(ProcessMesh(mesh, _scene, _outModel.directory));
+		_outModel.meshes.push_back(ProcessMesh(mesh, _scene, *_outModel.geometry));
 	}
 
 	//Recursively process each child node
@@ -144,9 +258,10 @@ void ModelLoader::ProcessNode(aiNode* _node, const aiScene* _scene, Model& _outM
 
 
 
-Mesh ModelLoader::ProcessMesh(aiMesh* _mesh, const aiScene* _scene, const std::string& _directory)
+Mesh ModelLoader::ProcessMesh(aiMesh* _mesh, const aiScene* _scene, HostArena& _arena)
 {
 	Mesh nekiMesh;
+	nekiMesh.vertices = _arena.AllocateArray<ModelVertex>(_mesh->mNumVertices);
 
 	//Process vertices
 	for (std::size_t i{ 0 }; i < _mesh->mNumVertices; ++i)
@@ -175,18 +290,25 @@ Mesh ModelLoader::ProcessMesh(aiMesh* _mesh, const aiScene* _scene, const std::s
 			vertex.bitangent = { _mesh->mBitangents[i].x, _mesh->mBitangents[i].y, _mesh->mBitangents[i].z };
 		}
 
-		nekiMesh.vertices.push_back(vertex);
+		nekiMesh.vertices[i] = vertex;
 	}
 
 
 	//Process indices
+	std::size_t indexCount{ 0 };
+	for (std::size_t i{ 0 }; i < _mesh->mNumFaces; ++i)
+	{
+		indexCount += _mesh->mFaces[i].mNumIndices;
+	}
+	nekiMesh.indices = _arena.AllocateArray<std::uint32_t>(indexCount);
+	std::size_t index{ 0 };
 	for (std::size_t i{ 0 }; i < _mesh->mNumFaces; ++i)
 	{
-		//Append all indices on the face to our indices vector
-		aiFace face{ _mesh->mFaces[i] };
+		//Append all indices on the face to our indices array
+		const aiFace& face{ _mesh->mFaces[i] };
 		for (std::size_t j{ 0 }; j < face.mNumIndices; ++j)
 		{
-			nekiMesh.indices.push_back(face.mIndices[j]);
+			nekiMesh.indices[index++] = face.mIndices[j];
 		}
 	}
 
@@ -0,0 +1,597 @@
+#include "NekiVK/Utils/Pixels/PixelKernels.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define NEKI_PIXEL_KERNELS_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+
+	//GCC and Clang only allow intrinsics in functions compiled for their instruction set - MSVC allows them anywhere
+	#if defined(__GNUC__) || defined(__clang__)
+		#define NEKI_TARGET_SSE4 __attribute__((target("sse4.1")))
+		#define NEKI_TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+		#define NEKI_TARGET_SSE4
+		#define NEKI_TARGET_AVX2
+	#endif
+#endif
+
+namespace Neki
+{
+
+
+
+std::atomic<PIXEL_KERNEL_ISA> PixelKernels::isa{ PixelKernels::GetSupportedISA() };
+
+
+
+void PixelKernels::ConvertChannels(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst)
+{
+	if (_srcChannels == _dstChannels)
+	{
+		std::memcpy(_dst, _src, _texelCount * _srcChannels);
+		return;
+	}
+
+	std::size_t handled{ 0 };
+	switch (isa.load(std::memory_order_relaxed))
+	{
+	case PIXEL_KERNEL_ISA::AVX2: handled = ConvertChannelsAVX2(_src, _texelCount, _srcChannels, _dstChannels, _dst); break;
+	case PIXEL_KERNEL_ISA::SSE4: handled = ConvertChannelsSSE4(_src, _texelCount, _srcChannels, _dstChannels, _dst); break;
+	default: break;
+	}
+	ConvertChannelsScalar(_src + handled * _srcChannels, _texelCount - handled, _srcChannels, _dstChannels, _dst + handled * _dstChannels);
+}
+
+
+
+void PixelKernels::FlipVertically(unsigned char* _pixels, std::size_t _rowSize, std::size_t _rowCount)
+{
+	const PIXEL_KERNEL_ISA currentIsa{ isa.load(std::memory_order_relaxed) };
+	for (std::size_t row{ 0 }; row < _rowCount / 2; ++row)
+	{
+		unsigned char* a{ _pixels + row * _rowSize };
+		unsigned char* b{ _pixels + (_rowCount - 1 - row) * _rowSize };
+		std::size_t handled{ 0 };
+		switch (currentIsa)
+		{
+		case PIXEL_KERNEL_ISA::AVX2: handled = SwapRowsAVX2(a, b, _rowSize); break;
+		case PIXEL_KERNEL_ISA::SSE4: handled = SwapRowsSSE4(a, b, _rowSize); break;
+		default: break;
+		}
+		std::swap_ranges(a + handled, a + _rowSize, b + handled);
+	}
+}
+
+
+
+void PixelKernels::Premultiply(unsigned char* _pixels, std::size_t _texelCount)
+{
+	std::size_t handled{ 0 };
+	switch (isa.load(std::memory_order_relaxed))
+	{
+	case PIXEL_KERNEL_ISA::AVX2: handled = PremultiplyAVX2(_pixels, _texelCount); break;
+	case PIXEL_KERNEL_ISA::SSE4: handled = PremultiplySSE4(_pixels, _texelCount); break;
+	default: break;
+	}
+	PremultiplyScalar(_pixels + handled * 4, _texelCount - handled);
+}
+
+
+
+void PixelKernels::SrgbToLinear(const unsigned char* _src, std::size_t _texelCount, int _channels, unsigned char* _dst)
+{
+	const unsigned char* table{ GetSrgbToLinearTable() };
+	const int colourChannels{ _channels >= 3 ? 3 : 1 };
+	for (std::size_t i{ 0 }; i < _texelCount; ++i)
+	{
+		const unsigned char* in{ _src + i * _channels };
+		unsigned char* out{ _dst + i * _channels };
+		for (int c{ 0 }; c < colourChannels; ++c)
+		{
+			out[c] = table[in[c]];
+		}
+		if (_channels > colourChannels)
+		{
+			out[colourChannels] = in[colourChannels];
+		}
+	}
+}
+
+
+
+void PixelKernels::LinearToSrgb(const unsigned char* _src, std::size_t _texelCount, int _channels, unsigned char* _dst)
+{
+	const unsigned char* table{ GetLinearToSrgbTable() };
+	const int colourChannels{ _channels >= 3 ? 3 : 1 };
+	for (std::size_t i{ 0 }; i < _texelCount; ++i)
+	{
+		const unsigned char* in{ _src + i * _channels };
+		unsigned char* out{ _dst + i * _channels };
+		for (int c{ 0 }; c < colourChannels; ++c)
+		{
+			out[c] = table[in[c]];
+		}
+		if (_channels > colourChannels)
+		{
+			out[colourChannels] = in[colourChannels];
+		}
+	}
+}
+
+
+
+void PixelKernels::ConvertRGBA8ToRGBA16F(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst)
+{
+	std::size_t handled{ 0 };
+	switch (isa.load(std::memory_order_relaxed))
+	{
+	case PIXEL_KERNEL_ISA::AVX2: handled = ConvertRGBA8ToRGBA16FAVX2(_src, _texelCount, _srgb, _dst); break;
+	case PIXEL_KERNEL_ISA::SSE4: handled = ConvertRGBA8ToRGBA16FSSE4(_src, _texelCount, _srgb, _dst); break;
+	default: break;
+	}
+	ConvertRGBA8ToRGBA16FScalar(_src + handled * 4, _texelCount - handled, _srgb, _dst + handled * 4);
+}
+
+
+
+PIXEL_KERNEL_ISA PixelKernels::GetSupportedISA()
+{
+	static const PIXEL_KERNEL_ISA supportedIsa{ DetectISA() };
+	return supportedIsa;
+}
+
+
+
+PIXEL_KERNEL_ISA PixelKernels::GetISA()
+{
+	return isa.load(std::memory_order_relaxed);
+}
+
+
+
+void PixelKernels::SetISA(PIXEL_KERNEL_ISA _isa)
+{
+	isa.store(std::min(_isa, GetSupportedISA()), std::memory_order_relaxed);
+}
+
+
+
+const char* PixelKernels::GetISAName(PIXEL_KERNEL_ISA _isa)
+{
+	switch (_isa)
+	{
+	case PIXEL_KERNEL_ISA::SCALAR: return "Scalar";
+	case PIXEL_KERNEL_ISA::SSE4: return "SSE4.1";
+	case PIXEL_KERNEL_ISA::AVX2: return "AVX2";
+	default: return "Unknown";
+	}
+}
+
+
+
+PIXEL_KERNEL_ISA PixelKernels::DetectISA()
+{
+#if defined(NEKI_PIXEL_KERNELS_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf{ info[0] };
+	__cpuid(info, 1);
+	const bool sse41{ (info[2] & (1 << 19)) != 0 };
+	const bool osxsave{ (info[2] & (1 << 27)) != 0 };
+	const bool avx{ (info[2] & (1 << 28)) != 0 };
+	bool avx2{ false };
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	//AVX registers are only usable if the OS saves them on context switches
+	const bool ymmEnabled{ osxsave && avx && (_xgetbv(0) & 0x6) == 0x6 };
+	if (avx2 && ymmEnabled) { return PIXEL_KERNEL_ISA::AVX2; }
+	if (sse41) { return PIXEL_KERNEL_ISA::SSE4; }
+#elif defined(NEKI_PIXEL_KERNELS_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) { return PIXEL_KERNEL_ISA::AVX2; }
+	if (__builtin_cpu_supports("sse4.1")) { return PIXEL_KERNEL_ISA::SSE4; }
+#endif
+	return PIXEL_KERNEL_ISA::SCALAR;
+}
+
+
+
+void PixelKernels::ConvertChannelsScalar(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst)
+{
+	const bool srcColour{ _srcChannels >= 3 };
+	const bool srcAlpha{ _srcChannels == 2 || _srcChannels == 4 };
+	const int dstColourChannels{ _dstChannels >= 3 ? 3 : 1 };
+	const bool dstAlpha{ _dstChannels == 2 || _dstChannels == 4 };
+	for (std::size_t i{ 0 }; i < _texelCount; ++i)
+	{
+		const unsigned char* in{ _src + i * _srcChannels };
+		unsigned char* out{ _dst + i * _dstChannels };
+		const unsigned char grey{ srcColour ? static_cast<unsigned char>((in[0] * 77 + in[1] * 150 + in[2] * 29) >> 8) : in[0] };
+		for (int c{ 0 }; c < dstColourChannels; ++c)
+		{
+			out[c] = (srcColour && dstColourChannels == 3) ? in[c] : grey;
+		}
+		if (dstAlpha)
+		{
+			out[dstColourChannels] = srcAlpha ? in[_srcChannels - 1] : 255;
+		}
+	}
+}
+
+
+
+void PixelKernels::PremultiplyScalar(unsigned char* _pixels, std::size_t _texelCount)
+{
+	for (std::size_t i{ 0 }; i < _texelCount; ++i)
+	{
+		unsigned char* texel{ _pixels + i * 4 };
+		for (int c{ 0 }; c < 3; ++c)
+		{
+			//Exact round(c * a / 255) without a division
+			const std::uint32_t product{ static_cast<std::uint32_t>(texel[c]) * texel[3] + 128 };
+			texel[c] = static_cast<unsigned char>((product + (product >> 8)) >> 8);
+		}
+	}
+}
+
+
+
+void PixelKernels::ConvertRGBA8ToRGBA16FScalar(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst)
+{
+	const float* srgbTable{ GetSrgbToLinearFloatTable() };
+	for (std::size_t i{ 0 }; i < _texelCount * 4; i += 4)
+	{
+		for (std::size_t c{ 0 }; c < 3; ++c)
+		{
+			_dst[i + c] = FloatToHalf(_srgb ? srgbTable[_src[i + c]] : static_cast<float>(_src[i + c]) * (1.0f / 255.0f));
+		}
+		_dst[i + 3] = FloatToHalf(static_cast<float>(_src[i + 3]) * (1.0f / 255.0f));
+	}
+}
+
+
+
+const float* PixelKernels::GetSrgbToLinearFloatTable()
+{
+	static const std::array<float, 256> table{ []()
+	{
+		std::array<float, 256> values{};
+		for (std::size_t i{ 0 }; i < values.size(); ++i)
+		{
+			const float c{ static_cast<float>(i) / 255.0f };
+			values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return values;
+	}() };
+	return table.data();
+}
+
+
+
+const unsigned char* PixelKernels::GetSrgbToLinearTable()
+{
+	static const std::array<unsigned char, 256> table{ []()
+	{
+		const float* linear{ GetSrgbToLinearFloatTable() };
+		std::array<unsigned char, 256> values{};
+		for (std::size_t i{ 0 }; i < values.size(); ++i)
+		{
+			values[i] = static_cast<unsigned char>(linear[i] * 255.0f + 0.5f);
+		}
+		return values;
+	}() };
+	return table.data();
+}
+
+
+
+const unsigned char* PixelKernels::GetLinearToSrgbTable()
+{
+	static const std::array<unsigned char, 256> table{ []()
+	{
+		std::array<unsigned char, 256> values{};
+		for (std::size_t i{ 0 }; i < values.size(); ++i)
+		{
+			const float linear{ static_cast<float>(i) / 255.0f };
+			const float encoded{ linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f };
+			values[i] = static_cast<unsigned char>(std::clamp(encoded * 255.0f + 0.5f, 0.0f, 255.0f));
+		}
+		return values;
+	}() };
+	return table.data();
+}
+
+
+
+std::uint16_t PixelKernels::FloatToHalf(float _value)
+{
+	//Multiplying by 2^-112 moves the exponent from float's bias (127) to half's (15) - the top bits of the result are then the half, rounded by the carry from 0x1000
+	const float rebiased{ _value * 0x1.0p-112f };
+	std::uint32_t bits;
+	std::memcpy(&bits, &rebiased, sizeof(bits));
+	return static_cast<std::uint16_t>((bits + 0x1000) >> 13);
+}
+
+
+
+#if defined(NEKI_PIXEL_KERNELS_X86)
+
+NEKI_TARGET_SSE4 std::size_t PixelKernels::ConvertChannelsSSE4(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst)
+{
+	const __m128i opaque{ _mm_set1_epi32(static_cast<int>(0xFF000000)) };
+	std::size_t i{ 0 };
+	if (_srcChannels == 3 && _dstChannels == 4)
+	{
+		//16 texels per iteration - the 48 source bytes are realigned so that each register starts on a texel, then spread out with a shuffle
+		const __m128i spread{ _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1) };
+		for (; i + 16 <= _texelCount; i += 16)
+		{
+			const __m128i in0{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 3)) };
+			const __m128i in1{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 3 + 16)) };
+			const __m128i in2{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 3 + 32)) };
+			const __m128i texels[4]{ in0, _mm_alignr_epi8(in1, in0, 12), _mm_alignr_epi8(in2, in1, 8), _mm_srli_si128(in2, 4) };
+			for (int j{ 0 }; j < 4; ++j)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 4 + j * 16), _mm_or_si128(_mm_shuffle_epi8(texels[j], spread), opaque));
+			}
+		}
+	}
+	else if (_srcChannels == 4 && _dstChannels == 3)
+	{
+		//16 texels per iteration - each register is packed down to 12 bytes, then the four are stitched together into three
+		const __m128i pack{ _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1) };
+		for (; i + 16 <= _texelCount; i += 16)
+		{
+			__m128i packed[4];
+			for (int j{ 0 }; j < 4; ++j)
+			{
+				packed[j] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 4 + j * 16)), pack);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 3), _mm_or_si128(packed[0], _mm_slli_si128(packed[1], 12)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 3 + 16), _mm_or_si128(_mm_srli_si128(packed[1], 4), _mm_slli_si128(packed[2], 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 3 + 32), _mm_or_si128(_mm_srli_si128(packed[2], 8), _mm_slli_si128(packed[3], 4)));
+		}
+	}
+	else if (_srcChannels == 1 && _dstChannels == 4)
+	{
+		//Widen each grey byte to 32 bits, then replicate it into RGB with a multiply
+		const __m128i replicate{ _mm_set1_epi32(0x00010101) };
+		for (; i + 16 <= _texelCount; i += 16)
+		{
+			const __m128i in{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i)) };
+			const __m128i grey[4]{ _mm_cvtepu8_epi32(in), _mm_cvtepu8_epi32(_mm_srli_si128(in, 4)), _mm_cvtepu8_epi32(_mm_srli_si128(in, 8)), _mm_cvtepu8_epi32(_mm_srli_si128(in, 12)) };
+			for (int j{ 0 }; j < 4; ++j)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 4 + j * 16), _mm_or_si128(_mm_mullo_epi32(grey[j], replicate), opaque));
+			}
+		}
+	}
+	else if (_srcChannels == 2 && _dstChannels == 4)
+	{
+		//Widen each grey + alpha pair to 32 bits, replicate the grey into RGB, and move the alpha to the top byte
+		const __m128i replicate{ _mm_set1_epi32(0x00010101) };
+		const __m128i greyMask{ _mm_set1_epi32(0x000000FF) };
+		const __m128i alphaMask{ _mm_set1_epi32(0x0000FF00) };
+		for (; i + 8 <= _texelCount; i += 8)
+		{
+			const __m128i in{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 2)) };
+			const __m128i pairs[2]{ _mm_cvtepu16_epi32(in), _mm_cvtepu16_epi32(_mm_srli_si128(in, 8)) };
+			for (int j{ 0 }; j < 2; ++j)
+			{
+				const __m128i rgb{ _mm_mullo_epi32(_mm_and_si128(pairs[j], greyMask), replicate) };
+				const __m128i alpha{ _mm_slli_epi32(_mm_and_si128(pairs[j], alphaMask), 16) };
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 4 + j * 16), _mm_or_si128(rgb, alpha));
+			}
+		}
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_AVX2 std::size_t PixelKernels::ConvertChannelsAVX2(const unsigned char* _src, std::size_t _texelCount, int _srcChannels, int _dstChannels, unsigned char* _dst)
+{
+	const __m256i opaque{ _mm256_set1_epi32(static_cast<int>(0xFF000000)) };
+	std::size_t i{ 0 };
+	if (_srcChannels == 3 && _dstChannels == 4)
+	{
+		//8 texels per register - each 128-bit lane is loaded starting on a texel, since shuffles can't cross lanes
+		//The last load reads 4 bytes past the 16th texel, so the loop stops while there are at least 2 texels to spare
+		const __m256i spread{ _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1) };
+		for (; i + 18 <= _texelCount; i += 16)
+		{
+			for (int j{ 0 }; j < 2; ++j)
+			{
+				const unsigned char* src{ _src + i * 3 + j * 24 };
+				const __m256i in{ _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1) };
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + i * 4 + j * 32), _mm256_or_si256(_mm256_shuffle_epi8(in, spread), opaque));
+			}
+		}
+	}
+	else if (_srcChannels == 1 && _dstChannels == 4)
+	{
+		const __m256i replicate{ _mm256_set1_epi32(0x00010101) };
+		for (; i + 8 <= _texelCount; i += 8)
+		{
+			const __m256i grey{ _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_src + i))) };
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + i * 4), _mm256_or_si256(_mm256_mullo_epi32(grey, replicate), opaque));
+		}
+	}
+	else if (_srcChannels == 2 && _dstChannels == 4)
+	{
+		const __m256i replicate{ _mm256_set1_epi32(0x00010101) };
+		const __m256i greyMask{ _mm256_set1_epi32(0x000000FF) };
+		const __m256i alphaMask{ _mm256_set1_epi32(0x0000FF00) };
+		for (; i + 8 <= _texelCount; i += 8)
+		{
+			const __m256i pairs{ _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 2))) };
+			const __m256i rgb{ _mm256_mullo_epi32(_mm256_and_si256(pairs, greyMask), replicate) };
+			const __m256i alpha{ _mm256_slli_epi32(_mm256_and_si256(pairs, alphaMask), 16) };
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + i * 4), _mm256_or_si256(rgb, alpha));
+		}
+	}
+	else
+	{
+		//Packing RGBA down to RGB doesn't gain anything from wider registers, since the shuffles can't cross lanes
+		return ConvertChannelsSSE4(_src, _texelCount, _srcChannels, _dstChannels, _dst);
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_SSE4 std::size_t PixelKernels::SwapRowsSSE4(unsigned char* _a, unsigned char* _b, std::size_t _size)
+{
+	std::size_t i{ 0 };
+	for (; i + 16 <= _size; i += 16)
+	{
+		const __m128i a{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_a + i)) };
+		const __m128i b{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_b + i)) };
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_a + i), b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_b + i), a);
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_AVX2 std::size_t PixelKernels::SwapRowsAVX2(unsigned char* _a, unsigned char* _b, std::size_t _size)
+{
+	std::size_t i{ 0 };
+	for (; i + 32 <= _size; i += 32)
+	{
+		const __m256i a{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_a + i)) };
+		const __m256i b{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_b + i)) };
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(_a + i), b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(_b + i), a);
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_SSE4 std::size_t PixelKernels::PremultiplySSE4(unsigned char* _pixels, std::size_t _texelCount)
+{
+	//Each texel's alpha is broadcast across its four 16-bit lanes, and the products are divided by 255 the same way as the scalar implementation
+	const __m128i broadcastAlpha{ _mm_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15) };
+	const __m128i alphaBytes{ _mm_set1_epi32(static_cast<int>(0xFF000000)) };
+	const __m128i half{ _mm_set1_epi16(128) };
+	std::size_t i{ 0 };
+	for (; i + 4 <= _texelCount; i += 4)
+	{
+		const __m128i in{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(_pixels + i * 4)) };
+		__m128i wide[2]{ _mm_cvtepu8_epi16(in), _mm_cvtepu8_epi16(_mm_srli_si128(in, 8)) };
+		for (__m128i& w : wide)
+		{
+			const __m128i product{ _mm_add_epi16(_mm_mullo_epi16(w, _mm_shuffle_epi8(w, broadcastAlpha)), half) };
+			w = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+		}
+		const __m128i out{ _mm_blendv_epi8(_mm_packus_epi16(wide[0], wide[1]), in, alphaBytes) };
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_pixels + i * 4), out);
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_AVX2 std::size_t PixelKernels::PremultiplyAVX2(unsigned char* _pixels, std::size_t _texelCount)
+{
+	const __m256i broadcastAlpha{ _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15, 6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15) };
+	const __m256i alphaBytes{ _mm256_set1_epi32(static_cast<int>(0xFF000000)) };
+	const __m256i half{ _mm256_set1_epi16(128) };
+	std::size_t i{ 0 };
+	for (; i + 8 <= _texelCount; i += 8)
+	{
+		const __m256i in{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_pixels + i * 4)) };
+		__m256i wide[2]{ _mm256_cvtepu8_epi16(_mm256_castsi256_si128(in)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(in, 1)) };
+		for (__m256i& w : wide)
+		{
+			const __m256i product{ _mm256_add_epi16(_mm256_mullo_epi16(w, _mm256_shuffle_epi8(w, broadcastAlpha)), half) };
+			w = _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+		}
+
+		//Packing works per 128-bit lane, leaving the texels in 0 1 4 5 2 3 6 7 order - the permute puts them back
+		const __m256i packed{ _mm256_permute4x64_epi64(_mm256_packus_epi16(wide[0], wide[1]), 0xD8) };
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(_pixels + i * 4), _mm256_blendv_epi8(packed, in, alphaBytes));
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_SSE4 std::size_t PixelKernels::ConvertRGBA8ToRGBA16FSSE4(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst)
+{
+	const float* srgbTable{ GetSrgbToLinearFloatTable() };
+	const __m128 normalise{ _mm_set1_ps(1.0f / 255.0f) };
+	const __m128 rebias{ _mm_set1_ps(0x1.0p-112f) };
+	const __m128i round{ _mm_set1_epi32(0x1000) };
+	std::size_t i{ 0 };
+	for (; i + 2 <= _texelCount; i += 2)
+	{
+		__m128i halves[2];
+		for (int j{ 0 }; j < 2; ++j)
+		{
+			//SSE4.1 has no gather, so sRGB texels are assembled from the table one channel at a time
+			const unsigned char* texel{ _src + (i + j) * 4 };
+			std::int32_t packedTexel;
+			std::memcpy(&packedTexel, texel, sizeof(packedTexel));
+			const __m128 linear{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packedTexel))), normalise) };
+			const __m128 value{ _srgb ? _mm_blend_ps(_mm_setr_ps(srgbTable[texel[0]], srgbTable[texel[1]], srgbTable[texel[2]], 0.0f), linear, 0x8) : linear };
+			halves[j] = _mm_srli_epi32(_mm_add_epi32(_mm_castps_si128(_mm_mul_ps(value, rebias)), round), 13);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 4), _mm_packus_epi32(halves[0], halves[1]));
+	}
+	return i;
+}
+
+
+
+NEKI_TARGET_AVX2 std::size_t PixelKernels::ConvertRGBA8ToRGBA16FAVX2(const unsigned char* _src, std::size_t _texelCount, bool _srgb, std::uint16_t* _dst)
+{
+	const float* srgbTable{ GetSrgbToLinearFloatTable() };
+	const __m256 normalise{ _mm256_set1_ps(1.0f / 255.0f) };
+	const __m256 rebias{ _mm256_set1_ps(0x1.0p-112f) };
+	const __m256i round{ _mm256_set1_epi32(0x1000) };
+	std::size_t i{ 0 };
+	for (; i + 2 <= _texelCount; i += 2)
+	{
+		const __m256i bytes{ _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_src + i * 4))) };
+		__m256 value{ _mm256_mul_ps(_mm256_cvtepi32_ps(bytes), normalise) };
+		if (_srgb)
+		{
+			//Gather RGB from the table, keeping alpha (lanes 3 and 7) linear
+			value = _mm256_blend_ps(_mm256_i32gather_ps(srgbTable, bytes, 4), value, 0x88);
+		}
+		const __m256i halves{ _mm256_srli_epi32(_mm256_add_epi32(_mm256_castps_si256(_mm256_mul_ps(value, rebias)), round), 13) };
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i * 4), _mm_packus_epi32(_mm256_castsi256_si128(halves), _mm256_extracti128_si256(halves, 1)));
+	}
+	return i;
+}
+
+#else
+
+//No vectorised implementations outside of x86 - DetectISA() always picks the scalar ones
+std::size_t PixelKernels::ConvertChannelsSSE4(const unsigned char*, std::size_t, int, int, unsigned char*) { return 0; }
+std::size_t PixelKernels::ConvertChannelsAVX2(const unsigned char*, std::size_t, int, int, unsigned char*) { return 0; }
+std::size_t PixelKernels::SwapRowsSSE4(unsigned char*, unsigned char*, std::size_t) { return 0; }
+std::size_t PixelKernels::SwapRowsAVX2(unsigned char*, unsigned char*, std::size_t) { return 0; }
+std::size_t PixelKernels::PremultiplySSE4(unsigned char*, std::size_t) { return 0; }
+std::size_t PixelKernels::PremultiplyAVX2(unsigned char*, std::size_t) { return 0; }
+std::size_t PixelKernels::ConvertRGBA8ToRGBA16FSSE4(const unsigned char*, std::size_t, bool, std::uint16_t*) { return 0; }
+std::size_t PixelKernels::ConvertRGBA8ToRGBA16FAVX2(const unsigned char*, std::size_t, bool, std::uint16_t*) { return 0; }
+
+#endif
+
+
+
+}
\ No newline at end of file